@@ -0,0 +1,880 @@
+/**
+ * Host Keyword Spotting Benchmark
+ *
+ * Runs the impulse over a corpus of WAV files (16-bit PCM, at the sample
+ * rate of the model) and reports the time and the heap calls per operation
+ * for every stage:
+ *  - the MFCC block, one stage at a time (pre-emphasis, stack_frames, rfft,
+ *    mel, log, DCT, cmvnw and the quantization into the model input)
+ *  - the model (trained_model_invoke)
+ *  - run_classifier (one window) and run_classifier_continuous (one slice)
+ *  - run_classifier_push_samples, fed the way the DMA feeds it on the boards
+ *  - run_classifier_stream_push_samples over many streams at once, the way a
+ *    server classifies many audio sources
+ *  - the slices that run_classifier_continuous classified or skipped (with
+ *    EI_CLASSIFIER_VAD_GATE), and the detections per label
+ *
+ * Results are printed as a table, and written as JSON with -o so they can be
+ * compared between builds.
+ *
+ * Usage: ei-benchmark [-n iterations] [-b block] [-s streams] [-t threshold] [-o results.json] file.wav [file.wav ...]
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <float.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "edge-impulse-sdk/classifier/ei_run_classifier.h"
+
+/*******************************************************************************
+ * Heap accounting
+ *
+ * The benchmark is linked with --wrap for the allocator, so every malloc /
+ * calloc / realloc from the library (and from new, see below) passes here.
+ */
+
+static uint64_t heap_calls = 0;
+static uint64_t heap_bytes = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t num, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+    heap_calls++;
+    heap_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t num, size_t size) {
+    heap_calls++;
+    heap_bytes += num * size;
+    return __real_calloc(num, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    heap_calls++;
+    heap_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    __real_free(ptr);
+}
+}
+
+// libstdc++ calls malloc from the shared library, which --wrap doesn't see
+void *operator new(size_t size) {
+    void *ptr = malloc(size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    free(ptr);
+}
+
+/*******************************************************************************
+ * Stages
+ */
+
+typedef struct {
+    const char *name;
+    uint64_t ops;
+    uint64_t ns;
+    uint64_t heap_calls;
+    uint64_t heap_bytes;
+} stage_t;
+
+enum {
+    STAGE_PREEMPHASIS = 0,
+    STAGE_STACK_FRAMES,
+    STAGE_RFFT,
+    STAGE_MEL,
+    STAGE_LOG,
+    STAGE_DCT,
+    STAGE_CMVNW,
+    STAGE_CMVNW_QUANTIZE,
+    STAGE_INVOKE,
+    STAGE_RUN_CLASSIFIER,
+    STAGE_RUN_CLASSIFIER_CONTINUOUS,
+    STAGE_PUSH_SAMPLES,
+    STAGE_PUSH_SAMPLES_SLICE,
+    STAGE_STREAMS_PUSH_SAMPLES,
+    STAGE_COUNT
+};
+
+static stage_t stages[STAGE_COUNT] = {
+    { "preemphasis", 0, 0, 0, 0 },
+    { "stack_frames", 0, 0, 0, 0 },
+    { "rfft", 0, 0, 0, 0 },
+    { "mel", 0, 0, 0, 0 },
+    { "log", 0, 0, 0, 0 },
+    { "dct", 0, 0, 0, 0 },
+    { "cmvnw", 0, 0, 0, 0 },
+    { "cmvnw_quantize", 0, 0, 0, 0 },
+    { "invoke", 0, 0, 0, 0 },
+    { "run_classifier", 0, 0, 0, 0 },
+    { "run_classifier_continuous", 0, 0, 0, 0 },
+    { "push_samples", 0, 0, 0, 0 },
+    { "push_samples_slice", 0, 0, 0, 0 },
+    { "streams_push_samples", 0, 0, 0, 0 },
+};
+
+// Measures one operation of a stage, from construction until it goes out of scope
+class stage_op {
+public:
+    stage_op(int stage, bool record)
+        : _stage(record ? &stages[stage] : NULL),
+          _heap_calls(heap_calls), _heap_bytes(heap_bytes),
+          _start(std::chrono::steady_clock::now())
+    {
+    }
+
+    // Record the operation in another stage, when that's only known once it ran
+    void set_stage(int stage) {
+        if (_stage) {
+            _stage = &stages[stage];
+        }
+    }
+
+    ~stage_op() {
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        if (!_stage) {
+            return;
+        }
+        _stage->ops++;
+        _stage->ns += std::chrono::duration_cast<std::chrono::nanoseconds>(end - _start).count();
+        _stage->heap_calls += heap_calls - _heap_calls;
+        _stage->heap_bytes += heap_bytes - _heap_bytes;
+    }
+
+private:
+    stage_t *_stage;
+    uint64_t _heap_calls;
+    uint64_t _heap_bytes;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+/*******************************************************************************
+ * Nodes of the model (from the profiler in trained_model_invoke)
+ */
+
+#define MAX_NODES   64
+
+typedef struct {
+    const char *op;
+    uint64_t ops;
+    uint64_t ns;
+    uint32_t scratch_bytes;
+} node_t;
+
+static node_t nodes[MAX_NODES];
+static size_t node_count = 0;
+
+static void record_nodes(uint32_t from_sequence) {
+    ei_profiler_event_t events[EI_CLASSIFIER_PROFILER_EVENTS];
+    size_t count = ei_profiler_read(from_sequence, events, EI_CLASSIFIER_PROFILER_EVENTS);
+    double ns_per_tick = 1e9 / ei_profiler_ticks_per_second();
+
+    for (size_t ix = 0; ix < count; ix++) {
+        const ei_profiler_event_t *e = &events[ix];
+        if (e->node >= MAX_NODES) {
+            continue;
+        }
+        node_t *n = &nodes[e->node];
+        n->op = e->op;
+        n->ops++;
+        n->ns += static_cast<uint64_t>((e->end - e->start) * ns_per_tick);
+        n->scratch_bytes = e->scratch_bytes;
+        if (e->node >= node_count) {
+            node_count = e->node + 1;
+        }
+    }
+}
+#endif // EI_CLASSIFIER_PROFILE_NODES == 1
+
+/*******************************************************************************
+ * WAV files
+ */
+
+static uint32_t read_le(const uint8_t *p, int bytes) {
+    uint32_t v = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        v = (v << 8) | p[i];
+    }
+    return v;
+}
+
+/**
+ * Read the first channel of a 16-bit PCM WAV file
+ * @param path File to read
+ * @param samples Receives the samples
+ * @param sample_rate Receives the sample rate
+ * @returns true if OK
+ */
+static bool read_wav(const char *path, std::vector<int16_t> *samples, uint32_t *sample_rate) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    if (data.size() < 12 || memcmp(&data[0], "RIFF", 4) != 0 || memcmp(&data[8], "WAVE", 4) != 0) {
+        fprintf(stderr, "%s: not a WAV file\n", path);
+        return false;
+    }
+
+    uint32_t channels = 0;
+    uint32_t bits_per_sample = 0;
+    bool have_format = false;
+
+    for (size_t offset = 12; offset + 8 <= data.size(); ) {
+        const uint8_t *header = &data[offset];
+        size_t size = read_le(header + 4, 4);
+        const uint8_t *body = header + 8;
+        if (offset + 8 + size > data.size()) {
+            size = data.size() - offset - 8;
+        }
+
+        if (memcmp(header, "fmt ", 4) == 0 && size >= 16) {
+            uint32_t format = read_le(body, 2);
+            channels = read_le(body + 2, 2);
+            *sample_rate = read_le(body + 4, 4);
+            bits_per_sample = read_le(body + 14, 2);
+            // PCM, or WAVE_FORMAT_EXTENSIBLE
+            have_format = (format == 1 || format == 0xfffe);
+        }
+        else if (memcmp(header, "data", 4) == 0) {
+            if (!have_format || channels == 0 || bits_per_sample != 16) {
+                fprintf(stderr, "%s: only 16-bit PCM is supported\n", path);
+                return false;
+            }
+            size_t frames = size / (2 * channels);
+            samples->resize(frames);
+            for (size_t ix = 0; ix < frames; ix++) {
+                (*samples)[ix] = static_cast<int16_t>(read_le(body + ix * 2 * channels, 2));
+            }
+            return true;
+        }
+
+        // chunks are padded to an even size
+        offset += 8 + size + (size & 1);
+    }
+
+    fprintf(stderr, "%s: no data chunk\n", path);
+    return false;
+}
+
+/*******************************************************************************
+ * Impulse
+ */
+
+static const float *signal_buffer;
+
+static int get_signal_data(size_t offset, size_t length, float *out_ptr) {
+    memcpy(out_ptr, signal_buffer + offset, length * sizeof(float));
+    return 0;
+}
+
+/**
+ * Run the steps of extract_mfcc_features and the quantization into the model
+ * input one by one, timing each of them.
+ * @param window EI_CLASSIFIER_RAW_SAMPLE_COUNT samples
+ * @param config MFCC block configuration
+ * @param scale Quantization scale of the model input
+ * @param zero_point Quantization zero point of the model input
+ * @param features Receives the normalized features
+ * @param quantized Receives the quantized features
+ * @param record Whether to record the timings
+ * @returns EIDSP_OK if OK
+ */
+static int run_mfcc_stages(const float *window, ei_dsp_config_mfcc_t *config, float scale, int32_t zero_point,
+                           matrix_t *features, int8_t *quantized, bool record)
+{
+    const uint32_t frequency = static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY);
+    const size_t coefficients = config->fft_length / 2 + 1;
+    int ret;
+
+    // like in extract_mfcc_features the temporaries come from the scratch arena,
+    // which run_classifier has reserved
+    ei::scratch_arena::scope scratch;
+
+    signal_buffer = window;
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+    signal.get_data = &get_signal_data;
+
+    std::vector<float> preemphasized(EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+    {
+        stage_op op(STAGE_PREEMPHASIS, record);
+        class speechpy::processing::preemphasis pre(&signal, config->pre_shift, config->pre_cof);
+        ret = pre.get_data(0, EI_CLASSIFIER_RAW_SAMPLE_COUNT, preemphasized.data());
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    signal_t preemphasized_signal;
+    numpy::signal_from_buffer(preemphasized.data(), preemphasized.size(), &preemphasized_signal);
+
+    speechpy::stack_frames_info_t frames = {};
+    frames.signal = &preemphasized_signal;
+    {
+        stage_op op(STAGE_STACK_FRAMES, record);
+        ret = speechpy::processing::stack_frames(&frames, frequency, config->frame_length, config->frame_stride, false);
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    const size_t frame_count = frames.frame_count;
+    const speechpy::sparse_filterbank_t *filterbank;
+    ret = speechpy::feature::sparse_filterbank(&filterbank, config->num_filters, coefficients, frequency,
+        config->low_frequency, config->high_frequency ? config->high_frequency : frequency / 2);
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    std::vector<float> frame(frames.frame_length);
+    std::vector<float> spectrum(coefficients);
+    std::vector<float> energies(frame_count);
+    matrix_t mel(frame_count, config->num_filters);
+
+    for (size_t ix = 0; ix < frame_count; ix++) {
+        size_t offset = frames.frame_offset(ix);
+        size_t length = frames.frame_length;
+        memset(frame.data(), 0, frame.size() * sizeof(float));
+        if (offset + length > preemphasized.size()) {
+            length = preemphasized.size() - offset;
+        }
+        memcpy(frame.data(), preemphasized.data() + offset, length * sizeof(float));
+
+        {
+            // the FFT, power spectrum and frame energy
+            stage_op op(STAGE_RFFT, record);
+            float energy;
+            ret = numpy::power_spectrum(frame.data(), frame.size(), spectrum.data(), coefficients,
+                config->fft_length, &energy);
+            energies[ix] = energy == 0 ? FLT_EPSILON : energy;
+        }
+        if (ret != EIDSP_OK) {
+            break;
+        }
+
+        {
+            stage_op op(STAGE_MEL, record);
+            ret = speechpy::feature::mel_energies(filterbank, spectrum.data(), coefficients,
+                mel.buffer + ix * mel.cols);
+        }
+        if (ret != EIDSP_OK) {
+            break;
+        }
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    {
+        stage_op op(STAGE_LOG, record);
+        ret = numpy::log(&mel, true);
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    {
+        // the DCT, with the log frame energy as the first coefficient
+        stage_op op(STAGE_DCT, record);
+        ret = numpy::dct2_truncated(&mel, features);
+        for (size_t row = 0; row < frame_count && ret == EIDSP_OK; row++) {
+            features->buffer[row * config->num_cepstral] = numpy::log(energies[row]);
+        }
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    matrix_t normalized(features->rows, features->cols);
+    memcpy(normalized.buffer, features->buffer, features->rows * features->cols * sizeof(float));
+    {
+        stage_op op(STAGE_CMVNW, record);
+        ret = speechpy::processing::cmvnw(&normalized, config->win_size, true);
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    {
+        stage_op op(STAGE_CMVNW_QUANTIZE, record);
+        ret = speechpy::processing::cmvnw_quantize(features, 0, config->win_size, true,
+            scale, zero_point, quantized);
+    }
+    if (ret != EIDSP_OK) {
+        return ret;
+    }
+
+    memcpy(features->buffer, normalized.buffer, features->rows * features->cols * sizeof(float));
+    return EIDSP_OK;
+}
+
+/**
+ * Run the model on a window of (normalized) features
+ * @returns EI_IMPULSE_OK if OK
+ */
+static EI_IMPULSE_ERROR run_model(matrix_t *features, const int8_t *quantized, bool record) {
+    TfLiteTensor *input = trained_model_input(0);
+    if (input->type == kTfLiteInt8) {
+        memcpy(input->data.int8, quantized, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    }
+    else {
+        memcpy(input->data.f, features->buffer, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE * sizeof(float));
+    }
+
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    uint32_t profiler_sequence = ei_profiler_sequence();
+#endif
+    TfLiteStatus status;
+    {
+        stage_op op(STAGE_INVOKE, record);
+        status = trained_model_invoke();
+    }
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    if (record) {
+        record_nodes(profiler_sequence);
+    }
+#endif
+    return status == kTfLiteOk ? EI_IMPULSE_OK : EI_IMPULSE_TFLITE_ERROR;
+}
+
+/**
+ * Run all stages over one window
+ * @returns EI_IMPULSE_OK if OK
+ */
+static EI_IMPULSE_ERROR run_window(const float *window, ei_dsp_config_mfcc_t *config, bool record) {
+    signal_buffer = window;
+    signal_t signal;
+    signal.total_length = EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+    signal.get_data = &get_signal_data;
+
+    ei_impulse_result_t result;
+    EI_IMPULSE_ERROR ret;
+    {
+        stage_op op(STAGE_RUN_CLASSIFIER, record);
+        ret = run_classifier(&signal, &result, false);
+    }
+    if (ret != EI_IMPULSE_OK) {
+        return ret;
+    }
+
+    // the stages below share the model that run_classifier keeps resident
+#if EI_CLASSIFIER_PERSISTENT_SESSION == 0
+    if (trained_model_init(ei_aligned_malloc) != kTfLiteOk) {
+        return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
+    }
+#endif
+
+    TfLiteTensor *input = trained_model_input(0);
+    matrix_t features(EI_CLASSIFIER_NN_INPUT_FRAME_SIZE / config->num_cepstral, config->num_cepstral);
+    std::vector<int8_t> quantized(EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+
+    if (run_mfcc_stages(window, config, input->params.scale, input->params.zero_point,
+                        &features, quantized.data(), record) != EIDSP_OK) {
+        ret = EI_IMPULSE_DSP_ERROR;
+    }
+    if (ret == EI_IMPULSE_OK) {
+        ret = run_model(&features, quantized.data(), record);
+    }
+
+#if EI_CLASSIFIER_PERSISTENT_SESSION == 0
+    trained_model_reset(ei_aligned_free);
+#endif
+    return ret;
+}
+
+/*******************************************************************************
+ * Continuous results, of one pass over the corpus
+ */
+
+static uint64_t continuous_slices = 0;
+static uint64_t continuous_skipped = 0;
+static uint64_t detections[EI_CLASSIFIER_LABEL_COUNT] = { 0 };
+static float detection_threshold = 0.8f;
+
+/**
+ * Count a result of run_classifier_continuous: skipped or not, and every label
+ * that is at or above the detection threshold
+ */
+static void count_result(const ei_impulse_result_t *result) {
+    continuous_slices++;
+    if (result->skipped) {
+        continuous_skipped++;
+        return;
+    }
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        if (result->classification[ix].value >= detection_threshold) {
+            detections[ix]++;
+        }
+    }
+}
+
+/**
+ * Push a file through run_classifier_continuous, one slice at a time. The results
+ * of the first pass are counted (they're the same in every pass).
+ * @returns EI_IMPULSE_OK if OK
+ */
+static EI_IMPULSE_ERROR run_continuous(const std::vector<float> &samples, bool record) {
+    run_classifier_init();
+
+    for (size_t offset = 0; offset + EI_CLASSIFIER_SLICE_SIZE <= samples.size(); offset += EI_CLASSIFIER_SLICE_SIZE) {
+        signal_buffer = samples.data() + offset;
+        signal_t signal;
+        signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
+        signal.get_data = &get_signal_data;
+
+        ei_impulse_result_t result;
+        EI_IMPULSE_ERROR ret;
+        {
+            stage_op op(STAGE_RUN_CLASSIFIER_CONTINUOUS, record);
+            ret = run_classifier_continuous(&signal, &result, false);
+        }
+        if (ret != EI_IMPULSE_OK) {
+            return ret;
+        }
+        if (!record) {
+            count_result(&result);
+        }
+    }
+
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Push a file through run_classifier_push_samples, one block at a time. Blocks that
+ * complete a slice (and run the model) are recorded separately from the others.
+ * @returns EI_IMPULSE_OK if OK
+ */
+static EI_IMPULSE_ERROR run_push_samples(const std::vector<int16_t> &samples, size_t block_size, bool record) {
+    run_classifier_init();
+
+    for (size_t offset = 0; offset < samples.size(); offset += block_size) {
+        size_t length = std::min(block_size, samples.size() - offset);
+
+        ei_impulse_result_t result;
+        bool result_ready = false;
+        EI_IMPULSE_ERROR ret;
+        {
+            stage_op op(STAGE_PUSH_SAMPLES, record);
+            ret = run_classifier_push_samples(samples.data() + offset, length, &result, &result_ready, false);
+            if (result_ready) {
+                op.set_stage(STAGE_PUSH_SAMPLES_SLICE);
+            }
+        }
+        if (ret != EI_IMPULSE_OK) {
+            return ret;
+        }
+    }
+
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * Push the corpus through a number of streams at once, one block per stream in turn,
+ * so the streams compete for the caches like they do on a server. Stream k plays
+ * file k (modulo the number of files), every stream until its file ends.
+ * @returns EI_IMPULSE_OK if OK
+ */
+static EI_IMPULSE_ERROR run_streams(const std::vector<std::vector<int16_t> > &corpus,
+                                    std::vector<ei_classifier_stream_t> &streams, size_t block_size, bool record) {
+    for (size_t ix = 0; ix < streams.size(); ix++) {
+        run_classifier_stream_init(&streams[ix]);
+    }
+
+    bool pushed = true;
+    for (size_t offset = 0; pushed; offset += block_size) {
+        pushed = false;
+        for (size_t ix = 0; ix < streams.size(); ix++) {
+            const std::vector<int16_t> &samples = corpus[ix % corpus.size()];
+            if (offset >= samples.size()) {
+                continue;
+            }
+            size_t length = std::min(block_size, samples.size() - offset);
+
+            ei_impulse_result_t result;
+            bool result_ready = false;
+            EI_IMPULSE_ERROR ret;
+            {
+                stage_op op(STAGE_STREAMS_PUSH_SAMPLES, record);
+                ret = run_classifier_stream_push_samples(&streams[ix], samples.data() + offset, length,
+                                                         &result, &result_ready, false);
+            }
+            if (ret != EI_IMPULSE_OK) {
+                return ret;
+            }
+            pushed = true;
+        }
+    }
+
+    return EI_IMPULSE_OK;
+}
+
+/*******************************************************************************
+ * Report
+ */
+
+static void print_results(size_t files, size_t windows, int iterations, int stream_count) {
+    printf("%zu file(s), %zu window(s), %d iteration(s)\n", files, windows, iterations);
+    printf("%d stream(s) of %zu bytes\n\n", stream_count, sizeof(ei_classifier_stream_t));
+    printf("%-26s %10s %14s %12s %14s\n", "stage", "ops", "ns/op", "allocs/op", "bytes/op");
+    for (int ix = 0; ix < STAGE_COUNT; ix++) {
+        const stage_t *s = &stages[ix];
+        double ops = s->ops ? static_cast<double>(s->ops) : 1.0;
+        printf("%-26s %10llu %14.0f %12.2f %14.1f\n", s->name, (unsigned long long)s->ops,
+            s->ns / ops, s->heap_calls / ops, s->heap_bytes / ops);
+    }
+
+    printf("\ncontinuous: %llu slice(s), %llu skipped (%.1f %%), VAD gate %s\n",
+        (unsigned long long)continuous_slices, (unsigned long long)continuous_skipped,
+        continuous_slices ? 100.0 * continuous_skipped / continuous_slices : 0.0,
+        EI_CLASSIFIER_VAD_GATE == 1 ? "on" : "off");
+    printf("%-26s %10s\n", "label", "detections");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        printf("%-26s %10llu\n", ei_classifier_inferencing_categories[ix], (unsigned long long)detections[ix]);
+    }
+
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    printf("\n%-6s %-18s %10s %14s %14s\n", "node", "op", "ops", "ns/op", "scratch bytes");
+    for (size_t ix = 0; ix < node_count; ix++) {
+        const node_t *n = &nodes[ix];
+        double ops = n->ops ? static_cast<double>(n->ops) : 1.0;
+        printf("%-6zu %-18s %10llu %14.0f %14u\n", ix, n->op ? n->op : "-", (unsigned long long)n->ops,
+            n->ns / ops, (unsigned)n->scratch_bytes);
+    }
+#endif
+}
+
+static bool write_json(const char *path, size_t files, size_t windows, int iterations, int stream_count) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "%s: cannot open\n", path);
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"impulse\": {\n");
+    fprintf(file, "    \"label_count\": %d,\n", EI_CLASSIFIER_LABEL_COUNT);
+    fprintf(file, "    \"frequency\": %d,\n", static_cast<int>(EI_CLASSIFIER_FREQUENCY));
+    fprintf(file, "    \"raw_sample_count\": %d,\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT);
+    fprintf(file, "    \"slice_size\": %d,\n", static_cast<int>(EI_CLASSIFIER_SLICE_SIZE));
+    fprintf(file, "    \"nn_input_frame_size\": %d\n", EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"corpus\": { \"files\": %zu, \"windows\": %zu },\n", files, windows);
+    fprintf(file, "  \"iterations\": %d,\n", iterations);
+    fprintf(file, "  \"streams\": { \"count\": %d, \"bytes\": %zu },\n", stream_count, sizeof(ei_classifier_stream_t));
+    fprintf(file, "  \"continuous\": {\n");
+    fprintf(file, "    \"vad_gate\": %s,\n", EI_CLASSIFIER_VAD_GATE == 1 ? "true" : "false");
+    fprintf(file, "    \"slices\": %llu,\n", (unsigned long long)continuous_slices);
+    fprintf(file, "    \"skipped\": %llu,\n", (unsigned long long)continuous_skipped);
+    fprintf(file, "    \"detection_threshold\": %.2f,\n", detection_threshold);
+    fprintf(file, "    \"detections\": {");
+    for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+        fprintf(file, " \"%s\": %llu%s", ei_classifier_inferencing_categories[ix], (unsigned long long)detections[ix],
+            ix + 1 < EI_CLASSIFIER_LABEL_COUNT ? "," : "");
+    }
+    fprintf(file, " }\n");
+    fprintf(file, "  },\n");
+    fprintf(file, "  \"stages\": [\n");
+    for (int ix = 0; ix < STAGE_COUNT; ix++) {
+        const stage_t *s = &stages[ix];
+        double ops = s->ops ? static_cast<double>(s->ops) : 1.0;
+        fprintf(file, "    { \"name\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.1f, "
+            "\"allocs_per_op\": %.3f, \"alloc_bytes_per_op\": %.1f }%s\n",
+            s->name, (unsigned long long)s->ops, s->ns / ops, s->heap_calls / ops, s->heap_bytes / ops,
+            ix + 1 < STAGE_COUNT ? "," : "");
+    }
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    fprintf(file, "  ],\n");
+    fprintf(file, "  \"nodes\": [\n");
+    for (size_t ix = 0; ix < node_count; ix++) {
+        const node_t *n = &nodes[ix];
+        double ops = n->ops ? static_cast<double>(n->ops) : 1.0;
+        fprintf(file, "    { \"node\": %zu, \"op\": \"%s\", \"ops\": %llu, \"ns_per_op\": %.1f, "
+            "\"scratch_bytes\": %u }%s\n",
+            ix, n->op ? n->op : "", (unsigned long long)n->ops, n->ns / ops, (unsigned)n->scratch_bytes,
+            ix + 1 < node_count ? "," : "");
+    }
+#endif
+    fprintf(file, "  ]\n");
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return true;
+}
+
+/*******************************************************************************
+ * Main
+ */
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n iterations] [-b block] [-s streams] [-t threshold] [-o results.json] "
+        "file.wav [file.wav ...]\n", name);
+}
+
+int main(int argc, char **argv) {
+    int iterations = 10;
+    int block_size = 800; // samples per DMA half-buffer on the nucleo-l476
+    int stream_count = 64;
+    const char *json_path = NULL;
+    std::vector<const char*> paths;
+
+    for (int ix = 1; ix < argc; ix++) {
+        if (strcmp(argv[ix], "-n") == 0 && ix + 1 < argc) {
+            iterations = atoi(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "-b") == 0 && ix + 1 < argc) {
+            block_size = atoi(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "-s") == 0 && ix + 1 < argc) {
+            stream_count = atoi(argv[++ix]);
+        }
+        else if (strcmp(argv[ix], "-t") == 0 && ix + 1 < argc) {
+            detection_threshold = static_cast<float>(atof(argv[++ix]));
+        }
+        else if (strcmp(argv[ix], "-o") == 0 && ix + 1 < argc) {
+            json_path = argv[++ix];
+        }
+        else if (argv[ix][0] == '-') {
+            usage(argv[0]);
+            return 1;
+        }
+        else {
+            paths.push_back(argv[ix]);
+        }
+    }
+    if (paths.empty() || iterations < 1 || block_size < 1 || stream_count < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (ei_dsp_blocks_size != 1 || ei_dsp_blocks[0].extract_fn != &extract_mfcc_features) {
+        fprintf(stderr, "the benchmark expects an impulse with a single MFCC block\n");
+        return 1;
+    }
+    ei_dsp_config_mfcc_t *config = (ei_dsp_config_mfcc_t*)ei_dsp_blocks[0].config;
+
+    // every file becomes a number of whole windows, the last one zero padded
+    std::vector<std::vector<float> > corpus;
+    std::vector<std::vector<int16_t> > corpus_int16; // same audio, for run_classifier_push_samples
+    size_t windows = 0;
+    for (size_t ix = 0; ix < paths.size(); ix++) {
+        std::vector<int16_t> samples;
+        uint32_t sample_rate = 0;
+        if (!read_wav(paths[ix], &samples, &sample_rate)) {
+            return 1;
+        }
+        if (sample_rate != static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY)) {
+            fprintf(stderr, "%s: sample rate is %u Hz, the model expects %d Hz\n",
+                paths[ix], sample_rate, static_cast<int>(EI_CLASSIFIER_FREQUENCY));
+            return 1;
+        }
+
+        size_t file_windows = (samples.size() + EI_CLASSIFIER_RAW_SAMPLE_COUNT - 1) / EI_CLASSIFIER_RAW_SAMPLE_COUNT;
+        if (file_windows == 0) {
+            continue;
+        }
+        std::vector<float> audio(file_windows * EI_CLASSIFIER_RAW_SAMPLE_COUNT, 0.0f);
+        numpy::int16_to_float(samples.data(), audio.data(), samples.size());
+        corpus.push_back(audio);
+        samples.resize(audio.size(), 0);
+        corpus_int16.push_back(samples);
+        windows += file_windows;
+    }
+    if (windows == 0) {
+        fprintf(stderr, "no audio\n");
+        return 1;
+    }
+
+    // the streams keep their buffers between iterations, like a server that reuses them
+    std::vector<ei_classifier_stream_t> streams(static_cast<size_t>(stream_count));
+
+    // first pass builds the caches (filterbank, FFT plans, scratch arena) and isn't recorded
+    for (int iteration = 0; iteration <= iterations; iteration++) {
+        bool record = iteration > 0;
+        for (size_t ix = 0; ix < corpus.size(); ix++) {
+            const std::vector<float> &audio = corpus[ix];
+            for (size_t offset = 0; offset < audio.size(); offset += EI_CLASSIFIER_RAW_SAMPLE_COUNT) {
+                EI_IMPULSE_ERROR ret = run_window(audio.data() + offset, config, record);
+                if (ret != EI_IMPULSE_OK) {
+                    fprintf(stderr, "%s: failed (%d)\n", paths[ix], ret);
+                    return 1;
+                }
+            }
+
+            EI_IMPULSE_ERROR ret = run_continuous(audio, record);
+            if (ret != EI_IMPULSE_OK) {
+                fprintf(stderr, "%s: continuous inferencing failed (%d)\n", paths[ix], ret);
+                return 1;
+            }
+
+            ret = run_push_samples(corpus_int16[ix], static_cast<size_t>(block_size), record);
+            if (ret != EI_IMPULSE_OK) {
+                fprintf(stderr, "%s: pushing samples failed (%d)\n", paths[ix], ret);
+                return 1;
+            }
+        }
+
+        EI_IMPULSE_ERROR ret = run_streams(corpus_int16, streams, static_cast<size_t>(block_size), record);
+        if (ret != EI_IMPULSE_OK) {
+            fprintf(stderr, "%d streams: pushing samples failed (%d)\n", stream_count, ret);
+            return 1;
+        }
+    }
+
+    run_classifier_deinit();
+
+    print_results(corpus.size(), windows, iterations, stream_count);
+
+    if (json_path && !write_json(json_path, corpus.size(), windows, iterations, stream_count)) {
+        return 1;
+    }
+
+    return 0;
+}
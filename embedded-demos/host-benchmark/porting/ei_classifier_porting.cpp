@@ -0,0 +1,103 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+#include "edge-impulse-sdk/porting/ei_logger.h"
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <chrono>
+#include <thread>
+#if EI_CLASSIFIER_THREAD_SAFE == 1
+#include <mutex>
+#endif
+
+// Porting layer for the host (Linux / POSIX) build, see ../CMakeLists.txt
+
+__attribute__((weak)) EI_IMPULSE_ERROR ei_run_impulse_check_canceled() {
+    return EI_IMPULSE_OK;
+}
+
+__attribute__((weak)) EI_IMPULSE_ERROR ei_sleep(int32_t time_ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(time_ms));
+    return EI_IMPULSE_OK;
+}
+
+uint64_t ei_read_timer_ms() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint64_t ei_read_timer_us() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// No portable cycle counter (the TSC does not count core cycles), time in us only
+uint64_t ei_read_timer_cycles() {
+    return 0;
+}
+
+uint32_t ei_timer_cycles_per_second() {
+    return 0;
+}
+
+// Log backend that writes to stdout (blocking), so the logger behaves the same as on a target
+static void stdout_logger_write(const char *data, size_t length) {
+    fwrite(data, 1, length, stdout);
+    ei_logger_write_done();
+}
+
+static const ei_logger_backend_t stdout_logger = { &stdout_logger_write };
+
+#if EI_CLASSIFIER_THREAD_SAFE == 1
+// the logger takes one producer at a time
+static std::mutex printf_mutex;
+#endif
+
+__attribute__((weak)) void ei_printf(const char *format, ...) {
+#if EI_CLASSIFIER_THREAD_SAFE == 1
+    std::lock_guard<std::mutex> lock(printf_mutex);
+#endif
+    static bool logger_ready = false;
+    if (!logger_ready) {
+        ei_logger_init(&stdout_logger);
+        logger_ready = true;
+    }
+
+    va_list myargs;
+    va_start(myargs, format);
+    ei_logger_vprintf(format, myargs);
+    va_end(myargs);
+    ei_logger_drain();
+}
+
+__attribute__((weak)) void ei_printf_float(float f) {
+    ei_printf("%f", f);
+}
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C"
+#endif
+__attribute__((weak)) void DebugLog(const char* s) {
+    ei_printf("%s", s);
+}
@@ -0,0 +1,142 @@
+/**
+ * Accuracy of numpy::log
+ *
+ * Checks the array version of numpy::log (the one the MFCC runs over the mel
+ * energies) against std::log, over a sweep of the positive normal floats: the
+ * error may not exceed what numpy.hpp documents (max 2.3e-5, 6.9e-6 on
+ * average). Also checks that zero handling only changes zeros, and works in place.
+ *
+ * Usage: numpy-log-test (exits with 1 on failure)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <vector>
+
+#include "edge-impulse-sdk/dsp/numpy.hpp"
+
+using namespace ei;
+
+// the bounds documented with numpy::log
+static const double max_error_bound = 2.3e-5;
+static const double avg_error_bound = 6.9e-6;
+
+// bit patterns of the positive normal floats
+static const uint32_t first_normal = 0x00800000;    // FLT_MIN
+static const uint32_t last_normal = 0x7f7fffff;     // FLT_MAX
+
+// every 31st float, an odd stride so every mantissa pattern is hit (the exhaustive
+// sweep gives the same max and average, but takes 20 seconds)
+static const uint32_t stride = 31;
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    printf("%s: %s\n", ok ? "OK  " : "FAIL", what);
+    if (!ok) {
+        failures++;
+    }
+}
+
+static float from_bits(uint32_t bits) {
+    float v;
+    memcpy(&v, &bits, sizeof(v));
+    return v;
+}
+
+/**
+ * Error of numpy::log against std::log (in double) over the positive normal floats
+ */
+static void test_accuracy() {
+    const size_t block_size = 4096;
+    std::vector<float> input(block_size);
+    std::vector<float> output(block_size);
+
+    double max_error = 0;
+    double sum_error = 0;
+    float max_error_at = 0;
+    uint64_t count = 0;
+
+    uint64_t bits = first_normal;
+    while (bits <= last_normal) {
+        size_t n = 0;
+        for (; n < block_size && bits <= last_normal; n++, bits += stride) {
+            input[n] = from_bits(static_cast<uint32_t>(bits));
+        }
+
+        numpy::log(input.data(), output.data(), n);
+
+        for (size_t ix = 0; ix < n; ix++) {
+            double error = fabs(static_cast<double>(output[ix]) - log(static_cast<double>(input[ix])));
+            sum_error += error;
+            if (error > max_error) {
+                max_error = error;
+                max_error_at = input[ix];
+            }
+        }
+        count += n;
+    }
+
+    double avg_error = sum_error / count;
+    printf("%llu floats, max error %.4g (at %g), average error %.4g\n",
+        (unsigned long long)count, max_error, max_error_at, avg_error);
+
+    check(max_error <= max_error_bound, "max error <= 2.3e-5");
+    check(avg_error <= avg_error_bound, "average error <= 6.9e-6");
+}
+
+/**
+ * With zero handling, zeros become log(FLT_EPSILON) and nothing else changes
+ */
+static void test_zero_handling() {
+    const float values[] = { 0.0f, 1.0f, FLT_MIN, 0.0f, 3.5e-3f, FLT_EPSILON, 1e30f, 0.0f, 42.0f };
+    const size_t count = sizeof(values) / sizeof(values[0]);
+
+    float plain[count];
+    float fused[count];
+    numpy::log(values, plain, count);
+    numpy::log(values, fused, count, true);
+
+    bool ok = true;
+    for (size_t ix = 0; ix < count; ix++) {
+        float expected = values[ix] == 0.0f ? numpy::log(FLT_EPSILON) : plain[ix];
+        if (fused[ix] != expected) {
+            ok = false;
+        }
+    }
+    check(ok, "zero handling replaces zeros by FLT_EPSILON, only zeros");
+
+    // in place, the way the MFCC calls it on the mel energies
+    float in_place[count];
+    memcpy(in_place, values, sizeof(values));
+    numpy::log(in_place, in_place, count, true);
+    check(memcmp(in_place, fused, sizeof(fused)) == 0, "in place gives the same result");
+}
+
+int main() {
+    test_accuracy();
+    test_zero_handling();
+
+    return failures == 0 ? 0 : 1;
+}
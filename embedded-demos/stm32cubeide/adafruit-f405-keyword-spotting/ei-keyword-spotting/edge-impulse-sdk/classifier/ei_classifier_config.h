@@ -38,4 +38,63 @@
 #endif
 #endif // EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN
 
+// Keep a compiled TFLite model initialized (arena, prepared kernels) between inferences,
+// call run_classifier_deinit() to free it. Set to 0 to set up and free the model on every inference.
+#ifndef EI_CLASSIFIER_PERSISTENT_SESSION
+#define EI_CLASSIFIER_PERSISTENT_SESSION              1
+#endif // EI_CLASSIFIER_PERSISTENT_SESSION
+
+// Place the arena of a compiled TFLite model (tensors, kernel state and CMSIS-NN scratch)
+// in a statically sized block. Set to 0 to allocate the same block from the heap on init.
+#ifndef EI_CLASSIFIER_ALLOCATION_STATIC
+#define EI_CLASSIFIER_ALLOCATION_STATIC               1
+#endif // EI_CLASSIFIER_ALLOCATION_STATIC
+
+// Record the start and end of every node of a compiled TFLite model in a ring buffer (ei_profiler.h),
+// and sum the time per operator into ei_impulse_result_timing_t. Costs two clock reads per node.
+#ifndef EI_CLASSIFIER_PROFILE_NODES
+#define EI_CLASSIFIER_PROFILE_NODES                   0
+#endif // EI_CLASSIFIER_PROFILE_NODES
+
+// Number of node events the profiler keeps (a power of two), should hold at least one inference
+#ifndef EI_CLASSIFIER_PROFILER_EVENTS
+#define EI_CLASSIFIER_PROFILER_EVENTS                 32
+#endif // EI_CLASSIFIER_PROFILER_EVENTS
+
+// Number of operator types that are summarized in ei_impulse_result_timing_t
+#ifndef EI_CLASSIFIER_PROFILER_MAX_OPS
+#define EI_CLASSIFIER_PROFILER_MAX_OPS                8
+#endif // EI_CLASSIFIER_PROFILER_MAX_OPS
+
+// Keep the compiled TFLite model (arena, tensors, kernel state), the profiler and the classifier
+// state that is not part of a stream per thread, so threads can classify at the same time
+// (every thread with its own ei_classifier_stream_t). Set together with EIDSP_THREAD_SAFE.
+#ifndef EI_CLASSIFIER_THREAD_SAFE
+#define EI_CLASSIFIER_THREAD_SAFE                     0
+#endif // EI_CLASSIFIER_THREAD_SAFE
+
+#if EI_CLASSIFIER_THREAD_SAFE == 1
+#define EI_CLASSIFIER_THREAD_LOCAL                    thread_local
+#else
+#define EI_CLASSIFIER_THREAD_LOCAL
+#endif // EI_CLASSIFIER_THREAD_SAFE
+
+// Gate the continuous classifier on voice activity: an energy detector with an adaptive noise
+// floor (dsp/vad.hpp) runs on the samples of every slice, and the window is only normalized and
+// classified while one of its slices was active. The MFCC keeps running so the window is complete
+// when activity starts. Skipped slices set ei_impulse_result_t::skipped.
+#ifndef EI_CLASSIFIER_VAD_GATE
+#define EI_CLASSIFIER_VAD_GATE                        0
+#endif // EI_CLASSIFIER_VAD_GATE
+
+// How much louder than the noise floor (in dB) a slice has to be to count as activity
+#ifndef EI_CLASSIFIER_VAD_THRESHOLD_DB
+#define EI_CLASSIFIER_VAD_THRESHOLD_DB                6.0f
+#endif // EI_CLASSIFIER_VAD_THRESHOLD_DB
+
+// RMS (in int16 units) a slice needs at least to count as activity, whatever the noise floor
+#ifndef EI_CLASSIFIER_VAD_MIN_RMS
+#define EI_CLASSIFIER_VAD_MIN_RMS                     32
+#endif // EI_CLASSIFIER_VAD_MIN_RMS
+
 #endif // _EI_CLASSIFIER_CONFIG_H_
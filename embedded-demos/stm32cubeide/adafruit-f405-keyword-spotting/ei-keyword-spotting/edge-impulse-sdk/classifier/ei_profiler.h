@@ -0,0 +1,122 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EI_CLASSIFIER_PROFILER_H_
+#define _EI_CLASSIFIER_PROFILER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_classifier_config.h"
+
+/**
+ * Profiler for compiled TFLite models (enable through EI_CLASSIFIER_PROFILE_NODES).
+ * trained_model_invoke records every node it runs into a ring buffer of
+ * EI_CLASSIFIER_PROFILER_EVENTS events, read them back with ei_profiler_read
+ * after an inference, or get the time per operator from ei_impulse_result_timing_t.
+ * Times are in ticks of the profiler clock: CLOCK_MONOTONIC nanoseconds on Linux / macOS,
+ * elsewhere ei_read_timer_cycles() (f.e. the DWT cycle counter on Cortex-M3/M4/M7), or
+ * ei_read_timer_us() if the target has no cycle counter. Set another clock with
+ * ei_profiler_set_clock.
+ */
+
+/**
+ * Free running clock (may wrap around) for the profiler
+ */
+typedef uint32_t (*ei_profiler_clock_t)(void);
+
+typedef struct {
+    uint32_t sequence;          /* running number of the event */
+    uint16_t node;              /* index of the node in the graph */
+    const char *op;             /* operator, f.e. "CONV_2D" */
+    uint32_t start;             /* clock ticks when the node started */
+    uint32_t end;               /* clock ticks when the node returned */
+    uint32_t scratch_bytes;     /* scratch buffers the node requested in prepare */
+} ei_profiler_event_t;
+
+typedef struct {
+    const char *op;             /* operator, NULL for an unused entry */
+    uint16_t nodes;             /* number of nodes of this operator that ran */
+    uint32_t ticks;             /* clock ticks spent in these nodes */
+    uint32_t scratch_bytes;     /* scratch buffers of these nodes */
+} ei_profiler_op_summary_t;
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+extern "C" {
+#endif // defined(__cplusplus)
+
+/**
+ * Replace the profiler clock
+ * @param clock Clock, or NULL for the default one
+ * @param ticks_per_second Rate of the clock, 0 if unknown
+ */
+void ei_profiler_set_clock(ei_profiler_clock_t clock, uint32_t ticks_per_second);
+
+/**
+ * Read the profiler clock
+ */
+uint32_t ei_profiler_read_clock(void);
+
+/**
+ * Rate of the profiler clock, 0 if unknown
+ */
+uint32_t ei_profiler_ticks_per_second(void);
+
+/**
+ * Add an event to the ring buffer, overwrites the oldest one when it's full
+ */
+void ei_profiler_record(uint16_t node, const char *op, uint32_t start, uint32_t end, uint32_t scratch_bytes);
+
+/**
+ * Sequence number that the next event will get. Read this before an inference
+ * to get the events of that inference afterwards.
+ */
+uint32_t ei_profiler_sequence(void);
+
+/**
+ * Copy the events from a sequence number onwards that are still in the ring buffer, oldest first
+ * @param from_sequence First event to copy
+ * @param events Out buffer
+ * @param max_events Size of the out buffer
+ * @returns Number of events copied
+ */
+size_t ei_profiler_read(uint32_t from_sequence, ei_profiler_event_t *events, size_t max_events);
+
+/**
+ * Sum the events from a sequence number onwards per operator
+ * @param from_sequence First event to include
+ * @param ops Out buffer, entries that are not used get a NULL op
+ * @param max_ops Size of the out buffer, more operators than this are left out
+ * @returns Number of operators
+ */
+size_t ei_profiler_summarize(uint32_t from_sequence, ei_profiler_op_summary_t *ops, size_t max_ops);
+
+/**
+ * Drop all events
+ */
+void ei_profiler_clear(void);
+
+#if defined(__cplusplus) && EI_C_LINKAGE == 1
+}
+#endif // defined(__cplusplus) && EI_C_LINKAGE == 1
+
+#endif // _EI_CLASSIFIER_PROFILER_H_
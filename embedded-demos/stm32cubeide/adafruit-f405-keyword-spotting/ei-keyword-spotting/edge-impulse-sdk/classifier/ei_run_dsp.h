@@ -43,6 +43,7 @@ using namespace ei;
 
 __attribute__((unused)) int extract_spectral_analysis_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr) {
     ei_dsp_config_spectral_analysis_t config = *((ei_dsp_config_spectral_analysis_t*)config_ptr);
+    scratch_arena::scope scratch;
 
     int ret;
 
@@ -128,6 +129,7 @@ __attribute__((unused)) int extract_spectral_analysis_features(signal_t *signal,
 
 __attribute__((unused)) int extract_raw_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr) {
     ei_dsp_config_raw_t config = *((ei_dsp_config_raw_t*)config_ptr);
+    scratch_arena::scope scratch;
 
     // input matrix from the raw signal
     matrix_t input_matrix(signal->total_length / config.axes, config.axes);
@@ -149,6 +151,7 @@ __attribute__((unused)) int extract_raw_features(signal_t *signal, matrix_t *out
 
 __attribute__((unused)) int extract_flatten_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr) {
     ei_dsp_config_flatten_t config = *((ei_dsp_config_flatten_t*)config_ptr);
+    scratch_arena::scope scratch;
 
     uint32_t expected_matrix_size = 0;
     if (config.average) expected_matrix_size += config.axes;
@@ -248,12 +251,85 @@ __attribute__((unused)) int extract_flatten_features(signal_t *signal, matrix_t
     return EIDSP_OK;
 }
 
-static class speechpy::processing::preemphasis *preemphasis;
+#if defined(EI_CLASSIFIER_MFCC_STATIC) && EI_CLASSIFIER_MFCC_STATIC == 1
+/* The MFCC specialized for the MFCC block of the model */
+typedef speechpy::mfcc_static<static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY),
+    EI_CLASSIFIER_MFCC_FRAME_LENGTH, EI_CLASSIFIER_MFCC_FRAME_STRIDE, EI_CLASSIFIER_MFCC_NUM_CEPSTRAL,
+    EI_CLASSIFIER_MFCC_NUM_FILTERS, EI_CLASSIFIER_MFCC_FFT_LENGTH, EI_CLASSIFIER_MFCC_LOW_FREQUENCY,
+    EI_CLASSIFIER_MFCC_HIGH_FREQUENCY, EI_CLASSIFIER_MFCC_PRE_SHIFT> ei_mfcc_static_t;
+
+/**
+ * Whether a block configuration is the one ei_mfcc_static_t was compiled for,
+ * other MFCC blocks go through the generic MFCC
+ */
+static bool mfcc_static_matches(const ei_dsp_config_mfcc_t *config) {
+    const float frequency = static_cast<float>(EI_CLASSIFIER_FREQUENCY);
+    const uint32_t high_frequency = config->high_frequency == 0 ?
+        static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY) / 2 : static_cast<uint32_t>(config->high_frequency);
+
+    return config->axes == 1 &&
+        static_cast<int>(round(frequency * config->frame_length)) == EI_CLASSIFIER_MFCC_FRAME_LENGTH &&
+        static_cast<int>(round(frequency * config->frame_stride)) == EI_CLASSIFIER_MFCC_FRAME_STRIDE &&
+        config->num_cepstral == EI_CLASSIFIER_MFCC_NUM_CEPSTRAL &&
+        config->num_filters == EI_CLASSIFIER_MFCC_NUM_FILTERS &&
+        config->fft_length == EI_CLASSIFIER_MFCC_FFT_LENGTH &&
+        config->low_frequency == EI_CLASSIFIER_MFCC_LOW_FREQUENCY &&
+        high_frequency == EI_CLASSIFIER_MFCC_HIGH_FREQUENCY &&
+        config->pre_shift == EI_CLASSIFIER_MFCC_PRE_SHIFT;
+}
+
+/**
+ * extract_mfcc_features through ei_mfcc_static_t
+ */
+static int extract_mfcc_features_static(signal_t *signal, matrix_t *output_matrix, const ei_dsp_config_mfcc_t *config) {
+    const size_t frames = ei_mfcc_static_t::calculate_no_of_frames(signal->total_length);
+    if (frames * EI_CLASSIFIER_MFCC_NUM_CEPSTRAL > output_matrix->rows * output_matrix->cols) {
+        ei_printf("out_matrix = %ux%u\n", (unsigned)output_matrix->rows, (unsigned)output_matrix->cols);
+        ei_printf("calculated size = %ux%u\n", (unsigned)frames, (unsigned)EI_CLASSIFIER_MFCC_NUM_CEPSTRAL);
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    output_matrix->rows = frames;
+    output_matrix->cols = EI_CLASSIFIER_MFCC_NUM_CEPSTRAL;
+
+    // the MFCC and the normalization run one after the other
+    size_t scratch_size = ei_mfcc_static_t::scratch_size();
+    size_t cmvnw_scratch_size = speechpy::processing::cmvnw_scratch_size(frames);
+    scratch_arena::reserve(scratch_size > cmvnw_scratch_size ? scratch_size : cmvnw_scratch_size);
+    scratch_arena::scope scratch;
+
+    int ret = ei_mfcc_static_t::mfcc(output_matrix, signal, config->pre_cof);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: MFCC failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+    // cepstral mean and variance normalization
+    ret = speechpy::processing::cmvnw(output_matrix, config->win_size, true);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: cmvnw failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+    output_matrix->cols = frames * EI_CLASSIFIER_MFCC_NUM_CEPSTRAL;
+    output_matrix->rows = 1;
+
+    return EIDSP_OK;
+}
+#endif // EI_CLASSIFIER_MFCC_STATIC
+
+static EIDSP_THREAD_LOCAL class speechpy::processing::preemphasis *preemphasis;
 static int preemphasized_audio_signal_get_data(size_t offset, size_t length, float *out_ptr) {
     return preemphasis->get_data(offset, length, out_ptr);
 }
 
 __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr) {
+#if defined(EI_CLASSIFIER_MFCC_STATIC) && EI_CLASSIFIER_MFCC_STATIC == 1
+    if (mfcc_static_matches((ei_dsp_config_mfcc_t*)config_ptr)) {
+        return extract_mfcc_features_static(signal, output_matrix, (ei_dsp_config_mfcc_t*)config_ptr);
+    }
+#endif
+
     ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
 
     if (config.axes != 1) {
@@ -263,28 +339,36 @@ __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *ou
     // @todo: move this to config
     const uint32_t frequency = static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY);
 
-    // preemphasis class to preprocess the audio...
-    class speechpy::processing::preemphasis pre(signal, config.pre_shift, config.pre_cof);
-    preemphasis = &pre;
-
-    signal_t preemphasized_audio_signal;
-    preemphasized_audio_signal.total_length = signal->total_length;
-    preemphasized_audio_signal.get_data = &preemphasized_audio_signal_get_data;
-
     // calculate the size of the MFCC matrix
     matrix_size_t out_matrix_size =
         speechpy::feature::calculate_mfcc_buffer_size(
             signal->total_length, frequency, config.frame_length, config.frame_stride, config.num_cepstral);
     /* Only throw size mismatch error calculated buffer doesn't fit for continuous inferencing */
     if (out_matrix_size.rows * out_matrix_size.cols > output_matrix->rows * output_matrix->cols) {
-        ei_printf("out_matrix = %hux%hu\n", output_matrix->rows, output_matrix->cols);
-        ei_printf("calculated size = %hux%hu\n", out_matrix_size.rows, out_matrix_size.cols);
+        ei_printf("out_matrix = %ux%u\n", (unsigned)output_matrix->rows, (unsigned)output_matrix->cols);
+        ei_printf("calculated size = %ux%u\n", (unsigned)out_matrix_size.rows, (unsigned)out_matrix_size.cols);
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
 
     output_matrix->rows = out_matrix_size.rows;
     output_matrix->cols = out_matrix_size.cols;
 
+    // the MFE matrix and the normalization run one after the other, on top of the pre-emphasis history
+    size_t scratch_size = speechpy::feature::calculate_mfcc_scratch_size(
+        signal->total_length, frequency, config.frame_length, config.frame_stride, config.num_filters, config.fft_length);
+    size_t cmvnw_scratch_size = speechpy::processing::cmvnw_scratch_size(out_matrix_size.rows);
+    scratch_arena::reserve(speechpy::processing::preemphasis::scratch_size(config.pre_shift) +
+        (scratch_size > cmvnw_scratch_size ? scratch_size : cmvnw_scratch_size));
+    scratch_arena::scope scratch;
+
+    // preemphasis class to preprocess the audio...
+    class speechpy::processing::preemphasis pre(signal, config.pre_shift, config.pre_cof);
+    preemphasis = &pre;
+
+    signal_t preemphasized_audio_signal;
+    preemphasized_audio_signal.total_length = signal->total_length;
+    preemphasized_audio_signal.get_data = &preemphasized_audio_signal_get_data;
+
     // and run the MFCC extraction (using 32 rather than 40 filters here to optimize speed on embedded)
     int ret = speechpy::feature::mfcc(output_matrix, &preemphasized_audio_signal,
         frequency, config.frame_length, config.frame_stride, config.num_cepstral, config.num_filters, config.fft_length,
@@ -307,72 +391,187 @@ __attribute__((unused)) int extract_mfcc_features(signal_t *signal, matrix_t *ou
     return EIDSP_OK;
 }
 
+/* Audio and pre-emphasis history of the extract_mfcc_per_slice_features that writes into a matrix */
+static EIDSP_THREAD_LOCAL speechpy::mfcc_stream mfcc_slice_stream;
+
+/**
+ * Drop the audio and pre-emphasis history kept by extract_mfcc_per_slice_features,
+ * call this whenever the audio stream is (re)started.
+ */
+__attribute__((unused)) void extract_mfcc_per_slice_reset() {
+    mfcc_slice_stream.reset();
+}
+
+/**
+ * Set up an MFCC stream for the block configuration on first use, and again
+ * (dropping the buffered audio) whenever the configuration changes
+ */
+template<typename T>
+static int mfcc_slice_stream_init(T *stream, ei_dsp_config_mfcc_t *config) {
+    // @todo: move this to config
+    const uint32_t frequency = static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY);
+
+    const speechpy::mfcc_stream_config_t stream_config = {
+        frequency, config->frame_length, config->frame_stride,
+        static_cast<uint8_t>(config->num_cepstral), static_cast<uint16_t>(config->num_filters),
+        static_cast<uint16_t>(config->fft_length), static_cast<uint32_t>(config->low_frequency),
+        static_cast<uint32_t>(config->high_frequency), config->pre_shift, config->pre_cof };
+    if (stream->is_initialized(stream_config)) {
+        return EIDSP_OK;
+    }
+
+    int ret = stream->init(stream_config.sampling_frequency, stream_config.frame_length, stream_config.frame_stride,
+        stream_config.num_cepstral, stream_config.num_filters, stream_config.fft_length,
+        stream_config.low_frequency, stream_config.high_frequency, stream_config.pre_shift, stream_config.pre_cof);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: MFCC stream init failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+    return EIDSP_OK;
+}
+
+/**
+ * Streaming version of extract_mfcc_features, used for continuous inferencing.
+ * Samples that don't fill a complete frame are kept until the next slice, so every
+ * frame is calculated once and pre-emphasis is continuous over slice boundaries.
+ * On return output_matrix holds the frames that completed in this slice,
+ * the number of frames varies if the slice size is not a multiple of the frame stride.
+ * No normalization is applied, that's done over the full window.
+ */
 __attribute__((unused)) int extract_mfcc_per_slice_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr) {
     ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
 
-    static bool first_run = false;
-
     if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
 
-    /* Fake an extra frame_length for stack frames calculations. There, 1 frame_length is always
-    subtracted and there for never used. But skip the first slice to fit the feature_matrix
-    buffer */
-    if (first_run == true) {
-        signal->total_length += (size_t)(config.frame_length * (float)EI_CLASSIFIER_FREQUENCY);
+    int ret = mfcc_slice_stream_init(&mfcc_slice_stream, &config);
+    if (ret != EIDSP_OK) {
+        EIDSP_ERR(ret);
+    }
+
+    // the spectra of every frame come from the scratch arena rather than the heap
+    scratch_arena::reserve(mfcc_slice_stream.scratch_size());
+    scratch_arena::scope scratch;
+
+    size_t out_frames = mfcc_slice_stream.calculate_no_of_frames(signal->total_length);
+    if (out_frames * config.num_cepstral > output_matrix->rows * output_matrix->cols) {
+        ei_printf("out_matrix = %ux%u\n", (unsigned)output_matrix->rows, (unsigned)output_matrix->cols);
+        ei_printf("calculated size = %ux%u\n", (unsigned)out_frames, (unsigned)config.num_cepstral);
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
 
-    first_run = true;
+    ret = mfcc_slice_stream.process(signal, output_matrix);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: MFCC failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
 
-    // @todo: move this to config
-    const uint32_t frequency = static_cast<uint32_t>(EI_CLASSIFIER_FREQUENCY);
+    output_matrix->cols = output_matrix->rows * output_matrix->cols;
+    output_matrix->rows = 1;
 
-    // preemphasis class to preprocess the audio...
-    class speechpy::processing::preemphasis pre(signal, config.pre_shift, config.pre_cof);
-    preemphasis = &pre;
+    return EIDSP_OK;
+}
 
-    signal_t preemphasized_audio_signal;
-    preemphasized_audio_signal.total_length = signal->total_length;
-    preemphasized_audio_signal.get_data = &preemphasized_audio_signal_get_data;
+/**
+ * Streaming MFCC straight into a feature window that is used as a circular buffer
+ * of frames, so the window never has to be shifted.
+ * @param stream Audio and pre-emphasis history of this audio stream, set up on first use
+ * @param signal Block of audio, any number of samples (f.e. a slice)
+ * @param feature_window Circular buffer of frames (one row of num_cepstral per frame)
+ * @param first_row Row to write the first new frame to
+ * @param out_frames Number of frames that were written
+ * @param config_ptr ei_dsp_config_mfcc_t struct pointer
+ */
+__attribute__((unused)) int extract_mfcc_per_slice_features(speechpy::mfcc_stream *stream, signal_t *signal,
+    matrix_t *feature_window, size_t first_row, size_t *out_frames, void *config_ptr)
+{
+    ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
 
-    // calculate the size of the MFCC matrix
-    matrix_size_t out_matrix_size =
-        speechpy::feature::calculate_mfcc_buffer_size(
-            signal->total_length, frequency, config.frame_length, config.frame_stride, config.num_cepstral);
-    /* Only throw size mismatch error calculated buffer doesn't fit for continuous inferencing */
-    if (out_matrix_size.rows * out_matrix_size.cols > output_matrix->rows * output_matrix->cols) {
-        ei_printf("out_matrix = %hux%hu\n", output_matrix->rows, output_matrix->cols);
-        ei_printf("calculated size = %hux%hu\n", out_matrix_size.rows, out_matrix_size.cols);
+    if (config.axes != 1) {
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
 
-    output_matrix->rows = out_matrix_size.rows;
-    output_matrix->cols = out_matrix_size.cols;
+    int ret = mfcc_slice_stream_init(stream, &config);
+    if (ret != EIDSP_OK) {
+        EIDSP_ERR(ret);
+    }
 
-    // and run the MFCC extraction (using 32 rather than 40 filters here to optimize speed on embedded)
-    int ret = speechpy::feature::mfcc(output_matrix, &preemphasized_audio_signal,
-        frequency, config.frame_length, config.frame_stride, config.num_cepstral, config.num_filters, config.fft_length,
-        config.low_frequency, config.high_frequency);
+    // the spectra of every frame come from the scratch arena rather than the heap
+    scratch_arena::reserve(stream->scratch_size());
+    scratch_arena::scope scratch;
+
+    size_t frames = stream->calculate_no_of_frames(signal->total_length);
+    if (frames > feature_window->rows) {
+        ei_printf("feature window = %u frames\n", (unsigned)feature_window->rows);
+        ei_printf("calculated size = %u frames\n", (unsigned)frames);
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    ret = stream->process(signal, feature_window, first_row, out_frames);
     if (ret != EIDSP_OK) {
         ei_printf("ERR: MFCC failed (%d)\n", ret);
         EIDSP_ERR(ret);
     }
 
-    output_matrix->cols = out_matrix_size.rows * out_matrix_size.cols;
-    output_matrix->rows = 1;
+    return EIDSP_OK;
+}
+
+#if EIDSP_USE_FIXED_POINT
+/**
+ * Integer version of the circular buffer extract_mfcc_per_slice_features
+ * (EIDSP_USE_FIXED_POINT), see speechpy::mfcc_stream_fixed.
+ * @param stream Audio and pre-emphasis history of this audio stream, set up on first use
+ * @param signal Block of audio, any number of samples (f.e. a slice)
+ * @param feature_window Circular buffer of frames (one row of num_cepstral per frame),
+ *     coefficients have speechpy::mfcc_stream_fixed::frac_bits fractional bits
+ * @param window_frames Number of frames in feature_window
+ * @param first_row Row to write the first new frame to
+ * @param out_frames Number of frames that were written
+ * @param config_ptr ei_dsp_config_mfcc_t struct pointer
+ */
+__attribute__((unused)) int extract_mfcc_per_slice_features_fixed(speechpy::mfcc_stream_fixed *stream,
+    signal_t *signal, int32_t *feature_window, size_t window_frames, size_t first_row, size_t *out_frames,
+    void *config_ptr)
+{
+    ei_dsp_config_mfcc_t config = *((ei_dsp_config_mfcc_t*)config_ptr);
+
+    if (config.axes != 1) {
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    int ret = mfcc_slice_stream_init(stream, &config);
+    if (ret != EIDSP_OK) {
+        EIDSP_ERR(ret);
+    }
+
+    size_t frames = stream->calculate_no_of_frames(signal->total_length);
+    if (frames > window_frames) {
+        ei_printf("feature window = %u frames\n", (unsigned)window_frames);
+        ei_printf("calculated size = %u frames\n", (unsigned)frames);
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    ret = stream->process(signal, feature_window, window_frames, first_row, out_frames);
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: MFCC failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
 
     return EIDSP_OK;
 }
+#endif // EIDSP_USE_FIXED_POINT
 
 __attribute__((unused)) int extract_image_features(signal_t *signal, matrix_t *output_matrix, void *config_ptr) {
     ei_dsp_config_image_t config = *((ei_dsp_config_image_t*)config_ptr);
+    scratch_arena::scope scratch;
 
     int16_t channel_count = strcmp(config.channels, "Grayscale") == 0 ? 1 : 3;
 
     if (output_matrix->rows * output_matrix->cols != EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * channel_count) {
-        ei_printf("out_matrix = %hu items\n", output_matrix->rows, output_matrix->cols);
-        ei_printf("calculated size = %hu items\n", EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * channel_count);
+        ei_printf("out_matrix = %u items\n", (unsigned)(output_matrix->rows * output_matrix->cols));
+        ei_printf("calculated size = %u items\n", (unsigned)(EI_CLASSIFIER_INPUT_WIDTH * EI_CLASSIFIER_INPUT_HEIGHT * channel_count));
         EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
     }
 
@@ -81,6 +81,49 @@
 #define EIDSP_TRACK_ALLOCATIONS      0
 #endif // EIDSP_TRACK_ALLOCATIONS
 
+// number of sparse mel filterbanks (one per filterbank configuration) that are kept around
+// between calls to mfe/mfcc, an extra configuration evicts the oldest one
+#ifndef EIDSP_FILTERBANK_CACHE_SIZE
+#define EIDSP_FILTERBANK_CACHE_SIZE  1
+#endif // EIDSP_FILTERBANK_CACHE_SIZE
+
+// number of FFT plans (one per transform size) that are kept around between transforms,
+// the MFCC block needs one (the frame FFT), numpy::dct2 another one
+#ifndef EIDSP_FFT_PLAN_CACHE_SIZE
+#define EIDSP_FFT_PLAN_CACHE_SIZE    2
+#endif // EIDSP_FFT_PLAN_CACHE_SIZE
+
+// number of truncated DCT-II bases (one per number of inputs and coefficients) that are
+// kept around between calls to numpy::dct2_truncated, the MFCC block needs one
+#ifndef EIDSP_DCT_BASIS_CACHE_SIZE
+#define EIDSP_DCT_BASIS_CACHE_SIZE   1
+#endif // EIDSP_DCT_BASIS_CACHE_SIZE
+
+// run the MFCC front end for continuous inferencing on integers (fixed_point.hpp,
+// speechpy/stream_fixed.hpp), and quantize the features straight into the int8 model input
+#ifndef EIDSP_USE_FIXED_POINT
+#define EIDSP_USE_FIXED_POINT        0
+#endif // EIDSP_USE_FIXED_POINT
+
+// serve DSP temporaries (ei_dsp_malloc / ei_dsp_calloc, matrices) from a bump allocator
+// that is released at the end of every extract_* call, instead of from the heap (memory.hpp)
+#ifndef EIDSP_USE_SCRATCH_ARENA
+#define EIDSP_USE_SCRATCH_ARENA      1
+#endif // EIDSP_USE_SCRATCH_ARENA
+
+// keep the DSP caches (FFT plans, filterbanks) and the scratch arena per thread rather than
+// per process, so several threads can run the DSP at the same time. Set together with
+// EI_CLASSIFIER_THREAD_SAFE when using the classifier.
+#ifndef EIDSP_THREAD_SAFE
+#define EIDSP_THREAD_SAFE            0
+#endif // EIDSP_THREAD_SAFE
+
+#if EIDSP_THREAD_SAFE == 1
+#define EIDSP_THREAD_LOCAL           thread_local
+#else
+#define EIDSP_THREAD_LOCAL
+#endif // EIDSP_THREAD_SAFE
+
 #ifndef EIDSP_SIGNAL_C_FN_POINTER
 #define EIDSP_SIGNAL_C_FN_POINTER    0
 #endif // EIDSP_SIGNAL_C_FN_POINTER
@@ -35,22 +35,30 @@
 
 // DCT type II, unscaled
 int ei::dct::transform(float vector[], size_t len) {
-	const size_t fft_data_out_size = (len / 2 + 1) * sizeof(ei::fft_complex_t);
-	const size_t fft_data_in_size = len * sizeof(float);
-
-	// Allocate KissFFT input / output buffer
-    fft_complex_t *fft_data_out =
-		(ei::fft_complex_t*)ei_dsp_calloc(fft_data_out_size, 1);
-	if (!fft_data_out) {
-		return ei::EIDSP_OUT_OF_MEM;
+	// the FFT plan holds the input / output buffers and the twiddles
+	ei::fft_plan_t *plan;
+	int r = ei::numpy::fft_plan(&plan, ei::FFT_PLAN_REAL, len);
+	if (r != 0) {
+		return r;
 	}
 
-    float *fft_data_in = (float*)ei_dsp_calloc(fft_data_in_size, 1);
-	if (!fft_data_in) {
-		ei_dsp_free(fft_data_out, fft_data_out_size);
-		return ei::EIDSP_OUT_OF_MEM;
+	if (!plan->twiddles) {
+		// cached with the plan, so it outlives the current scratch scope
+		ei::scratch_arena::bypass bypass;
+		plan->twiddles = (float*)ei_dsp_calloc((len / 2 + 1) * 2, sizeof(float));
+		if (!plan->twiddles) {
+			return ei::EIDSP_OUT_OF_MEM;
+		}
+		for (size_t i = 0; i < len / 2 + 1; i++) {
+			float temp = i * M_PI / (len * 2);
+			plan->twiddles[i * 2] = cos(temp);
+			plan->twiddles[i * 2 + 1] = sin(temp);
+		}
 	}
 
+	float *fft_data_in = plan->input;
+	ei::fft_complex_t *fft_data_out = plan->spectrum;
+
 	// Preprocess the input buffer with the data from the vector
 	size_t halfLen = len / 2;
 	for (size_t i = 0; i < halfLen; i++) {
@@ -61,52 +69,29 @@ int ei::dct::transform(float vector[], size_t len) {
 		fft_data_in[halfLen] = vector[len - 1];
 	}
 
-	int r = ei::numpy::rfft(fft_data_in, len, fft_data_out, (len / 2 + 1), len);
+	r = ei::numpy::rfft(fft_data_in, len, fft_data_out, (len / 2 + 1), len);
 	if (r != 0) {
-		ei_dsp_free(fft_data_in, fft_data_in_size);
-		ei_dsp_free(fft_data_out, fft_data_out_size);
 		return r;
 	}
 
 	for (size_t i = 0; i < len / 2 + 1; i++) {
-		float temp = i * M_PI / (len * 2);
-		vector[i] = fft_data_out[i].r * cos(temp) + fft_data_out[i].i * sin(temp);
+		vector[i] = fft_data_out[i].r * plan->twiddles[i * 2] + fft_data_out[i].i * plan->twiddles[i * 2 + 1];
 	}
 
-	ei_dsp_free(fft_data_in, fft_data_in_size);
-	ei_dsp_free(fft_data_out, fft_data_out_size);
-
 	return 0;
 }
 
 // DCT type III, unscaled
 int ei::dct::inverse_transform(float vector[], size_t len) {
-	const size_t fft_data_out_size = len * sizeof(kiss_fft_cpx);
-	const size_t fft_data_in_size = len * sizeof(kiss_fft_cpx);
-
-	// Allocate KissFFT input / output buffer
-    kiss_fft_cpx *fft_data_out = (kiss_fft_cpx*)ei_dsp_calloc(fft_data_out_size, 1);
-	if (!fft_data_out) {
-		return ei::EIDSP_OUT_OF_MEM;
-	}
-
-    kiss_fft_cpx *fft_data_in = (kiss_fft_cpx*)ei_dsp_calloc(fft_data_in_size, 1);
-	if (!fft_data_in) {
-		ei_dsp_free(fft_data_out, fft_data_out_size);
-		return ei::EIDSP_OUT_OF_MEM;
-	}
-
-	size_t kiss_fftr_mem_length;
-
-    // Allocate KissFFT configuration
-    kiss_fft_cfg cfg = kiss_fft_alloc(len, 0, NULL, NULL, &kiss_fftr_mem_length);
-	if (!cfg) {
-		ei_dsp_free(fft_data_in, fft_data_in_size);
-		ei_dsp_free(fft_data_out, fft_data_out_size);
-		return ei::EIDSP_OUT_OF_MEM;
+	// the FFT plan holds the input / output buffers
+	ei::fft_plan_t *plan;
+	int r = ei::numpy::fft_plan(&plan, ei::FFT_PLAN_COMPLEX, len);
+	if (r != 0) {
+		return r;
 	}
 
-	ei_dsp_register_alloc(kiss_fftr_mem_length);
+	kiss_fft_cpx *fft_data_in = (kiss_fft_cpx*)plan->input;
+	kiss_fft_cpx *fft_data_out = (kiss_fft_cpx*)plan->output;
 
 	// Preprocess and transform
 	if (len > 0) {
@@ -116,10 +101,10 @@ int ei::dct::inverse_transform(float vector[], size_t len) {
 	for (size_t i = 0; i < len; i++) {
 		float temp = i * M_PI / (len * 2);
 		fft_data_in[i].r = vector[i] * cos(temp);
-		fft_data_in[i].i *= -sin(temp);
+		fft_data_in[i].i = 0.0f;
 	}
 
-	kiss_fft(cfg, fft_data_in, fft_data_out);
+	kiss_fft((kiss_fft_cfg)plan->kiss_cfg, fft_data_in, fft_data_out);
 
 	// Postprocess the vectors
 	size_t halfLen = len / 2;
@@ -132,9 +117,5 @@ int ei::dct::inverse_transform(float vector[], size_t len) {
 		vector[len - 1] = fft_data_out[halfLen].r;
 	}
 
-	ei_dsp_free(cfg, kiss_fftr_mem_length);
-	ei_dsp_free(fft_data_in, fft_data_in_size);
-	ei_dsp_free(fft_data_out, fft_data_out_size);
-
 	return ei::EIDSP_OK;
 }
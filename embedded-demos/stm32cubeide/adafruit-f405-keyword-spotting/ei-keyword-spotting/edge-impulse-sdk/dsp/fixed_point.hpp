@@ -0,0 +1,388 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_FIXED_POINT_H_
+#define _EIDSP_FIXED_POINT_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <stddef.h>
+#include <cfloat>
+#include <cmath>
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/config.hpp"
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/memory.hpp"
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/returntypes.hpp"
+#if EIDSP_USE_CMSIS_DSP
+#include "edge-impulse-sdk/CMSIS/DSP/Include/arm_math.h"
+#else
+#include <complex>
+#include <new>
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/kissfft/kissfft_i32.hh"
+#endif
+
+namespace ei {
+
+/**
+ * Integer helpers for the fixed-point front end (EIDSP_USE_FIXED_POINT).
+ * Values are plain integers with an implicit number of fractional bits,
+ * f.e. Q16 means the real value is the integer divided by 2^16.
+ */
+class fixed_point {
+public:
+    /**
+     * Index of the highest set bit
+     * @returns -1 if v is 0
+     */
+    static inline int msb(uint32_t v) {
+        return v == 0 ? -1 : 31 - __builtin_clz(v);
+    }
+
+    /**
+     * Index of the highest set bit
+     * @returns -1 if v is 0
+     */
+    static inline int msb(uint64_t v) {
+        return v == 0 ? -1 : 63 - __builtin_clzll(v);
+    }
+
+    /**
+     * Absolute value, also for INT32_MIN
+     */
+    static inline uint32_t abs(int32_t v) {
+        return v < 0 ? static_cast<uint32_t>(0) - static_cast<uint32_t>(v) : static_cast<uint32_t>(v);
+    }
+
+    /**
+     * Arithmetic shift right with rounding (half away from zero)
+     */
+    static inline int64_t round_shift(int64_t v, int shift) {
+        if (shift <= 0) {
+            return v << -shift;
+        }
+        int64_t half = static_cast<int64_t>(1) << (shift - 1);
+        return v >= 0 ? (v + half) >> shift : -((-v + half) >> shift);
+    }
+
+    /**
+     * Integer division with rounding (half away from zero), d should be positive
+     */
+    static inline int64_t round_div(int64_t n, int64_t d) {
+        return n >= 0 ? (n + (d / 2)) / d : -((-n + (d / 2)) / d);
+    }
+
+    static inline int32_t saturate(int64_t v, int32_t min, int32_t max) {
+        return v < min ? min : (v > max ? max : static_cast<int32_t>(v));
+    }
+
+    /**
+     * Base-2 logarithm, using a 64 segment table of log2(1 + x) with
+     * linear interpolation. The maximum error is about 1e-4.
+     * @param v Value, should be larger than 0
+     * @returns log2(v) in Q16
+     */
+    static int32_t log2_q16(uint64_t v) {
+        // log2(1 + i / 64) in Q16
+        static const uint32_t log2_table[65] = {
+            0, 1466, 2909, 4331, 5732, 7112, 8473, 9814,
+            11136, 12440, 13727, 14996, 16248, 17484, 18704, 19909,
+            21098, 22272, 23433, 24579, 25711, 26830, 27936, 29029,
+            30109, 31178, 32234, 33279, 34312, 35334, 36346, 37346,
+            38336, 39316, 40286, 41246, 42196, 43137, 44068, 44990,
+            45904, 46809, 47705, 48593, 49472, 50344, 51207, 52063,
+            52911, 53751, 54584, 55410, 56229, 57040, 57845, 58643,
+            59434, 60219, 60997, 61769, 62534, 63294, 64047, 64794,
+            65536
+        };
+
+        int exp = msb(v);
+        if (exp < 0) {
+            return INT32_MIN;
+        }
+
+        // 16 bits of the mantissa, below the leading one
+        uint32_t frac = exp >= 16 ?
+            static_cast<uint32_t>(v >> (exp - 16)) & 0xffff :
+            static_cast<uint32_t>(v << (16 - exp)) & 0xffff;
+
+        uint32_t ix = frac >> 10;
+        int32_t t = static_cast<int32_t>(frac & 0x3ff);
+        int32_t lo = log2_table[ix];
+        int32_t hi = log2_table[ix + 1];
+
+        return (exp << 16) + lo + (((hi - lo) * t) >> 10);
+    }
+
+    /**
+     * Natural logarithm of v * 2^exponent. A value of 0 maps to ln(FLT_EPSILON),
+     * like functions::zero_handling does for the float front end.
+     * @param v Value
+     * @param exponent Binary exponent of v
+     * @returns ln(v * 2^exponent) in Q16
+     */
+    static int32_t ln_q16(uint64_t v, int exponent) {
+        // ln(2) in Q16
+        const int64_t ln2_q16 = 45426;
+        // ln(FLT_EPSILON) in Q16
+        const int32_t ln_epsilon_q16 = -1044800;
+
+        if (v == 0) {
+            return ln_epsilon_q16;
+        }
+
+        int64_t log2_v = static_cast<int64_t>(log2_q16(v)) + (static_cast<int64_t>(exponent) << 16);
+        return static_cast<int32_t>(round_shift(log2_v * ln2_q16, 16));
+    }
+
+    /**
+     * Integer square root
+     * @returns floor(sqrt(v))
+     */
+    static uint32_t sqrt(uint64_t v) {
+        uint64_t res = 0;
+        uint64_t bit = static_cast<uint64_t>(1) << 62;
+
+        while (bit > v) {
+            bit >>= 2;
+        }
+
+        while (bit != 0) {
+            if (v >= res + bit) {
+                v -= res + bit;
+                res = (res >> 1) + bit;
+            }
+            else {
+                res >>= 1;
+            }
+            bit >>= 2;
+        }
+
+        return static_cast<uint32_t>(res);
+    }
+};
+
+/**
+ * Real FFT on 32-bit integers, with block floating point scaling: the input is
+ * normalized to the headroom the transform needs, and the scale is returned as
+ * a binary exponent next to the spectrum.
+ * Uses arm_rfft_q31 when CMSIS-DSP is available, and the integer KISS FFT otherwise.
+ */
+class fixed_rfft {
+public:
+    fixed_rfft()
+        : _n_fft(0), _in(NULL), _out(NULL)
+#if !EIDSP_USE_CMSIS_DSP
+        , _kiss(NULL)
+#endif
+    {
+    }
+
+    ~fixed_rfft() {
+        free_buffers();
+    }
+
+    /**
+     * Configure the transform. Can be called again to re-configure.
+     * @param n_fft Number of FFT points, a power of 2 between 32 and 8192
+     * @returns EIDSP_OK if OK
+     */
+    int init(uint16_t n_fft) {
+        scratch_arena::bypass bypass;
+
+        free_buffers();
+
+        int log2_n = fixed_point::msb(static_cast<uint32_t>(n_fft));
+        if (n_fft < 32 || n_fft > 8192 || (1 << log2_n) != n_fft) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        _n_fft = n_fft;
+        _log2_n = log2_n;
+
+#if EIDSP_USE_CMSIS_DSP
+        // arm_rfft_q31 needs room for the full (mirrored) spectrum
+        _in = (q31_t*)ei_dsp_malloc(_n_fft * sizeof(q31_t));
+        _out = (q31_t*)ei_dsp_malloc(_n_fft * 2 * sizeof(q31_t));
+        if (!_in || !_out) {
+            free_buffers();
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        arm_status status = arm_rfft_init_q31(&_rfft, _n_fft, 0, 1);
+        if (status != ARM_MATH_SUCCESS) {
+            free_buffers();
+            EIDSP_ERR(status);
+        }
+#else
+        _in = (std::complex<int32_t>*)ei_dsp_calloc(_n_fft * sizeof(std::complex<int32_t>), 1);
+        _out = (std::complex<int32_t>*)ei_dsp_calloc(_n_fft * sizeof(std::complex<int32_t>), 1);
+        // twiddles in Q10
+        _kiss = new (std::nothrow) kissfft_i32(_n_fft, false, 1024.0);
+        if (!_in || !_out || !_kiss) {
+            free_buffers();
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+#endif
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Number of FFT points
+     */
+    uint16_t size() {
+        return _n_fft;
+    }
+
+    /**
+     * Real FFT of the input. The scale of the input is irrelevant, it's normalized
+     * first; the output relates to the input as DFT(input)[k] = output[k] * 2^exponent.
+     * @param input Input, if larger than n_fft it's truncated, if smaller it's zero-padded
+     * @param input_size Number of input samples
+     * @param output Complex output (real and imaginary interleaved) for bins 0..n_fft/2,
+     *   so n_fft + 2 values
+     * @param exponent Binary exponent of the output
+     * @returns EIDSP_OK if OK
+     */
+    int transform(const int32_t *input, size_t input_size, int32_t *output, int *exponent) {
+        if (_n_fft == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        if (input_size > _n_fft) {
+            input_size = _n_fft;
+        }
+
+        uint32_t max = 0;
+        for (size_t ix = 0; ix < input_size; ix++) {
+            uint32_t a = fixed_point::abs(input[ix]);
+            if (a > max) {
+                max = a;
+            }
+        }
+
+        const size_t out_size = _n_fft + 2;
+
+        if (max == 0) {
+            memset(output, 0, out_size * sizeof(int32_t));
+            *exponent = 0;
+            return EIDSP_OK;
+        }
+
+        // put the largest sample at the highest bit the transform can take without overflowing
+        int shift = input_msb() - fixed_point::msb(max);
+
+#if EIDSP_USE_CMSIS_DSP
+        for (size_t ix = 0; ix < input_size; ix++) {
+            _in[ix] = static_cast<q31_t>(fixed_point::round_shift(input[ix], -shift));
+        }
+        for (size_t ix = input_size; ix < _n_fft; ix++) {
+            _in[ix] = 0;
+        }
+
+        // modifies _in
+        arm_rfft_q31(&_rfft, _in, _out);
+
+        memcpy(output, _out, out_size * sizeof(int32_t));
+
+        // arm_rfft_q31 scales the output down by n_fft to stay in range
+        *exponent = _log2_n - shift;
+#else
+        for (size_t ix = 0; ix < input_size; ix++) {
+            _in[ix] = std::complex<int32_t>(
+                static_cast<int32_t>(fixed_point::round_shift(input[ix], -shift)), 0);
+        }
+        for (size_t ix = input_size; ix < _n_fft; ix++) {
+            _in[ix] = std::complex<int32_t>(0, 0);
+        }
+
+        _kiss->transform(_in, _out);
+
+        for (size_t ix = 0; ix < out_size / 2; ix++) {
+            output[ix * 2] = _out[ix].real();
+            output[ix * 2 + 1] = _out[ix].imag();
+        }
+
+        *exponent = -shift;
+#endif
+
+        return EIDSP_OK;
+    }
+
+private:
+    /**
+     * Highest bit the largest input sample is moved to
+     */
+    int input_msb() {
+#if EIDSP_USE_CMSIS_DSP
+        // q31 with a sign bit, arm_rfft_q31 scales down per stage itself
+        return 30;
+#else
+        // the KISS FFT grows by up to n_fft, and multiplies by twiddles in Q10 in
+        // 32-bit integers, so keep n_fft * max * 2^10 * sqrt(2) below 2^31
+        return 19 - _log2_n;
+#endif
+    }
+
+    void free_buffers() {
+#if EIDSP_USE_CMSIS_DSP
+        if (_in) {
+            ei_dsp_free(_in, _n_fft * sizeof(q31_t));
+            _in = NULL;
+        }
+        if (_out) {
+            ei_dsp_free(_out, _n_fft * 2 * sizeof(q31_t));
+            _out = NULL;
+        }
+#else
+        if (_in) {
+            ei_dsp_free(_in, _n_fft * sizeof(std::complex<int32_t>));
+            _in = NULL;
+        }
+        if (_out) {
+            ei_dsp_free(_out, _n_fft * sizeof(std::complex<int32_t>));
+            _out = NULL;
+        }
+        if (_kiss) {
+            delete _kiss;
+            _kiss = NULL;
+        }
+#endif
+        _n_fft = 0;
+    }
+
+    uint16_t _n_fft;
+    int _log2_n;
+#if EIDSP_USE_CMSIS_DSP
+    arm_rfft_instance_q31 _rfft;
+    q31_t *_in;
+    q31_t *_out;
+#else
+    std::complex<int32_t> *_in;
+    std::complex<int32_t> *_out;
+    kissfft_i32 *_kiss;
+#endif
+};
+
+} // namespace ei
+
+#endif // _EIDSP_FIXED_POINT_H_
@@ -1,7 +1,9 @@
 #ifndef KISSFFT_I32_CLASS_HH
 #define KISSFFT_I32_CLASS_HH
 
+#include <cmath>
 #include <complex>
+#include <cstdint>
 #include <utility>
 #include <vector>
 
@@ -21,7 +23,7 @@ class kissfft_i32
 private:
 
     using scalar_type = int32_t;
-    using cpx_type    = complex<int32_t>;
+    using cpx_type    = std::complex<int32_t>;
 
     scalar_type _scale_factor;
     std::size_t _nfft;
@@ -41,7 +43,7 @@ public:
         const double phinc = (_inverse ? 2 : -2) * acos(-1.0) / _nfft;
         for (std::size_t i = 0; i < _nfft; ++i)
         {
-            _twiddles[i] = scale_factor * exp(complex<double>(0, i * phinc));
+            _twiddles[i] = scale_factor * std::exp(std::complex<double>(0, i * phinc));
         }
         //factorize
         //start factoring out 4's, then 2's, then 3,5,7,9,...
@@ -23,7 +23,6 @@
 #ifndef _EIDSP_SPEECHPY_FEATURE_H_
 #define _EIDSP_SPEECHPY_FEATURE_H_
 
-#include <vector>
 #include <stdint.h>
 
 #include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/memory.hpp"
@@ -33,6 +32,23 @@
 namespace ei {
 namespace speechpy {
 
+/**
+ * Mel filterbank that only holds the non-zero weights, as one run of
+ * consecutive FFT bins per filter. Each triangle covers only a few bins,
+ * so this is a fraction of the size of the dense num_filters x coefficients matrix.
+ */
+typedef struct {
+    uint16_t num_filters;
+    int coefficients;
+    uint32_t sampling_freq;
+    uint32_t low_freq;
+    uint32_t high_freq;
+    uint16_t *start;        // first FFT bin of every filter
+    uint16_t *length;       // number of bins of every filter
+    float *weights;         // weights of all filters, back to back
+    size_t weights_size;    // number of elements in weights
+} sparse_filterbank_t;
+
 class feature {
 public:
     /**
@@ -62,15 +78,6 @@ public:
         bool output_transposed = false
         )
     {
-        const size_t mels_mem_size = (num_filter + 2) * sizeof(float);
-        const size_t hertz_mem_size = (num_filter + 2) * sizeof(float);
-        const size_t freq_index_mem_size = (num_filter + 2) * sizeof(int);
-
-        float *mels = (float*)ei_dsp_malloc(mels_mem_size);
-        if (!mels) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-
         if (filterbanks->rows != num_filter || filterbanks->cols != static_cast<uint32_t>(coefficients)) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
@@ -81,54 +88,17 @@ public:
         memset(filterbanks->buffer, 0, filterbanks->rows * filterbanks->cols * sizeof(float));
 #endif
 
-        // Computing the Mel filterbank
-        // converting the upper and lower frequencies to Mels.
-        // num_filter + 2 is because for num_filter filterbanks we need
-        // num_filter+2 point.
-        numpy::linspace(
-            functions::frequency_to_mel(static_cast<float>(low_freq)),
-            functions::frequency_to_mel(static_cast<float>(high_freq)),
-            num_filter + 2,
-            mels);
-
-        // we should convert Mels back to Hertz because the start and end-points
-        // should be at the desired frequencies.
-        float *hertz = (float*)ei_dsp_malloc(hertz_mem_size);
-        if (!hertz) {
-            ei_dsp_free(mels, mels_mem_size);
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-        for (uint16_t ix = 0; ix < num_filter + 2; ix++) {
-            hertz[ix] = functions::mel_to_frequency(mels[ix]);
-            if (hertz[ix] < low_freq) {
-                hertz[ix] = low_freq;
-            }
-            if (hertz[ix] > high_freq) {
-                hertz[ix] = high_freq;
-            }
-
-            // here is a really annoying bug in Speechpy which calculates the frequency index wrong for the last bucket
-            // the last 'hertz' value is not 8,000 (with sampling rate 16,000) but 7,999.999999
-            // thus calculating the bucket to 64, not 65.
-            // we're adjusting this here a tiny bit to ensure we have the same result
-            if (ix == num_filter + 2 - 1) {
-                hertz[ix] -= 0.001;
-            }
-        }
-        ei_dsp_free(mels, mels_mem_size);
-
-        // The frequency resolution required to put filters at the
-        // exact points calculated above should be extracted.
-        //  So we should round those frequencies to the closest FFT bin.
+        const size_t freq_index_mem_size = (num_filter + 2) * sizeof(int);
         int *freq_index = (int*)ei_dsp_malloc(freq_index_mem_size);
         if (!freq_index) {
-            ei_dsp_free(hertz, hertz_mem_size);
             EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
-        for (uint16_t ix = 0; ix < num_filter + 2; ix++) {
-            freq_index[ix] = static_cast<int>(floor((coefficients + 1) * hertz[ix] / sampling_freq));
+
+        int ret = filterbank_edges(freq_index, num_filter, coefficients, sampling_freq, low_freq, high_freq);
+        if (ret != EIDSP_OK) {
+            ei_dsp_free(freq_index, freq_index_mem_size);
+            EIDSP_ERR(ret);
         }
-        ei_dsp_free(hertz, hertz_mem_size);
 
         for (size_t i = 0; i < num_filter; i++) {
             int left = freq_index[i];
@@ -140,8 +110,7 @@ public:
                 ei_dsp_free(freq_index, freq_index_mem_size);
                 EIDSP_ERR(EIDSP_OUT_OF_MEM);
             }
-            numpy::linspace(left, right, (right - left + 1), z.buffer);
-            functions::triangle(z.buffer, (right - left + 1), left, middle, right);
+            filterbank_triangle(z.buffer, left, middle, right);
 
             // so... z now contains some values that we need to overwrite in the filterbank
             for (int zx = 0; zx < (right - left + 1); zx++) {
@@ -170,6 +139,104 @@ public:
         return EIDSP_OK;
     }
 
+    /**
+     * Get the sparse Mel-filterbank for a configuration. Filterbanks are built on first use
+     * and kept in a cache (EIDSP_FILTERBANK_CACHE_SIZE entries), so subsequent calls
+     * with the same configuration are just a lookup.
+     * The filterbank stays valid until a call for a different configuration evicts it,
+     * or until clear_filterbank_cache() is called. With EIDSP_THREAD_SAFE every thread
+     * has its own cache.
+     * @param filterbank Out, pointer to the filterbank
+     * @param num_filter the number of filters in the filterbank
+     * @param coefficients (fftpoints//2 + 1)
+     * @param sampling_freq  the samplerate of the signal we are working
+     *                       with. It affects mel spacing.
+     * @param low_freq lowest band edge of mel filters
+     * @param high_freq highest band edge of mel filters
+     * @returns EIDSP_OK if OK
+     */
+    static int sparse_filterbank(const sparse_filterbank_t **filterbank,
+        uint16_t num_filter, int coefficients, uint32_t sampling_freq,
+        uint32_t low_freq, uint32_t high_freq)
+    {
+        sparse_filterbank_cache_t *cache = filterbank_cache();
+
+        for (size_t ix = 0; ix < EIDSP_FILTERBANK_CACHE_SIZE; ix++) {
+            sparse_filterbank_t *entry = &cache->entries[ix];
+            if (entry->weights &&
+                entry->num_filters == num_filter && entry->coefficients == coefficients &&
+                entry->sampling_freq == sampling_freq &&
+                entry->low_freq == low_freq && entry->high_freq == high_freq) {
+
+                *filterbank = entry;
+                return EIDSP_OK;
+            }
+        }
+
+        // cached, so it outlives the current scratch scope
+        scratch_arena::bypass bypass;
+
+        sparse_filterbank_t *entry = &cache->entries[cache->next];
+        free_sparse_filterbank(entry);
+
+        int ret = build_sparse_filterbank(entry, num_filter, coefficients, sampling_freq, low_freq, high_freq);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        cache->next = (cache->next + 1) % EIDSP_FILTERBANK_CACHE_SIZE;
+
+        *filterbank = entry;
+        return EIDSP_OK;
+    }
+
+    /**
+     * Free all cached sparse Mel-filterbanks
+     */
+    static void clear_filterbank_cache() {
+        sparse_filterbank_cache_t *cache = filterbank_cache();
+
+        for (size_t ix = 0; ix < EIDSP_FILTERBANK_CACHE_SIZE; ix++) {
+            free_sparse_filterbank(&cache->entries[ix]);
+        }
+        cache->next = 0;
+    }
+
+    /**
+     * Calculate the Mel-filterbank energies of a power spectrum. Only visits the
+     * non-zero weights of every filter, about two per FFT bin in total,
+     * rather than num_filters per FFT bin for the dense filterbank.
+     * @param filterbank Sparse filterbank
+     * @param power_spectrum Power spectrum of a frame
+     * @param power_spectrum_size Number of elements in power_spectrum (fftpoints//2 + 1)
+     * @param out_energies Out buffer, num_filters elements
+     * @returns EIDSP_OK if OK
+     */
+    static int mel_energies(const sparse_filterbank_t *filterbank,
+        const float *power_spectrum, size_t power_spectrum_size, float *out_energies)
+    {
+        if (power_spectrum_size != static_cast<size_t>(filterbank->coefficients)) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        const float *weights = filterbank->weights;
+
+        for (uint16_t i = 0; i < filterbank->num_filters; i++) {
+            const float *bins = power_spectrum + filterbank->start[i];
+            const uint16_t length = filterbank->length[i];
+
+            float energy = 0.0f;
+            for (uint16_t k = 0; k < length; k++) {
+                energy += bins[k] * weights[k];
+            }
+
+            out_energies[i] = energy;
+            weights += length;
+        }
+
+        return EIDSP_OK;
+    }
+
     /**
      * Compute Mel-filterbank energy features from an audio signal.
      * @param out_features Use `calculate_mfe_buffer_size` to allocate the right matrix.
@@ -188,13 +255,16 @@ public:
      *     In Hz, default is 0.
      * @param high_frequency (int): highest band edge of mel filters.
      *     In Hz, default is samplerate/2
+     * @param zero_handling Replace zero energies by FLT_EPSILON. Leave it to
+     *     numpy::log(matrix, true) if the log is taken next, that does it in the same pass.
      * @EIDSP_OK if OK
      */
     static int mfe(matrix_t *out_features, matrix_t *out_energies,
         signal_t *signal,
         uint32_t sampling_frequency,
         float frame_length = 0.02f, float frame_stride = 0.02f, uint16_t num_filters = 40,
-        uint16_t fft_length = 512, uint32_t low_frequency = 300, uint32_t high_frequency = 0
+        uint16_t fft_length = 512, uint32_t low_frequency = 300, uint32_t high_frequency = 0,
+        bool zero_handling = true
         )
     {
         int ret = 0;
@@ -203,7 +273,7 @@ public:
             high_frequency = sampling_frequency / 2;
         }
 
-        stack_frames_info_t stack_frame_info = { 0 };
+        stack_frames_info_t stack_frame_info = {};
         stack_frame_info.signal = signal;
 
         ret = processing::stack_frames(
@@ -217,7 +287,7 @@ public:
             EIDSP_ERR(ret);
         }
 
-        if (stack_frame_info.frame_ixs->size() != out_features->rows) {
+        if (stack_frame_info.frame_count != out_features->rows) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
@@ -225,7 +295,7 @@ public:
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
-        if (stack_frame_info.frame_ixs->size() != out_energies->rows || out_energies->cols != 1) {
+        if (stack_frame_info.frame_count != out_energies->rows || out_energies->cols != 1) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
@@ -235,23 +305,14 @@ public:
 
         uint16_t coefficients = fft_length / 2 + 1;
 
-        // calculate the filterbanks first... preferably I would want to do the matrix multiplications
-        // whenever they happen, but OK...
-#if EIDSP_QUANTIZE_FILTERBANK
-        EI_DSP_QUANTIZED_MATRIX(filterbanks, num_filters, coefficients, &numpy::dequantize_zero_one);
-#else
-        EI_DSP_MATRIX(filterbanks, num_filters, coefficients);
-#endif
-        if (!filterbanks.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
-        }
-
-        ret = feature::filterbanks(
-            &filterbanks, num_filters, coefficients, sampling_frequency, low_frequency, high_frequency, true);
+        // the filterbank is only built on the first call for this configuration
+        const sparse_filterbank_t *filterbank;
+        ret = feature::sparse_filterbank(
+            &filterbank, num_filters, coefficients, sampling_frequency, low_frequency, high_frequency);
         if (ret != 0) {
             EIDSP_ERR(ret);
         }
-        for (size_t ix = 0; ix < stack_frame_info.frame_ixs->size(); ix++) {
+        for (size_t ix = 0; ix < stack_frame_info.frame_count; ix++) {
             size_t power_spectrum_frame_size = (fft_length / 2 + 1);
 
             EI_DSP_MATRIX(power_spectrum_frame, 1, power_spectrum_frame_size);
@@ -263,11 +324,10 @@ public:
             EI_DSP_MATRIX(signal_frame, 1, stack_frame_info.frame_length);
 
             // don't read outside of the audio buffer... we'll automatically zero pad then
-            size_t signal_offset = stack_frame_info.frame_ixs->at(ix);
+            size_t signal_offset = stack_frame_info.frame_offset(ix);
             size_t signal_length = stack_frame_info.frame_length;
             if (signal_offset + signal_length > stack_frame_info.signal->total_length) {
-                signal_length = signal_length -
-                    (stack_frame_info.signal->total_length - (signal_offset + signal_length));
+                signal_length = stack_frame_info.signal->total_length - signal_offset;
             }
 
             ret = stack_frame_info.signal->get_data(
@@ -279,19 +339,20 @@ public:
                 EIDSP_ERR(ret);
             }
 
+            float energy;
             ret = processing::power_spectrum(
                 signal_frame.buffer,
                 stack_frame_info.frame_length,
                 power_spectrum_frame.buffer,
                 power_spectrum_frame_size,
-                fft_length
+                fft_length,
+                &energy
             );
 
             if (ret != 0) {
                 EIDSP_ERR(ret);
             }
 
-            float energy = numpy::sum(power_spectrum_frame.buffer, power_spectrum_frame_size);
             if (energy == 0) {
                 energy = FLT_EPSILON;
             }
@@ -299,12 +360,11 @@ public:
             out_energies->buffer[ix] = energy;
 
             // calculate the out_features directly here
-            ret = numpy::dot_by_row(
-                ix,
+            ret = feature::mel_energies(
+                filterbank,
                 power_spectrum_frame.buffer,
                 power_spectrum_frame_size,
-                &filterbanks,
-                out_features
+                out_features->buffer + (ix * out_features->cols)
             );
 
             if (ret != 0) {
@@ -312,7 +372,9 @@ public:
             }
         }
 
-        functions::zero_handling(out_features);
+        if (zero_handling) {
+            functions::zero_handling(out_features);
+        }
 
         return EIDSP_OK;
     }
@@ -403,35 +465,29 @@ public:
 
         ret = mfe(&features_matrix, &energy_matrix, signal,
             sampling_frequency, frame_length, frame_stride, num_filters, fft_length,
-            low_frequency, high_frequency);
+            low_frequency, high_frequency, false);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
 
         // ok... now we need to calculate the MFCC from this...
-        // first do log() over all features...
-        ret = numpy::log(&features_matrix);
+        // first do log() over all features, zeros replaced by FLT_EPSILON in the same pass
+        ret = numpy::log(&features_matrix, true);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
 
-        // now do DST type 2
-        ret = numpy::dct2(&features_matrix, DCT_NORMALIZATION_ORTHO);
+        // now do DCT type 2, only the coefficients we keep, straight into the output
+        ret = numpy::dct2_truncated(&features_matrix, out_features);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
 
         // replace first cepstral coefficient with log of frame energy for DC elimination
         if (dc_elimination) {
-            for (size_t row = 0; row < features_matrix.rows; row++) {
-                features_matrix.buffer[row * features_matrix.cols] = numpy::log(energy_matrix.buffer[row]);
-            }
-        }
-
-        // copy to the output...
-        for (size_t row = 0; row < features_matrix.rows; row++) {
-            for(int i = 0; i < num_cepstral; i++) {
-                *(out_features->buffer + (num_cepstral * row) + i) = *(features_matrix.buffer + (features_matrix.cols * row) + i);
+            numpy::log(energy_matrix.buffer, energy_matrix.buffer, energy_matrix.rows);
+            for (size_t row = 0; row < out_features->rows; row++) {
+                out_features->buffer[row * out_features->cols] = energy_matrix.buffer[row];
             }
         }
 
@@ -464,6 +520,217 @@ public:
         size_matrix.cols = cols;
         return size_matrix;
     }
+
+    /**
+     * Calculate the scratch memory (see scratch_arena) that mfcc needs at its peak:
+     * the MFE and energy matrices, plus the spectrum and signal of the current frame
+     * @param signal_length: Length of the signal.
+     * @param sampling_frequency (int): The sampling frequency of the signal.
+     * @param frame_length (float): The length of the frame in second.
+     * @param frame_stride (float): The stride between frames.
+     * @param num_filters (int): the number of filters in the filterbank
+     * @param fft_length (int): number of FFT points
+     */
+    static size_t calculate_mfcc_scratch_size(
+        size_t signal_length,
+        uint32_t sampling_frequency,
+        float frame_length, float frame_stride, uint16_t num_filters, uint16_t fft_length)
+    {
+        matrix_size_t mfe_matrix_size = calculate_mfe_buffer_size(
+            signal_length, sampling_frequency, frame_length, frame_stride, num_filters);
+        size_t frame_samples = static_cast<size_t>(round(static_cast<float>(sampling_frequency) * frame_length));
+
+        return scratch_arena::size_of(mfe_matrix_size.rows * mfe_matrix_size.cols * sizeof(float)) +
+            scratch_arena::size_of(mfe_matrix_size.rows * sizeof(float)) +
+            scratch_arena::size_of((fft_length / 2 + 1) * sizeof(float)) +
+            scratch_arena::size_of(frame_samples * sizeof(float));
+    }
+
+private:
+    typedef struct {
+        sparse_filterbank_t entries[EIDSP_FILTERBANK_CACHE_SIZE];
+        size_t next;
+    } sparse_filterbank_cache_t;
+
+    static sparse_filterbank_cache_t *filterbank_cache() {
+        static EIDSP_THREAD_LOCAL sparse_filterbank_cache_t cache = { };
+        return &cache;
+    }
+
+    /**
+     * Calculate the FFT bins of the edges of the Mel filters.
+     * @param freq_index Out, num_filter + 2 elements. Filter i spans
+     *                   freq_index[i] .. freq_index[i + 2] and peaks at freq_index[i + 1]
+     * @returns EIDSP_OK if OK
+     */
+    static int filterbank_edges(int *freq_index,
+        uint16_t num_filter, int coefficients, uint32_t sampling_freq,
+        uint32_t low_freq, uint32_t high_freq)
+    {
+        const size_t mels_mem_size = (num_filter + 2) * sizeof(float);
+        const size_t hertz_mem_size = (num_filter + 2) * sizeof(float);
+
+        float *mels = (float*)ei_dsp_malloc(mels_mem_size);
+        if (!mels) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        // Computing the Mel filterbank
+        // converting the upper and lower frequencies to Mels.
+        // num_filter + 2 is because for num_filter filterbanks we need
+        // num_filter+2 point.
+        numpy::linspace(
+            functions::frequency_to_mel(static_cast<float>(low_freq)),
+            functions::frequency_to_mel(static_cast<float>(high_freq)),
+            num_filter + 2,
+            mels);
+
+        // we should convert Mels back to Hertz because the start and end-points
+        // should be at the desired frequencies.
+        float *hertz = (float*)ei_dsp_malloc(hertz_mem_size);
+        if (!hertz) {
+            ei_dsp_free(mels, mels_mem_size);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        for (uint16_t ix = 0; ix < num_filter + 2; ix++) {
+            hertz[ix] = functions::mel_to_frequency(mels[ix]);
+            if (hertz[ix] < low_freq) {
+                hertz[ix] = low_freq;
+            }
+            if (hertz[ix] > high_freq) {
+                hertz[ix] = high_freq;
+            }
+
+            // here is a really annoying bug in Speechpy which calculates the frequency index wrong for the last bucket
+            // the last 'hertz' value is not 8,000 (with sampling rate 16,000) but 7,999.999999
+            // thus calculating the bucket to 64, not 65.
+            // we're adjusting this here a tiny bit to ensure we have the same result
+            if (ix == num_filter + 2 - 1) {
+                hertz[ix] -= 0.001;
+            }
+        }
+        ei_dsp_free(mels, mels_mem_size);
+
+        // The frequency resolution required to put filters at the
+        // exact points calculated above should be extracted.
+        //  So we should round those frequencies to the closest FFT bin.
+        for (uint16_t ix = 0; ix < num_filter + 2; ix++) {
+            freq_index[ix] = static_cast<int>(floor((coefficients + 1) * hertz[ix] / sampling_freq));
+        }
+        ei_dsp_free(hertz, hertz_mem_size);
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Calculate the weights of a single Mel filter
+     * @param z Out, right - left + 1 elements (weights for bins left .. right)
+     */
+    static void filterbank_triangle(float *z, int left, int middle, int right) {
+        numpy::linspace(left, right, (right - left + 1), z);
+        functions::triangle(z, (right - left + 1), left, middle, right);
+    }
+
+    /**
+     * Build a sparse Mel-filterbank, with the same weights as `filterbanks`
+     * (including the quantization if EIDSP_QUANTIZE_FILTERBANK is set).
+     */
+    static int build_sparse_filterbank(sparse_filterbank_t *filterbank,
+        uint16_t num_filter, int coefficients, uint32_t sampling_freq,
+        uint32_t low_freq, uint32_t high_freq)
+    {
+        // a filter never spans more than all bins
+        EI_DSP_MATRIX(z, 1, coefficients);
+
+        const size_t freq_index_mem_size = (num_filter + 2) * sizeof(int);
+        int *freq_index = (int*)ei_dsp_malloc(freq_index_mem_size);
+        if (!freq_index) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        int ret = filterbank_edges(freq_index, num_filter, coefficients, sampling_freq, low_freq, high_freq);
+        if (ret != EIDSP_OK) {
+            ei_dsp_free(freq_index, freq_index_mem_size);
+            EIDSP_ERR(ret);
+        }
+
+        // upper bound, the zero weights at the edges of every triangle are dropped below
+        size_t weights_size = 0;
+        for (uint16_t i = 0; i < num_filter; i++) {
+            int width = freq_index[i + 2] - freq_index[i] + 1;
+            if (width < 1 || freq_index[i] < 0 || freq_index[i + 2] >= coefficients) {
+                ei_dsp_free(freq_index, freq_index_mem_size);
+                EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+            }
+            weights_size += width;
+        }
+
+        filterbank->start = (uint16_t*)ei_dsp_calloc(num_filter, sizeof(uint16_t));
+        filterbank->length = (uint16_t*)ei_dsp_calloc(num_filter, sizeof(uint16_t));
+        filterbank->weights = (float*)ei_dsp_calloc(weights_size, sizeof(float));
+        filterbank->weights_size = weights_size;
+        filterbank->num_filters = num_filter;
+
+        if (!filterbank->start || !filterbank->length || !filterbank->weights) {
+            free_sparse_filterbank(filterbank);
+            ei_dsp_free(freq_index, freq_index_mem_size);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        size_t weights_ix = 0;
+        for (uint16_t i = 0; i < num_filter; i++) {
+            int left = freq_index[i];
+            int middle = freq_index[i + 1];
+            int right = freq_index[i + 2];
+            int width = right - left + 1;
+
+            filterbank_triangle(z.buffer, left, middle, right);
+
+#if EIDSP_QUANTIZE_FILTERBANK
+            for (int zx = 0; zx < width; zx++) {
+                z.buffer[zx] = numpy::dequantize_zero_one(numpy::quantize_zero_one(z.buffer[zx]));
+            }
+#endif
+
+            int first = 0;
+            while (first < width && z.buffer[first] == 0.0f) {
+                first++;
+            }
+            int last = width - 1;
+            while (last >= first && z.buffer[last] == 0.0f) {
+                last--;
+            }
+
+            filterbank->start[i] = static_cast<uint16_t>(left + first);
+            filterbank->length[i] = static_cast<uint16_t>(last - first + 1);
+            memcpy(filterbank->weights + weights_ix, z.buffer + first, filterbank->length[i] * sizeof(float));
+            weights_ix += filterbank->length[i];
+        }
+
+        ei_dsp_free(freq_index, freq_index_mem_size);
+
+        filterbank->coefficients = coefficients;
+        filterbank->sampling_freq = sampling_freq;
+        filterbank->low_freq = low_freq;
+        filterbank->high_freq = high_freq;
+
+        return EIDSP_OK;
+    }
+
+    static void free_sparse_filterbank(sparse_filterbank_t *filterbank) {
+        if (filterbank->start) {
+            ei_dsp_free(filterbank->start, filterbank->num_filters * sizeof(uint16_t));
+            filterbank->start = NULL;
+        }
+        if (filterbank->length) {
+            ei_dsp_free(filterbank->length, filterbank->num_filters * sizeof(uint16_t));
+            filterbank->length = NULL;
+        }
+        if (filterbank->weights) {
+            ei_dsp_free(filterbank->weights, filterbank->weights_size * sizeof(float));
+            filterbank->weights = NULL;
+        }
+    }
 };
 
 } // namespace speechpy
@@ -26,6 +26,9 @@
 #include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/config.hpp"
 #include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/feature.hpp"
 #include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/functions.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/mfcc_static.hpp"
 #include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/processing.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/stream.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/stream_fixed.hpp"
 
 #endif // _EIDSP_SPEECHPY_SPEECHPY_H_
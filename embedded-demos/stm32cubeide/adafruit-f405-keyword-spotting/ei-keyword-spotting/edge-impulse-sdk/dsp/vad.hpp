@@ -0,0 +1,175 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_VAD_H_
+#define _EIDSP_VAD_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/config.hpp"
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/numpy_types.h"
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/returntypes.hpp"
+
+namespace ei {
+
+/**
+ * Energy based voice activity detector for audio that comes in slices. The mean
+ * square of the int16 samples of a slice is compared against a noise floor that
+ * tracks the quiet slices: a slice is active if it's `threshold_db` louder than the
+ * noise floor and louder than an absolute minimum (so digital silence or a muted
+ * microphone never counts as activity).
+ *
+ * The noise floor drops to the energy of a quieter slice straight away, and rises
+ * towards a louder one by 1/16th of the difference per slice, so it follows
+ * background noise that gets louder within a few seconds while a keyword (well under
+ * a second) hardly moves it. The first slice after a reset sets the floor and is
+ * reported as active.
+ *
+ * Costs one multiply-accumulate per sample, and doesn't allocate.
+ */
+class energy_vad {
+public:
+    energy_vad() {
+        configure(6.0f, 32);
+        reset();
+    }
+
+    /**
+     * Set the detection threshold, keeps the noise floor
+     * @param threshold_db How much louder than the noise floor a slice has to be to be active
+     * @param min_rms RMS (in int16 units) a slice needs at least to be active
+     */
+    void configure(float threshold_db, int min_rms) {
+        _threshold_ratio = powf(10.0f, threshold_db / 10.0f);
+        _min_energy = static_cast<float>(min_rms) * static_cast<float>(min_rms);
+    }
+
+    /**
+     * Forget the noise floor and the samples of the current slice, f.e. when there
+     * was a gap in the audio
+     */
+    void reset() {
+        _noise_floor = -1.0f;
+        _sum_squares = 0;
+        _count = 0;
+    }
+
+    /**
+     * Add samples to the current slice
+     */
+    void process(const int16_t *samples, size_t count) {
+        uint64_t sum = 0;
+        for (size_t ix = 0; ix < count; ix++) {
+            int32_t s = samples[ix];
+            sum += static_cast<uint32_t>(s * s);
+        }
+        _sum_squares += sum;
+        _count += count;
+    }
+
+    /**
+     * Add all samples of a signal to the current slice, read as int16
+     * (through get_data_int16 if the signal has it)
+     * @returns 0 if OK
+     */
+    int process(signal_t *signal) {
+        int16_t buffer[64];
+        float float_buffer[64];
+
+        for (size_t offset = 0; offset < signal->total_length; offset += 64) {
+            size_t length = signal->total_length - offset;
+            if (length > 64) {
+                length = 64;
+            }
+
+            int ret;
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+            if (signal->get_data_int16) {
+                ret = signal->get_data_int16(offset, length, buffer);
+                if (ret != 0) {
+                    EIDSP_ERR(ret);
+                }
+                process(buffer, length);
+                continue;
+            }
+#endif
+            ret = signal->get_data(offset, length, float_buffer);
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+            for (size_t ix = 0; ix < length; ix++) {
+                float s = float_buffer[ix] * 32768.0f;
+                buffer[ix] = static_cast<int16_t>(s > 32767.0f ? 32767.0f : (s < -32768.0f ? -32768.0f : s));
+            }
+            process(buffer, length);
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Close the current slice: decide whether it was active and update the noise floor
+     * @returns true if the slice was active
+     */
+    bool end_slice() {
+        float energy = _count > 0 ? static_cast<float>(_sum_squares) / static_cast<float>(_count) : 0.0f;
+        _sum_squares = 0;
+        _count = 0;
+
+        if (_noise_floor < 0.0f) {
+            _noise_floor = energy;
+            return true;
+        }
+
+        float threshold = _noise_floor * _threshold_ratio;
+        bool active = energy > threshold && energy > _min_energy;
+
+        if (energy < _noise_floor) {
+            _noise_floor = energy;
+        }
+        else {
+            _noise_floor += (energy - _noise_floor) / 16.0f;
+        }
+
+        return active;
+    }
+
+    /**
+     * Current noise floor, as mean square in int16 units (-1 before the first slice)
+     */
+    float noise_floor() const {
+        return _noise_floor;
+    }
+
+private:
+    float _threshold_ratio;
+    float _min_energy;
+    float _noise_floor;
+    uint64_t _sum_squares;
+    size_t _count;
+};
+
+} // namespace ei
+
+#endif // _EIDSP_VAD_H_
@@ -63,6 +63,16 @@ uint64_t ei_read_timer_ms();
  */
 uint64_t ei_read_timer_us();
 
+/**
+ * Read the CPU cycle counter, 0 if the target does not have one
+ */
+uint64_t ei_read_timer_cycles();
+
+/**
+ * Rate of the CPU cycle counter in Hz, 0 if the target does not have one
+ */
+uint32_t ei_timer_cycles_per_second();
+
 /**
  * Print wrapper around printf()
  * This is used internally to print debug information.
@@ -0,0 +1,186 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EI_LOGGER_H_
+#define _EI_LOGGER_H_
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Asynchronous logger, so printing does not stall the inference loop.
+ *
+ * ei_logger_printf formats into a bounded line buffer, ei_logger_deferred only stores
+ * the format string and its arguments (formatted later). Both push the message into a
+ * lock-free single producer / single consumer ring buffer and return right away; when
+ * the ring buffer is full the message is dropped and counted, never waited for.
+ *
+ * ei_logger_drain is the consumer: it formats the messages into (two) chunks of up to
+ * EI_LOGGER_CHUNK_SIZE bytes and hands them to the backend, one at a time. Call it from
+ * the application thread when the CPU is idle, never from an interrupt: formatting uses
+ * vsnprintf, which is not reentrant.
+ *
+ * The backend calls ei_logger_write_done from its write complete callback (f.e. the UART
+ * TX complete interrupt). That only starts the write of a chunk that is formatted already.
+ *
+ * There should be one producer and one consumer, both in the application thread.
+ */
+
+#ifndef EI_LOGGER_BUFFER_SIZE
+#define EI_LOGGER_BUFFER_SIZE       2048    // ring buffer, power of two
+#endif
+
+#ifndef EI_LOGGER_LINE_SIZE
+#define EI_LOGGER_LINE_SIZE         200     // longest message, longer ones are truncated
+#endif
+
+#ifndef EI_LOGGER_CHUNK_SIZE
+#define EI_LOGGER_CHUNK_SIZE        256     // longest write to the backend
+#endif
+
+#ifndef EI_LOGGER_MAX_ARGS
+#define EI_LOGGER_MAX_ARGS          8       // arguments of a deferred message
+#endif
+
+typedef struct {
+    /**
+     * Start writing data to the output. The data stays valid until the backend calls
+     * ei_logger_write_done, a blocking backend does that before returning.
+     */
+    void (*write)(const char *data, size_t length);
+} ei_logger_backend_t;
+
+typedef struct {
+    uint32_t messages;          /* messages put into the ring buffer */
+    uint32_t dropped;           /* messages dropped because the ring buffer was full */
+    uint32_t bytes_written;     /* bytes formatted for the backend */
+} ei_logger_stats_t;
+
+typedef enum {
+    EI_LOGGER_ARG_LONG = 0,
+    EI_LOGGER_ARG_ULONG,
+    EI_LOGGER_ARG_LLONG,
+    EI_LOGGER_ARG_ULLONG,
+    EI_LOGGER_ARG_DOUBLE,
+    EI_LOGGER_ARG_STRING,
+    EI_LOGGER_ARG_POINTER
+} ei_logger_arg_type_t;
+
+/**
+ * Argument of a deferred message
+ */
+typedef struct {
+    uint8_t type;               /* ei_logger_arg_type_t */
+    union {
+        long l;
+        unsigned long ul;
+        long long ll;
+        unsigned long long ull;
+        double d;
+        const char *s;
+        const void *p;
+    } value;
+} ei_logger_arg_t;
+
+/**
+ * Set the backend, messages that were logged before are written on the next drain
+ */
+void ei_logger_init(const ei_logger_backend_t *backend);
+
+/**
+ * Format a message and put it into the ring buffer
+ * @returns false if the message was dropped
+ */
+bool ei_logger_vprintf(const char *format, va_list args);
+bool ei_logger_printf(const char *format, ...);
+
+/**
+ * Put a message into the ring buffer without formatting it, use ei_logger_deferred
+ * @param format Format string, has to stay valid until the message is drained (f.e. a literal)
+ * @param args Arguments, %s strings have to stay valid until the message is drained as well
+ * @param arg_count Number of arguments (up to EI_LOGGER_MAX_ARGS)
+ * @returns false if the message was dropped
+ */
+bool ei_logger_record(const char *format, const ei_logger_arg_t *args, size_t arg_count);
+
+/**
+ * Format the next chunks of messages and start writing them if the backend is not busy.
+ * Not safe to call from an interrupt.
+ */
+void ei_logger_drain(void);
+
+/**
+ * Called by the backend when the last write is done, starts writing the next chunk if it
+ * is formatted already. Safe to call from an interrupt.
+ */
+void ei_logger_write_done(void);
+
+/**
+ * Drain until all messages have been written (blocking)
+ */
+void ei_logger_flush(void);
+
+void ei_logger_get_stats(ei_logger_stats_t *stats);
+
+namespace ei {
+namespace logger {
+
+inline ei_logger_arg_t make_arg(ei_logger_arg_type_t type) {
+    ei_logger_arg_t arg;
+    arg.type = type;
+    arg.value.ull = 0;
+    return arg;
+}
+
+inline ei_logger_arg_t arg(int v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_LONG); a.value.l = v; return a; }
+inline ei_logger_arg_t arg(long v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_LONG); a.value.l = v; return a; }
+inline ei_logger_arg_t arg(unsigned int v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_ULONG); a.value.ul = v; return a; }
+inline ei_logger_arg_t arg(unsigned long v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_ULONG); a.value.ul = v; return a; }
+inline ei_logger_arg_t arg(long long v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_LLONG); a.value.ll = v; return a; }
+inline ei_logger_arg_t arg(unsigned long long v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_ULLONG); a.value.ull = v; return a; }
+inline ei_logger_arg_t arg(double v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_DOUBLE); a.value.d = v; return a; }
+inline ei_logger_arg_t arg(const char *v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_STRING); a.value.s = v; return a; }
+inline ei_logger_arg_t arg(const void *v) { ei_logger_arg_t a = make_arg(EI_LOGGER_ARG_POINTER); a.value.p = v; return a; }
+
+} // namespace logger
+} // namespace ei
+
+/**
+ * Log a message that is formatted when it's drained rather than now, which keeps
+ * vsnprintf (and its float formatting) out of the hot path.
+ * Supports the integer, floating point, %s and %p conversions, without '*' widths.
+ * f.e. ei_logger_deferred("%s: %.5f\r\n", result.classification[ix].label, result.classification[ix].value);
+ * @returns false if the message was dropped
+ */
+inline bool ei_logger_deferred(const char *format) {
+    return ei_logger_record(format, NULL, 0);
+}
+
+template <typename... Args>
+bool ei_logger_deferred(const char *format, Args... args) {
+    static_assert(sizeof...(Args) <= EI_LOGGER_MAX_ARGS, "Too many arguments, see EI_LOGGER_MAX_ARGS");
+    const ei_logger_arg_t packed[] = { ei::logger::arg(args)... };
+    return ei_logger_record(format, packed, sizeof...(Args));
+}
+
+#endif // _EI_LOGGER_H_
@@ -131,4 +131,18 @@ ei_dsp_config_mfcc_t ei_dsp_config_28 = {
     1
 };
 
+// DSP block 28 as compile time constants (frame length and stride in samples), extract_mfcc_features
+// runs the MFCC specialized for them (speechpy::mfcc_static). Set to 0 to use the generic MFCC.
+#ifndef EI_CLASSIFIER_MFCC_STATIC
+#define EI_CLASSIFIER_MFCC_STATIC                1
+#endif // EI_CLASSIFIER_MFCC_STATIC
+#define EI_CLASSIFIER_MFCC_FRAME_LENGTH          320
+#define EI_CLASSIFIER_MFCC_FRAME_STRIDE          320
+#define EI_CLASSIFIER_MFCC_NUM_CEPSTRAL          13
+#define EI_CLASSIFIER_MFCC_NUM_FILTERS           32
+#define EI_CLASSIFIER_MFCC_FFT_LENGTH            256
+#define EI_CLASSIFIER_MFCC_LOW_FREQUENCY         300
+#define EI_CLASSIFIER_MFCC_HIGH_FREQUENCY        4000
+#define EI_CLASSIFIER_MFCC_PRE_SHIFT             1
+
 #endif // _EI_CLASSIFIER_MODEL_METADATA_H_
@@ -26,6 +26,8 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include "classifier/ei_run_classifier.h"
+#include "edge-impulse-sdk/dsp/decimator.hpp"
+#include "edge-impulse-sdk/porting/ei_logger.h"
 
 /* USER CODE END Includes */
 
@@ -47,6 +49,8 @@ typedef struct {
 /* USER CODE BEGIN PD */
 #define I2S_BUF_LEN 400  // 4x desired size to downsample and throw out 1 ch
 #define I2S_BUF_SKIP 4    // (2x L/R ch) * (2x sample rate)
+#define I2S_CHANNELS 2    // L/R ch, interleaved
+#define AUDIO_BLOCK_SIZE (I2S_BUF_LEN / I2S_BUF_SKIP / 2) // 16 kHz samples per DMA half-buffer
 /* USER CODE END PD */
 
 /* Private macro -------------------------------------------------------------*/
@@ -70,6 +74,7 @@ static bool debug_nn = false; // Set this to true to see e.g. features generated
 // Globals
 uint32_t i2s_buf[I2S_BUF_LEN];
 static inference_t inference;
+static ei::halfband_decimator decimator; // 32 kHz to 16 kHz, with anti-alias filter
 static bool record_ready = false;
 
 /* USER CODE END PV */
@@ -84,17 +89,20 @@ static void MX_SAI1_Init(void);
 /* USER CODE BEGIN PFP */
 
 static int get_audio_signal_data(size_t offset, size_t length, float *out_ptr);
-static void audio_buffer_inference_callback(uint32_t n_bytes, uint32_t offset);
+static void audio_buffer_inference_callback(uint32_t n_frames, uint32_t offset);
 bool ei_microphone_inference_record(void);
 bool ei_microphone_inference_end(void);
 void ei_printf(const char *format, ...);
-void vprint(const char *fmt, va_list argp);
+static void uart_logger_write(const char *data, size_t length);
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
+/** Log output, written by interrupt so printing does not block the inference loop */
+static const ei_logger_backend_t uart_logger = { &uart_logger_write };
+
 /* USER CODE END 0 */
 
 /**
@@ -134,6 +142,8 @@ int main(void)
   MX_SAI1_Init();
   /* USER CODE BEGIN 2 */
 
+  ei_logger_init(&uart_logger);
+
   // Say some stuff
   ei_printf("Inferencing settings:\r\n");
   ei_printf("\tInterval: %.2f ms.\r\n", (float)EI_CLASSIFIER_INTERVAL_MS);
@@ -203,11 +213,12 @@ int main(void)
       print_results = 0;
 
       // Comment this section out if you don't want to see the raw scores
-      ei_printf("Predictions (DSP: %d ms, NN: %d ms)\r\n", result.timing.dsp, result.timing.classification);
+      // (deferred: formatted while waiting for the next slice, not here)
+      ei_logger_deferred("Predictions (DSP: %d ms, NN: %d ms)\r\n", result.timing.dsp, result.timing.classification);
       for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++)
       {
         int val = (int)((result.classification[ix].value * 100) + 0.5);
-        ei_printf("    %s: %i%%\r\n", result.classification[ix].label, val);
+        ei_logger_deferred("    %s: %i%%\r\n", result.classification[ix].label, val);
       }
 
       // Example use case
@@ -225,7 +236,7 @@ int main(void)
       }
 
       // Print label with highest probability
-      ei_printf("%s\r\n", result.classification[max_ix].label);
+      ei_logger_deferred("%s\r\n", result.classification[max_ix].label);
 
       // Flash led if keyword is higher than 0.5 threshold
       if (result.classification[2].value > 0.5)
@@ -244,6 +255,7 @@ int main(void)
   }
 
   ei_microphone_inference_end();
+  ei_logger_flush();
 
   /* USER CODE END 3 */
 }
@@ -480,7 +492,8 @@ bool ei_microphone_inference_record(void)
   // %%%TODO: make this non-blocking
   while (inference.buf_ready == 0)
   {
-    continue;
+    // Write out the log while waiting
+    ei_logger_drain();
   }
 
   inference.buf_ready = 0;
@@ -507,24 +520,24 @@ bool ei_microphone_inference_end(void)
 }
 
 /**
- * @brief      Copy sample data in selected buf and signal ready when buffer is full
+ * @brief      Filter and decimate a DMA half-buffer into the selected buf and signal
+ *             ready when buffer is full
  *
- * @param[in]  n_bytes  Number of bytes to copy
- * @param[in]  offset   offset in sampleBuffer
+ * @param[in]  n_frames  Number of stereo frames (at 32 kHz) to read
+ * @param[in]  offset    offset in sampleBuffer
  */
-static void audio_buffer_inference_callback(uint32_t n_bytes, uint32_t offset)
+static void audio_buffer_inference_callback(uint32_t n_frames, uint32_t offset)
 {
-  // Copy samples from I2S buffer to inference buffer. Convert 24-bit, 32kHz
-  // samples to 16-bit, 16kHz
-  for (uint32_t i = 0; i < (n_bytes >> 1); i++) {
-    inference.buffers[inference.buf_select][inference.buf_count++] =
-        (int16_t)(i2s_buf[offset + (I2S_BUF_SKIP * i)] >> 8);
-
-    if (inference.buf_count >= inference.n_samples) {
-      inference.buf_select ^= 1;
-      inference.buf_count = 0;
-      inference.buf_ready = 1;
-    }
+  static_assert(EI_CLASSIFIER_SLICE_SIZE % AUDIO_BLOCK_SIZE == 0, "A slice should be a whole number of DMA half-buffers");
+
+  // Convert the left channel from 24-bit, 32kHz samples to 16-bit, 16kHz
+  inference.buf_count += decimator.process(&i2s_buf[offset], n_frames, I2S_CHANNELS, 8,
+                                           &inference.buffers[inference.buf_select][inference.buf_count]);
+
+  if (inference.buf_count >= inference.n_samples) {
+    inference.buf_select ^= 1;
+    inference.buf_count = 0;
+    inference.buf_ready = 1;
   }
 }
 
@@ -539,28 +552,41 @@ static int get_audio_signal_data(size_t offset, size_t length, float *out_ptr)
 }
 
 /**
- * Low-level print function that uses UART to print status messages.
+ * Start writing a chunk of the log to the UART, ei_logger_write_done is called
+ * from the transmit complete interrupt.
  */
-void vprint(const char *fmt, va_list argp)
+static void uart_logger_write(const char *data, size_t length)
 {
-  char string[200];
-  if(0 < vsprintf(string, fmt, argp)) // build string
+  if (HAL_UART_Transmit_IT(&huart2, (uint8_t *)data, length) != HAL_OK)
   {
-      HAL_UART_Transmit(&huart2, (uint8_t*)string, strlen(string), 0xffffff);
+    ei_logger_write_done();
   }
 }
 
 /**
- * Wrapper for vprint. Use this like you would printf to print messages to the serial console.
+ * Use this like you would printf to print messages to the serial console. The message is
+ * formatted right away and written out in the background, see ei_logger.h.
  */
 void ei_printf(const char *format, ...)
 {
   va_list myargs;
   va_start(myargs, format);
-  vprint(format, myargs);
+  ei_logger_vprintf(format, myargs);
   va_end(myargs);
 }
 
+/**
+ * Called when a chunk of the log has been sent, start the next one if it's formatted
+ * already. Formatting happens in ei_logger_drain, outside of the interrupt.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart == &huart2)
+  {
+    ei_logger_write_done();
+  }
+}
+
 /**
  * Called when the first half of the receive buffer is full
  */
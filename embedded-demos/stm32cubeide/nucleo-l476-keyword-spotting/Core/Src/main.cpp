@@ -26,19 +26,19 @@
 #include <stdarg.h>
 
 #include "../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_run_classifier.h"
+#include "../../ei-keyword-spotting/edge-impulse-sdk/dsp/decimator.hpp"
+#include "../../ei-keyword-spotting/edge-impulse-sdk/porting/ei_logger.h"
 
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
 /* USER CODE BEGIN PTD */
 
-/** Audio buffers, pointers and selectors */
+/** Audio blocks (one per DMA half-buffer), used as a ring buffer */
 typedef struct {
-    int16_t *buffers[2];
-    uint8_t buf_select;
-    volatile uint8_t buf_ready;
-    uint32_t buf_count;
-    uint32_t n_samples;
+    int16_t *buffer;
+    volatile uint32_t blocks_written;   // Only changed by the DMA callbacks
+    uint32_t blocks_read;               // Only changed by the inference loop
 } inference_t;
 
 /* USER CODE END PTD */
@@ -48,6 +48,9 @@ typedef struct {
 
 #define I2S_BUF_LEN 6400  // 4x desired size to downsample and throw out 1 ch
 #define I2S_BUF_SKIP 4    // (2x L/R ch) * (2x sample rate)
+#define I2S_CHANNELS 2    // L/R ch, interleaved
+#define AUDIO_BLOCK_SIZE (I2S_BUF_LEN / I2S_BUF_SKIP / 2) // 16 kHz samples per DMA half-buffer
+#define AUDIO_BLOCK_COUNT ((EI_CLASSIFIER_SLICE_SIZE + AUDIO_BLOCK_SIZE - 1) / AUDIO_BLOCK_SIZE) // a slice, the NN has most of it to run
 
 /* USER CODE END PD */
 
@@ -72,6 +75,7 @@ static bool debug_nn = false; // Set this to true to see e.g. features generated
 // Globals
 uint32_t i2s_buf[I2S_BUF_LEN];
 static inference_t inference;
+static ei::halfband_decimator decimator; // 32 kHz to 16 kHz, with anti-alias filter
 static bool record_ready = false;
 
 /* USER CODE END PV */
@@ -85,18 +89,20 @@ static void MX_CRC_Init(void);
 static void MX_SAI1_Init(void);
 /* USER CODE BEGIN PFP */
 
-static int get_audio_signal_data(size_t offset, size_t length, float *out_ptr);
-static void audio_buffer_inference_callback(uint32_t n_bytes, uint32_t offset);
+static void audio_buffer_inference_callback(uint32_t n_frames, uint32_t offset);
 bool ei_microphone_inference_record(void);
 bool ei_microphone_inference_end(void);
 void ei_printf(const char *format, ...);
-void vprint(const char *fmt, va_list argp);
+static void uart_logger_write(const char *data, size_t length);
 
 /* USER CODE END PFP */
 
 /* Private user code ---------------------------------------------------------*/
 /* USER CODE BEGIN 0 */
 
+/** Log output, written by interrupt so printing does not block the inference loop */
+static const ei_logger_backend_t uart_logger = { &uart_logger_write };
+
 /* USER CODE END 0 */
 
 /**
@@ -136,6 +142,8 @@ int main(void)
   MX_SAI1_Init();
   /* USER CODE BEGIN 2 */
 
+  ei_logger_init(&uart_logger);
+
   // Say some stuff
   ei_printf("Inferencing settings:\r\n");
   ei_printf("\tInterval: %.2f ms.\r\n", (float)EI_CLASSIFIER_INTERVAL_MS);
@@ -143,23 +151,17 @@ int main(void)
   ei_printf("\tSample length: %d ms.\r\n", EI_CLASSIFIER_RAW_SAMPLE_COUNT / 16);
   ei_printf("\tNo. of classes: %d\r\n", sizeof(ei_classifier_inferencing_categories) / sizeof(ei_classifier_inferencing_categories[0]));
 
-  // Create double buffer
-  inference.buffers[0] = (int16_t *)malloc(EI_CLASSIFIER_SLICE_SIZE * sizeof(int16_t));
-  if(inference.buffers[0] == NULL)
-  {
-    ei_printf("ERROR: Could not create buffer 1. Likely ran out of heap memory.\r\n");
-  }
-  inference.buffers[1] = (int16_t *)malloc(EI_CLASSIFIER_SLICE_SIZE * sizeof(int16_t));
-  if(inference.buffers[1] == NULL)
+  // Create block buffer
+  inference.buffer = (int16_t *)malloc(AUDIO_BLOCK_COUNT * AUDIO_BLOCK_SIZE * sizeof(int16_t));
+  if(inference.buffer == NULL)
   {
-    ei_printf("ERROR: Could not create buffer 2. Likely ran out of heap memory.\r\n");
+    ei_printf("ERROR: Could not create audio buffer. Likely ran out of heap memory.\r\n");
   }
 
   // Set inference parameters
-  inference.buf_select = 0;
-  inference.buf_count  = 0;
-  inference.n_samples  = EI_CLASSIFIER_SLICE_SIZE;
-  inference.buf_ready  = 0;
+  inference.blocks_written = 0;
+  inference.blocks_read    = 0;
+  run_classifier_init();
 
   // Start receiving I2S audio data
   hal_res =  HAL_SAI_Receive_DMA(&hsai_BlockB1, (uint8_t *)i2s_buf, I2S_BUF_LEN);
@@ -178,7 +180,7 @@ int main(void)
   while (1)
   {
 
-    // Wait until buffer is full
+    // Wait for the next DMA half-buffer
     bool m = ei_microphone_inference_record();
     if (!m)
     {
@@ -186,26 +188,33 @@ int main(void)
       break;
     }
 
-    // Do classification (i.e. the inference part)
-    signal_t signal;
-    signal.total_length = EI_CLASSIFIER_SLICE_SIZE;
-    signal.get_data = &get_audio_signal_data;
+    // Run the DSP over the new block, the model only runs when a slice completes
+    int16_t *block = &inference.buffer[(inference.blocks_read % AUDIO_BLOCK_COUNT) * AUDIO_BLOCK_SIZE];
     ei_impulse_result_t result = { 0 };
-    EI_IMPULSE_ERROR r = run_classifier_continuous(&signal, &result, debug_nn);
+    bool result_ready = false;
+    EI_IMPULSE_ERROR r = run_classifier_push_samples(block, AUDIO_BLOCK_SIZE, &result, &result_ready, debug_nn);
+    inference.blocks_read++;
     if (r != EI_IMPULSE_OK)
     {
         ei_printf("ERROR: Failed to run classifier (%d)\r\n", r);
         break;
     }
 
+    // Nothing to do until a slice completes
+    if (!result_ready)
+    {
+      continue;
+    }
+
     // Print output predictions (once every 4 predictions)
     if(++print_results >= (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1))
     {
       // Comment this section out if you don't want to see the raw scores
-      ei_printf("Predictions (DSP: %d ms, NN: %d ms)\r\n", result.timing.dsp, result.timing.classification);
+      // (deferred: formatted while waiting for the next block, not here)
+      ei_logger_deferred("Predictions (DSP: %d us, NN: %d us)\r\n", (int)result.timing.dsp_us, (int)result.timing.classification_us);
       for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++)
       {
-          ei_printf("    %s: %.5f\r\n", result.classification[ix].label, result.classification[ix].value);
+          ei_logger_deferred("    %s: %.5f\r\n", result.classification[ix].label, result.classification[ix].value);
       }
       print_results = 0;
     }
@@ -239,6 +248,7 @@ int main(void)
   }
 
   ei_microphone_inference_end();
+  ei_logger_flush();
   /* USER CODE END 3 */
 }
 
@@ -464,19 +474,19 @@ bool ei_microphone_inference_record(void)
 {
   bool ret = true;
 
-  // Check to see if the buffer has overrun
-  if (inference.buf_ready == 1) {
+  // Check to see if the buffer has overrun (the DMA callbacks are about to
+  // overwrite blocks that were not pushed yet)
+  if (inference.blocks_written - inference.blocks_read >= AUDIO_BLOCK_COUNT) {
       ret = false;
   }
 
   // %%%TODO: make this non-blocking
-  while (inference.buf_ready == 0)
+  while (inference.blocks_written == inference.blocks_read)
   {
-    continue;
+    // Write out the log while waiting
+    ei_logger_drain();
   }
 
-  inference.buf_ready = 0;
-
   return ret;
 }
 
@@ -490,69 +500,65 @@ bool ei_microphone_inference_end(void)
   // Stop I2S
   HAL_SAI_DMAStop(&hsai_BlockB1);
 
-  // Free up double buffer
+  // Free up block buffer
   record_ready = false;
-  free(inference.buffers[0]);
-  free(inference.buffers[1]);
+  free(inference.buffer);
 
   return true;
 }
 
 /**
- * @brief      Copy sample data in selected buf and signal ready when buffer is full
+ * @brief      Filter and decimate a DMA half-buffer into the next block and signal it is ready
  *
- * @param[in]  n_bytes  Number of bytes to copy
- * @param[in]  offset   offset in sampleBuffer
+ * @param[in]  n_frames  Number of stereo frames (at 32 kHz) to read
+ * @param[in]  offset    offset in sampleBuffer
  */
-static void audio_buffer_inference_callback(uint32_t n_bytes, uint32_t offset)
+static void audio_buffer_inference_callback(uint32_t n_frames, uint32_t offset)
 {
-  // Copy samples from I2S buffer to inference buffer. Convert 24-bit, 32kHz
-  // samples to 16-bit, 16kHz
-  for (uint32_t i = 0; i < (n_bytes >> 1); i++) {
-    inference.buffers[inference.buf_select][inference.buf_count++] =
-        (int16_t)(i2s_buf[offset + (I2S_BUF_SKIP * i)] >> 8);
-
-    if (inference.buf_count >= inference.n_samples) {
-      inference.buf_select ^= 1;
-      inference.buf_count = 0;
-      inference.buf_ready = 1;
-    }
-  }
-}
+  int16_t *block = &inference.buffer[(inference.blocks_written % AUDIO_BLOCK_COUNT) * AUDIO_BLOCK_SIZE];
 
-/**
- * Get raw audio signal data
- */
-static int get_audio_signal_data(size_t offset, size_t length, float *out_ptr)
-{
-  numpy::int16_to_float(&inference.buffers[inference.buf_select ^ 1][offset], out_ptr, length);
+  // Convert the left channel from 24-bit, 32kHz samples to 16-bit, 16kHz
+  decimator.process(&i2s_buf[offset], n_frames, I2S_CHANNELS, 8, block);
 
-  return 0;
+  inference.blocks_written++;
 }
 
 /**
- * Low-level print function that uses UART to print status messages.
+ * Start writing a chunk of the log to the UART, ei_logger_write_done is called
+ * from the transmit complete interrupt.
  */
-void vprint(const char *fmt, va_list argp)
+static void uart_logger_write(const char *data, size_t length)
 {
-  char string[200];
-  if(0 < vsprintf(string, fmt, argp)) // build string
+  if (HAL_UART_Transmit_IT(&huart2, (uint8_t *)data, length) != HAL_OK)
   {
-      HAL_UART_Transmit(&huart2, (uint8_t*)string, strlen(string), 0xffffff);
+    ei_logger_write_done();
   }
 }
 
 /**
- * Wrapper for vprint. Use this like you would printf to print messages to the serial console.
+ * Use this like you would printf to print messages to the serial console. The message is
+ * formatted right away and written out in the background, see ei_logger.h.
  */
 void ei_printf(const char *format, ...)
 {
   va_list myargs;
   va_start(myargs, format);
-  vprint(format, myargs);
+  ei_logger_vprintf(format, myargs);
   va_end(myargs);
 }
 
+/**
+ * Called when a chunk of the log has been sent, start the next one if it's formatted
+ * already. Formatting happens in ei_logger_drain, outside of the interrupt.
+ */
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+{
+  if (huart == &huart2)
+  {
+    ei_logger_write_done();
+  }
+}
+
 /**
  * Called when the first half of the receive buffer is full
  */
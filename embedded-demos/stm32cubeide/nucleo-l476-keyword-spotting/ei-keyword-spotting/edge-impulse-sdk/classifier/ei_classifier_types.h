@@ -26,6 +26,10 @@
 #include <stdint.h>
 
 #include "../../../ei-keyword-spotting/model-parameters/model_metadata.h"
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_classifier_config.h"
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_profiler.h"
+#endif
 
 typedef struct {
     const char *label;
@@ -33,16 +37,30 @@ typedef struct {
 } ei_impulse_result_classification_t;
 
 typedef struct {
-    int sampling;
+    int sampling;                   // ms
     int dsp;
     int classification;
     int anomaly;
+    int64_t sampling_us;
+    int64_t dsp_us;
+    int64_t classification_us;
+    int64_t anomaly_us;
+    uint64_t sampling_cycles;       // CPU cycles, 0 if the target has no cycle counter
+    uint64_t dsp_cycles;
+    uint64_t classification_cycles;
+    uint64_t anomaly_cycles;
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    ei_profiler_op_summary_t ops[EI_CLASSIFIER_PROFILER_MAX_OPS];  // time per operator in the model
+    uint32_t ticks_per_second;                                     // rate of the profiler clock
+#endif
 } ei_impulse_result_timing_t;
 
 typedef struct {
     ei_impulse_result_classification_t classification[EI_CLASSIFIER_LABEL_COUNT];
     float anomaly;
     ei_impulse_result_timing_t timing;
+    bool skipped;                   // the window had no voice activity (EI_CLASSIFIER_VAD_GATE), the model
+                                    // didn't run and every classification value is 0
 } ei_impulse_result_t;
 
 typedef struct {
@@ -0,0 +1,148 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_profiler.h"
+
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+
+#include <string.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define EI_PROFILER_CLOCK_MONOTONIC 1
+#include <time.h>
+#endif
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+#if (EI_CLASSIFIER_PROFILER_EVENTS & (EI_CLASSIFIER_PROFILER_EVENTS - 1)) != 0
+#error "EI_CLASSIFIER_PROFILER_EVENTS should be a power of two"
+#endif
+
+#if EI_PROFILER_CLOCK_MONOTONIC
+static uint32_t default_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec);
+}
+
+static uint32_t default_ticks_per_second(void) {
+    return 1000000000u;
+}
+#else
+// the cycle counter of the porting layer, or its microsecond timer if there is none
+static uint32_t default_clock(void) {
+    if (ei_timer_cycles_per_second() != 0) {
+        return (uint32_t)ei_read_timer_cycles();
+    }
+    return (uint32_t)ei_read_timer_us();
+}
+
+static uint32_t default_ticks_per_second(void) {
+    uint32_t cycles_per_second = ei_timer_cycles_per_second();
+    return cycles_per_second != 0 ? cycles_per_second : 1000000u;
+}
+#endif
+
+static ei_profiler_clock_t profiler_clock = NULL;
+static uint32_t profiler_ticks_per_second = 0;
+
+// per thread with EI_CLASSIFIER_THREAD_SAFE, like the model that records into it
+static EI_CLASSIFIER_THREAD_LOCAL ei_profiler_event_t events[EI_CLASSIFIER_PROFILER_EVENTS];
+static EI_CLASSIFIER_THREAD_LOCAL uint32_t next_sequence = 0;
+
+void ei_profiler_set_clock(ei_profiler_clock_t clock, uint32_t ticks_per_second) {
+    profiler_clock = clock;
+    profiler_ticks_per_second = clock ? ticks_per_second : 0;
+}
+
+uint32_t ei_profiler_read_clock(void) {
+    return profiler_clock ? profiler_clock() : default_clock();
+}
+
+uint32_t ei_profiler_ticks_per_second(void) {
+    return profiler_clock ? profiler_ticks_per_second : default_ticks_per_second();
+}
+
+void ei_profiler_record(uint16_t node, const char *op, uint32_t start, uint32_t end, uint32_t scratch_bytes) {
+    ei_profiler_event_t *event = &events[next_sequence & (EI_CLASSIFIER_PROFILER_EVENTS - 1)];
+    event->sequence = next_sequence++;
+    event->node = node;
+    event->op = op;
+    event->start = start;
+    event->end = end;
+    event->scratch_bytes = scratch_bytes;
+}
+
+uint32_t ei_profiler_sequence(void) {
+    return next_sequence;
+}
+
+/**
+ * Oldest event from a sequence number onwards that is still in the ring buffer
+ */
+static uint32_t first_available(uint32_t from_sequence) {
+    uint32_t available = next_sequence - from_sequence;
+    if (available > EI_CLASSIFIER_PROFILER_EVENTS) {
+        return next_sequence - EI_CLASSIFIER_PROFILER_EVENTS;
+    }
+    return from_sequence;
+}
+
+size_t ei_profiler_read(uint32_t from_sequence, ei_profiler_event_t *out_events, size_t max_events) {
+    size_t count = 0;
+    for (uint32_t s = first_available(from_sequence); s != next_sequence && count < max_events; s++) {
+        out_events[count++] = events[s & (EI_CLASSIFIER_PROFILER_EVENTS - 1)];
+    }
+    return count;
+}
+
+size_t ei_profiler_summarize(uint32_t from_sequence, ei_profiler_op_summary_t *ops, size_t max_ops) {
+    memset(ops, 0, max_ops * sizeof(ei_profiler_op_summary_t));
+
+    size_t count = 0;
+    for (uint32_t s = first_available(from_sequence); s != next_sequence; s++) {
+        const ei_profiler_event_t *event = &events[s & (EI_CLASSIFIER_PROFILER_EVENTS - 1)];
+
+        // operator names are string literals of the compiled model, compare the pointers
+        size_t ix = 0;
+        while (ix < count && ops[ix].op != event->op) {
+            ix++;
+        }
+        if (ix == count) {
+            if (count == max_ops) {
+                continue;
+            }
+            ops[count++].op = event->op;
+        }
+
+        ops[ix].nodes++;
+        ops[ix].ticks += event->end - event->start;
+        ops[ix].scratch_bytes += event->scratch_bytes;
+    }
+    return count;
+}
+
+void ei_profiler_clear(void) {
+    next_sequence = 0;
+}
+
+#endif // EI_CLASSIFIER_PROFILE_NODES == 1
@@ -29,11 +29,15 @@
 #endif
 #include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_run_dsp.h"
 #include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_classifier_types.h"
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/classifier/ei_classifier_config.h"
 #if defined(EI_CLASSIFIER_HAS_SAMPLER) && EI_CLASSIFIER_HAS_SAMPLER == 1
 #include "ei_sampler.h"
 #endif
 #include "../../../ei-keyword-spotting/edge-impulse-sdk/porting/ei_classifier_porting.h"
 #include "../../../ei-keyword-spotting/model-parameters/dsp_blocks.h"
+#if EI_CLASSIFIER_VAD_GATE == 1
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/vad.hpp"
+#endif
 
 #if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_UTENSOR
 #include "utensor-model/trained.hpp"
@@ -91,7 +95,8 @@ static ai_handle network = AI_HANDLE_NULL;
 #include "tflite-model/trained_model_compiled.h"
 #include "edge-impulse-sdk/classifier/ei_aligned_malloc.h"
 
-
+/* trained_model_init succeeded, arena and kernel state are resident (on this thread with EI_CLASSIFIER_THREAD_SAFE) */
+static EI_CLASSIFIER_THREAD_LOCAL bool compiled_model_ready = false;
 
 #elif EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_NONE
 // noop
@@ -99,6 +104,22 @@ static ai_handle network = AI_HANDLE_NULL;
 #error "Unknown inferencing engine"
 #endif
 
+#if EIDSP_USE_FIXED_POINT
+#if EI_CLASSIFIER_INFERENCING_ENGINE != EI_CLASSIFIER_TFLITE || EI_CLASSIFIER_TFLITE_INPUT_DATATYPE != EI_CLASSIFIER_DATATYPE_INT8
+#error "EIDSP_USE_FIXED_POINT requires a TensorFlow Lite model with int8 input"
+#endif
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+#error "EIDSP_USE_FIXED_POINT does not support anomaly detection (no float features)"
+#endif
+#endif // EIDSP_USE_FIXED_POINT
+
+#if EI_CLASSIFIER_THREAD_SAFE != EIDSP_THREAD_SAFE
+#error "EI_CLASSIFIER_THREAD_SAFE and EIDSP_THREAD_SAFE should be set together"
+#endif
+#if EI_CLASSIFIER_THREAD_SAFE == 1 && !((EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1))
+#error "EI_CLASSIFIER_THREAD_SAFE requires a compiled TensorFlow Lite model (EON)"
+#endif
+
 #if ECM3532
 void*   __dso_handle = (void*) &__dso_handle;
 #endif
@@ -107,21 +128,146 @@ void*   __dso_handle = (void*) &__dso_handle;
 namespace {
 #endif // __cplusplus
 
-/* Function prototypes ----------------------------------------------------- */
-extern "C" EI_IMPULSE_ERROR run_inference(ei::matrix_t *fmatrix, ei_impulse_result_t *result, bool debug);
-static void calc_cepstral_mean_and_var_normalization(ei_matrix *matrix, void *config_ptr);
+/* Private types ----------------------------------------------------------- */
 
-/* Private variables ------------------------------------------------------- */
+/**
+ * Fills the model input in place, called by run_inference once the input is allocated.
+ * Exactly one of int8_input and float_input is set, depending on the input type of the model.
+ * Returns EIDSP_OK if OK.
+ */
+typedef struct {
+    int (*fn)(void *ctx, int8_t *int8_input, float *float_input, size_t input_size,
+              float scale, int32_t zero_point);
+    void *ctx;
+} ei_input_writer_t;
+
+/**
+ * A point in time, or a duration, for ei_impulse_result_timing_t
+ */
+typedef struct {
+    uint64_t us;
+    uint64_t cycles;    /* 0 if the target has no cycle counter */
+} ei_timestamp_t;
+
+/**
+ * One continuous audio stream: the feature window, the audio that did not complete a
+ * frame yet and the moving average filter. The model and the DSP tables are shared by
+ * all streams, so a stream is only its state (a few kB, no heap but the MFCC frame buffer).
+ * Set up with run_classifier_stream_init, then feed it through run_classifier_stream_continuous
+ * or run_classifier_stream_push_samples. Streams are independent, so any number of them
+ * can be classified in turns; with EI_CLASSIFIER_THREAD_SAFE different threads can
+ * classify different streams at the same time. A stream must not be used by two threads at once.
+ * A stream cannot be copied (its MFCC owns heap buffers), keep it in place and pass it by pointer;
+ * f.e. hold many of them in a std::vector sized up front, or in a std::deque / an array.
+ */
+typedef struct {
+    size_t slice_offset;                /* Number of frames written to the feature window */
+    size_t feature_window_head;         /* Oldest frame in the feature window */
+    bool feature_buffer_full;
+#if EIDSP_USE_FIXED_POINT
+    /* Feature window in fixed point, a circular buffer of frames (oldest frame at feature_window_head) */
+    int32_t features[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+    speechpy::mfcc_stream_fixed mfcc;
+#else
+    /* Feature window, a circular buffer of frames (oldest frame at feature_window_head) */
+    float features[EI_CLASSIFIER_NN_INPUT_FRAME_SIZE];
+    speechpy::mfcc_stream mfcc;
+#endif
 #if EI_CLASSIFIER_LABEL_COUNT > 0
-ei_impulse_maf classifier_maf[EI_CLASSIFIER_LABEL_COUNT] = {0};
+    ei_impulse_maf maf[EI_CLASSIFIER_LABEL_COUNT];
 #else
-ei_impulse_maf classifier_maf[0];
+    ei_impulse_maf maf[0];
+#endif
+    size_t pushed_slice_samples;        /* Samples pushed since the last slice boundary */
+    ei_timestamp_t pushed_slice_dsp;    /* DSP time spent on the pushed samples of this slice */
+#if EI_CLASSIFIER_VAD_GATE == 1
+    ei::energy_vad vad;                 /* Voice activity of the slice that is coming in */
+    size_t active_slices_left;          /* Number of slices the last active slice stays in the window */
 #endif
-static size_t slice_offset = 0;
-static bool feature_buffer_full = false;
+} ei_classifier_stream_t;
+
+/**
+ * The continuous feature window, normalized into the model input by write_feature_window
+ */
+typedef struct {
+#if EIDSP_USE_FIXED_POINT
+    int32_t *features;
+#else
+    ei::matrix_t *features;
+#endif
+    size_t first_frame;
+    ei_dsp_config_mfcc_t *config;
+} ei_feature_window_t;
+
+/* Function prototypes ----------------------------------------------------- */
+extern "C" EI_IMPULSE_ERROR run_inference(ei::matrix_t *fmatrix, ei_impulse_result_t *result, bool debug);
+static EI_IMPULSE_ERROR run_inference_internal(ei::matrix_t *fmatrix, const ei_input_writer_t *writer,
+                                               ei_impulse_result_t *result, bool debug);
+static int write_feature_window(void *ctx, int8_t *int8_input, float *float_input, size_t input_size,
+                                float scale, int32_t zero_point);
+#if EIDSP_USE_FIXED_POINT
+extern "C" EI_IMPULSE_ERROR run_inference_quantized(const int8_t *features, size_t features_size,
+                                                    ei_impulse_result_t *result, bool debug);
+static int write_quantized_features(void *ctx, int8_t *int8_input, float *float_input, size_t input_size,
+                                    float scale, int32_t zero_point);
+#endif
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+static TfLiteStatus compiled_model_begin(void);
+static void compiled_model_end(bool release);
+#endif
+__attribute__((unused)) static int calc_cepstral_mean_and_var_normalization(ei_matrix *matrix, size_t first_frame,
+                                                                            ei_matrix *out_matrix, void *config_ptr);
+
+/* Private variables ------------------------------------------------------- */
+static ei_classifier_stream_t default_stream; /* Stream of run_classifier_continuous / run_classifier_push_samples */
+static EI_CLASSIFIER_THREAD_LOCAL const int16_t *pushed_samples = NULL; /* Block that is being pushed */
 
 /* Private functions ------------------------------------------------------- */
 
+/**
+ * @brief      Read the microsecond timer and the cycle counter of the porting layer
+ */
+static inline ei_timestamp_t ei_timestamp_now(void)
+{
+    ei_timestamp_t now = { ei_read_timer_us(), ei_read_timer_cycles() };
+    return now;
+}
+
+/**
+ * @brief      Time elapsed since a timestamp
+ */
+static inline ei_timestamp_t ei_timestamp_since(ei_timestamp_t start)
+{
+    ei_timestamp_t now = ei_timestamp_now();
+    ei_timestamp_t elapsed = { now.us - start.us, now.cycles - start.cycles };
+    return elapsed;
+}
+
+/**
+ * @brief      Move a timestamp forward, f.e. to leave a nested stage out of the elapsed time
+ */
+static inline ei_timestamp_t ei_timestamp_add(ei_timestamp_t start, ei_timestamp_t duration)
+{
+    ei_timestamp_t moved = { start.us + duration.us, start.cycles + duration.cycles };
+    return moved;
+}
+
+/**
+ * @brief      Store or add a duration in one stage of ei_impulse_result_timing_t,
+ *             keeping its ms, us and cycles fields consistent
+ */
+static inline void ei_timing_update(int *ms, int64_t *us, uint64_t *cycles, ei_timestamp_t duration, bool add)
+{
+    *us = (add ? *us : 0) + static_cast<int64_t>(duration.us);
+    *cycles = (add ? *cycles : 0) + duration.cycles;
+    *ms = static_cast<int>(*us / 1000);
+}
+
+#define EI_TIMING_SET(timing, stage, duration) \
+    ei_timing_update(&(timing).stage, &(timing).stage##_us, &(timing).stage##_cycles, (duration), false)
+#define EI_TIMING_ADD(timing, stage, duration) \
+    ei_timing_update(&(timing).stage, &(timing).stage##_us, &(timing).stage##_cycles, (duration), true)
+
 /**
  * @brief      Run a moving average filter over the classification result.
  *             The size of the filter determines the response of the filter.
@@ -151,6 +297,7 @@ extern "C" float run_moving_average_filter(ei_impulse_maf *maf, float classifica
  */
 static void clear_moving_average_filter(ei_impulse_maf *maf)
 {
+    maf->buf_idx = 0;
     maf->running_sum = 0;
 
     for (int i = 0; i < (EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW >> 1); i++) {
@@ -159,42 +306,94 @@ static void clear_moving_average_filter(ei_impulse_maf *maf)
 }
 
 /**
- * @brief      Init static vars
+ * @brief      (Re)start a stream: empty the feature window, drop the audio history
+ *             and clear the moving average filter. Call before the first slice, and
+ *             whenever there was a gap in the audio.
+ *
+ * @param      stream  The stream
  */
-extern "C" void run_classifier_init(void)
+extern "C" void run_classifier_stream_init(ei_classifier_stream_t *stream)
 {
-    slice_offset = 0;
-    feature_buffer_full = false;
+    stream->slice_offset = 0;
+    stream->feature_window_head = 0;
+    stream->feature_buffer_full = false;
+    stream->pushed_slice_samples = 0;
+    stream->pushed_slice_dsp.us = 0;
+    stream->pushed_slice_dsp.cycles = 0;
+
+    stream->mfcc.reset();
 
     for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-        clear_moving_average_filter(&classifier_maf[ix]);
+        clear_moving_average_filter(&stream->maf[ix]);
     }
+
+#if EI_CLASSIFIER_VAD_GATE == 1
+    stream->vad.configure(EI_CLASSIFIER_VAD_THRESHOLD_DB, EI_CLASSIFIER_VAD_MIN_RMS);
+    stream->vad.reset();
+    stream->active_slices_left = 0;
+#endif
 }
 
 /**
- * @brief      Fill the complete matrix with sample slices. From there, run inference
- *             on the matrix.
- *
- * @param      signal  Sample data
- * @param      result  Classification output
- * @param[in]  debug   Debug output enable boot
- *
- * @return     The ei impulse error.
+ * @brief      Init static vars (the stream of run_classifier_continuous and
+ *             run_classifier_push_samples)
  */
-extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impulse_result_t *result,
-                                                      bool debug = false)
+extern "C" void run_classifier_init(void)
 {
-    static ei::matrix_t static_features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
-    if (!static_features_matrix.buffer) {
-        return EI_IMPULSE_ALLOC_FAILED;
-    }
+    run_classifier_stream_init(&default_stream);
 
-    EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
+    extract_mfcc_per_slice_reset();
+}
 
-    uint64_t dsp_start_ms = ei_read_timer_ms();
+/**
+ * @brief      Free the model that is kept resident between inferences
+ *             (see EI_CLASSIFIER_PERSISTENT_SESSION), f.e. to get the RAM
+ *             back while not classifying. The next inference sets it up again.
+ *             A static arena (EI_CLASSIFIER_ALLOCATION_STATIC) stays reserved.
+ *             The DSP scratch arena is freed as well. With EI_CLASSIFIER_THREAD_SAFE
+ *             this frees the model and the DSP caches of the calling thread, call it
+ *             before a classifying thread exits.
+ */
+extern "C" void run_classifier_deinit(void)
+{
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+    compiled_model_end(true);
+#elif EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_CUBEAI
+    if (network) {
+        ai_network_destroy(network);
+        network = AI_HANDLE_NULL;
+    }
+#endif
 
+    ei::scratch_arena::clear();
+#if EI_CLASSIFIER_THREAD_SAFE == 1
+    ei::numpy::clear_fft_plans();
+    ei::numpy::clear_dct_bases();
+    ei::speechpy::feature::clear_filterbank_cache();
+#endif
+}
+
+/**
+ * @brief      Run the DSP blocks over a block of samples, and append the frames
+ *             that complete to the feature window of the stream. Samples that do not
+ *             complete a frame are kept by the stream for the next call.
+ *
+ * @param      stream  The stream
+ * @param      signal  Sample data, any number of samples
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR continuous_append_features(ei_classifier_stream_t *stream, signal_t *signal)
+{
     size_t out_features_index = 0;
-    size_t feature_size;
+    size_t frame_count = 0;
+
+#if EI_CLASSIFIER_VAD_GATE == 1
+    if (stream->vad.process(signal) != EIDSP_OK) {
+        ei_printf("ERR: Failed to read the signal for voice activity detection\n");
+        return EI_IMPULSE_DSP_ERROR;
+    }
+#endif
 
     for (size_t ix = 0; ix < ei_dsp_blocks_size; ix++) {
         ei_model_dsp_t block = ei_dsp_blocks[ix];
@@ -204,15 +403,25 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
             return EI_IMPULSE_DSP_ERROR;
         }
 
-        ei::matrix_t fm(1, block.n_output_features,
-                        static_features_matrix.buffer + out_features_index + slice_offset);
-
-        /* Switch to the slice version of the mfcc feature extract function */
-        if (block.extract_fn == extract_mfcc_features) {
-            block.extract_fn = &extract_mfcc_per_slice_features;
+        /* Continuous inferencing needs a feature extractor that produces frames */
+        if (block.extract_fn != extract_mfcc_features) {
+            ei_printf("ERR: Continuous inferencing is only supported for MFCC blocks\n");
+            return EI_IMPULSE_DSP_ERROR;
         }
 
-        int ret = block.extract_fn(signal, &fm, block.config);
+        ei_dsp_config_mfcc_t *config = (ei_dsp_config_mfcc_t *)block.config;
+
+#if EIDSP_USE_FIXED_POINT
+        int ret = extract_mfcc_per_slice_features_fixed(&stream->mfcc, signal, stream->features + out_features_index,
+                                                        block.n_output_features / config->num_cepstral,
+                                                        stream->feature_window_head, &frame_count, block.config);
+#else
+        ei::matrix_t feature_window(block.n_output_features / config->num_cepstral, config->num_cepstral,
+                                    stream->features + out_features_index);
+
+        int ret = extract_mfcc_per_slice_features(&stream->mfcc, signal, &feature_window,
+                                                  stream->feature_window_head, &frame_count, block.config);
+#endif
         if (ret != EIDSP_OK) {
             ei_printf("ERR: Failed to run DSP process (%d)\n", ret);
             return EI_IMPULSE_DSP_ERROR;
@@ -223,26 +432,107 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
         }
 
         out_features_index += block.n_output_features;
+    }
+
+    if (ei_dsp_blocks_size > 0) {
+        size_t num_cepstral = ((ei_dsp_config_mfcc_t *)ei_dsp_blocks[0].config)->num_cepstral;
+        size_t window_frames = ei_dsp_blocks[0].n_output_features / num_cepstral;
+
+        stream->feature_window_head = (stream->feature_window_head + frame_count) % window_frames;
 
-        feature_size = (fm.rows * fm.cols);
+        /* For as long as the feature buffer isn't completely full, keep counting */
+        if (stream->feature_buffer_full == false) {
+            stream->slice_offset += frame_count;
+
+            if (stream->slice_offset >= window_frames) {
+                stream->feature_buffer_full = true;
+            }
+        }
     }
 
-    /* For as long as the feature buffer isn't completely full, keep moving the slice offset */
-    if (feature_buffer_full == false) {
-        slice_offset += feature_size;
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      Classify the feature window of a stream at a slice boundary: normalize
+ *             the window into the model input, run inference and the moving average
+ *             filter. Nothing is classified until the window has filled up once.
+ *             With EI_CLASSIFIER_VAD_GATE, a window without voice activity in any of its
+ *             slices is not classified either: result->skipped is set and the
+ *             classification values are 0. The moving average filter starts over when
+ *             activity comes back.
+ *             result->timing.dsp should hold the time spent on the DSP for this slice.
+ *
+ * @param      stream  The stream
+ * @param      result  Classification output
+ * @param[in]  debug   Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR continuous_classify(ei_classifier_stream_t *stream, ei_impulse_result_t *result, bool debug)
+{
+#if !EIDSP_USE_FIXED_POINT
+    ei::matrix_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE, stream->features);
+#endif
+
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+    /* Normalized copy of the window, in order, anomaly detection needs the float features */
+    static EI_CLASSIFIER_THREAD_LOCAL ei::matrix_t classify_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    if (!classify_matrix.buffer) {
+        return EI_IMPULSE_ALLOC_FAILED;
+    }
+#endif
+
+    EI_IMPULSE_ERROR ei_impulse_error = EI_IMPULSE_OK;
 
-        if (slice_offset > (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size)) {
-            feature_buffer_full = true;
-            slice_offset -= feature_size;
+    result->skipped = false;
+
+#if EI_CLASSIFIER_VAD_GATE == 1
+    /* A window is worth classifying while one of its slices was active */
+    if (stream->vad.end_slice()) {
+        if (stream->active_slices_left == 0) {
+            /* the results before the silence say nothing about this window */
+            for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+                clear_moving_average_filter(&stream->maf[ix]);
+            }
         }
+        stream->active_slices_left = EI_CLASSIFIER_SLICES_PER_MODEL_WINDOW;
+    }
+    else if (stream->active_slices_left > 0) {
+        stream->active_slices_left--;
     }
 
-    result->timing.dsp = ei_read_timer_ms() - dsp_start_ms;
+    if (stream->feature_buffer_full == true && stream->active_slices_left == 0) {
+        if (debug) {
+            ei_printf("No voice activity, skipping the neural network\n");
+        }
+
+        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+            result->classification[ix].label = ei_classifier_inferencing_categories[ix];
+            result->classification[ix].value = 0.0f;
+        }
+        result->anomaly = 0.0f;
+        EI_TIMING_SET(result->timing, classification, ei_timestamp_t());
+        EI_TIMING_SET(result->timing, anomaly, ei_timestamp_t());
+        result->skipped = true;
+        return EI_IMPULSE_OK;
+    }
+#endif
 
     if (debug) {
-        ei_printf("\r\nFeatures (%d ms.): ", result->timing.dsp);
-        for (size_t ix = 0; ix < static_features_matrix.cols; ix++) {
-            ei_printf_float(static_features_matrix.buffer[ix]);
+        size_t window_start = 0;
+        if (ei_dsp_blocks_size > 0) {
+            window_start = stream->feature_window_head * ((ei_dsp_config_mfcc_t *)ei_dsp_blocks[0].config)->num_cepstral;
+        }
+
+        ei_printf("\r\nFeatures (%d us.): ", static_cast<int>(result->timing.dsp_us));
+        for (size_t ix = 0; ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; ix++) {
+#if EIDSP_USE_FIXED_POINT
+            ei_printf_float(static_cast<float>(stream->features[(window_start + ix) % EI_CLASSIFIER_NN_INPUT_FRAME_SIZE]) /
+                            static_cast<float>(1 << speechpy::mfcc_stream_fixed::frac_bits));
+#else
+            ei_printf_float(stream->features[(window_start + ix) % EI_CLASSIFIER_NN_INPUT_FRAME_SIZE]);
+#endif
             ei_printf(" ");
         }
         ei_printf("\n");
@@ -254,31 +544,195 @@ extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impul
     }
 #endif
 
-    if (feature_buffer_full == true) {
-        dsp_start_ms = ei_read_timer_ms();
-        ei::matrix_t classify_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
+    if (stream->feature_buffer_full == true) {
+#if EI_CLASSIFIER_HAS_ANOMALY == 1
+        ei_timestamp_t dsp_start = ei_timestamp_now();
 
-        /* Create a copy of the matrix for normalization */
-        for (size_t m_ix = 0; m_ix < EI_CLASSIFIER_NN_INPUT_FRAME_SIZE; m_ix++) {
-            classify_matrix.buffer[m_ix] = static_features_matrix.buffer[m_ix];
+        /* Normalize straight from the circular buffer into the classify matrix */
+        int ret = calc_cepstral_mean_and_var_normalization(&features_matrix, stream->feature_window_head,
+                                                           &classify_matrix, ei_dsp_blocks[0].config);
+        if (ret != EIDSP_OK) {
+            return EI_IMPULSE_DSP_ERROR;
         }
-
-        calc_cepstral_mean_and_var_normalization(&classify_matrix, ei_dsp_blocks[0].config);
-        result->timing.dsp += ei_read_timer_ms() - dsp_start_ms;
+        EI_TIMING_ADD(result->timing, dsp, ei_timestamp_since(dsp_start));
 
         ei_impulse_error = run_inference(&classify_matrix, result, debug);
+#else
+        /* Normalize (and quantize) straight from the circular buffer into the model input */
+#if EIDSP_USE_FIXED_POINT
+        ei_feature_window_t window = { stream->features, stream->feature_window_head,
+                                       (ei_dsp_config_mfcc_t *)ei_dsp_blocks[0].config };
+#else
+        ei_feature_window_t window = { &features_matrix, stream->feature_window_head,
+                                       (ei_dsp_config_mfcc_t *)ei_dsp_blocks[0].config };
+#endif
+        ei_input_writer_t writer = { write_feature_window, &window };
+
+        ei_impulse_error = run_inference_internal(NULL, &writer, result, debug);
+#endif
 
         for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
             result->classification[ix].value =
-                run_moving_average_filter(&classifier_maf[ix], result->classification[ix].value);
+                run_moving_average_filter(&stream->maf[ix], result->classification[ix].value);
         }
+    }
+    return ei_impulse_error;
+}
+
+/**
+ * @brief      Fill the feature window of a stream with sample slices. From there, run
+ *             inference on the window.
+ *
+ * @param      stream  The stream, see run_classifier_stream_init
+ * @param      signal  Sample data
+ * @param      result  Classification output
+ * @param[in]  debug   Debug output enable boot
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_stream_continuous(ei_classifier_stream_t *stream, signal_t *signal,
+                                                             ei_impulse_result_t *result, bool debug = false)
+{
+    ei_timestamp_t dsp_start = ei_timestamp_now();
+
+    EI_IMPULSE_ERROR ei_impulse_error = continuous_append_features(stream, signal);
+    if (ei_impulse_error != EI_IMPULSE_OK) {
+        return ei_impulse_error;
+    }
 
-        /* Shift the feature buffer for new data */
-        for (size_t i = 0; i < (EI_CLASSIFIER_NN_INPUT_FRAME_SIZE - feature_size); i++) {
-            static_features_matrix.buffer[i] = static_features_matrix.buffer[i + feature_size];
+    EI_TIMING_SET(result->timing, dsp, ei_timestamp_since(dsp_start));
+
+    return continuous_classify(stream, result, debug);
+}
+
+/**
+ * @brief      Fill the complete matrix with sample slices. From there, run inference
+ *             on the matrix.
+ *
+ * @param      signal  Sample data
+ * @param      result  Classification output
+ * @param[in]  debug   Debug output enable boot
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_continuous(signal_t *signal, ei_impulse_result_t *result,
+                                                      bool debug = false)
+{
+    return run_classifier_stream_continuous(&default_stream, signal, result, debug);
+}
+
+/**
+ * @brief      Signal callbacks over the block passed to run_classifier_push_samples
+ */
+static int pushed_samples_get_data(size_t offset, size_t length, float *out_ptr)
+{
+    return numpy::int16_to_float(pushed_samples + offset, out_ptr, length);
+}
+
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+static int pushed_samples_get_data_int16(size_t offset, size_t length, int16_t *out_ptr)
+{
+    memcpy(out_ptr, pushed_samples + offset, length * sizeof(int16_t));
+    return 0;
+}
+#endif
+
+/**
+ * @brief      Streaming version of run_classifier_stream_continuous. Push audio as it
+ *             comes in (f.e. every DMA half-buffer), the MFCC frames are calculated as
+ *             soon as their samples are in. Every EI_CLASSIFIER_SLICE_SIZE samples (a slice
+ *             boundary) the window is normalized and classified, so the latency at the
+ *             boundary is the model only. The results are the same as calling
+ *             run_classifier_stream_continuous once per slice. Call
+ *             run_classifier_stream_init before the first push, and don't mix with
+ *             run_classifier_stream_continuous on the same stream.
+ *             If one push completes more than one slice, every slice is classified
+ *             (and goes through the moving average filter) but the result holds the
+ *             last one, so push at most EI_CLASSIFIER_SLICE_SIZE samples at a time to
+ *             see every result.
+ *
+ * @param      stream        The stream
+ * @param[in]  samples       Audio samples, any number
+ * @param[in]  sample_count  Number of samples
+ * @param      result        Classification output, only written when a slice completes
+ * @param[out] result_ready  Set to true if a slice completed and result was written
+ * @param[in]  debug         Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_stream_push_samples(ei_classifier_stream_t *stream,
+                                                               const int16_t *samples, size_t sample_count,
+                                                               ei_impulse_result_t *result, bool *result_ready,
+                                                               bool debug = false)
+{
+    *result_ready = false;
+
+    while (sample_count > 0) {
+        /* Never run the DSP past a slice boundary, the window is classified in between */
+        size_t length = EI_CLASSIFIER_SLICE_SIZE - stream->pushed_slice_samples;
+        if (length > sample_count) {
+            length = sample_count;
+        }
+
+        ei_timestamp_t dsp_start = ei_timestamp_now();
+
+        signal_t signal;
+        signal.total_length = length;
+        signal.get_data = &pushed_samples_get_data;
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+        /* the fixed point MFCC reads the samples as they are */
+        signal.get_data_int16 = &pushed_samples_get_data_int16;
+#endif
+        pushed_samples = samples;
+
+        EI_IMPULSE_ERROR ei_impulse_error = continuous_append_features(stream, &signal);
+        pushed_samples = NULL;
+        if (ei_impulse_error != EI_IMPULSE_OK) {
+            return ei_impulse_error;
+        }
+
+        stream->pushed_slice_dsp = ei_timestamp_add(stream->pushed_slice_dsp, ei_timestamp_since(dsp_start));
+        stream->pushed_slice_samples += length;
+        samples += length;
+        sample_count -= length;
+
+        if (stream->pushed_slice_samples < EI_CLASSIFIER_SLICE_SIZE) {
+            continue;
         }
+
+        /* Slice boundary, only normalization and the model are left */
+        EI_TIMING_SET(result->timing, dsp, stream->pushed_slice_dsp);
+        stream->pushed_slice_samples = 0;
+        stream->pushed_slice_dsp.us = 0;
+        stream->pushed_slice_dsp.cycles = 0;
+
+        ei_impulse_error = continuous_classify(stream, result, debug);
+        if (ei_impulse_error != EI_IMPULSE_OK) {
+            return ei_impulse_error;
+        }
+        *result_ready = true;
     }
-    return ei_impulse_error;
+
+    return EI_IMPULSE_OK;
+}
+
+/**
+ * @brief      run_classifier_stream_push_samples on the stream of run_classifier_continuous,
+ *             call run_classifier_init before the first push.
+ *
+ * @param[in]  samples       Audio samples, any number
+ * @param[in]  sample_count  Number of samples
+ * @param      result        Classification output, only written when a slice completes
+ * @param[out] result_ready  Set to true if a slice completed and result was written
+ * @param[in]  debug         Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_classifier_push_samples(const int16_t *samples, size_t sample_count,
+                                                        ei_impulse_result_t *result, bool *result_ready,
+                                                        bool debug = false)
+{
+    return run_classifier_stream_push_samples(&default_stream, samples, sample_count, result, result_ready, debug);
 }
 
 /**
@@ -295,25 +749,85 @@ extern "C" EI_IMPULSE_ERROR run_inference(
     ei_impulse_result_t *result,
     bool debug = false)
 {
+    return run_inference_internal(fmatrix, NULL, result, debug);
+}
+
+#if EIDSP_USE_FIXED_POINT
+/**
+ * @brief      Do inferencing over features that are already quantized
+ *             to the model input (fixed-point front end)
+ *
+ * @param      features       Quantized features
+ * @param[in]  features_size  Number of features, should be EI_CLASSIFIER_NN_INPUT_FRAME_SIZE
+ * @param      result         Output classifier results
+ * @param[in]  debug          Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+extern "C" EI_IMPULSE_ERROR run_inference_quantized(
+    const int8_t *features,
+    size_t features_size,
+    ei_impulse_result_t *result,
+    bool debug = false)
+{
+    if (features_size != EI_CLASSIFIER_NN_INPUT_FRAME_SIZE) {
+        return EI_IMPULSE_ERROR_SHAPES_DONT_MATCH;
+    }
+
+    ei_input_writer_t writer = { write_quantized_features, const_cast<int8_t *>(features) };
+
+    return run_inference_internal(NULL, &writer, result, debug);
+}
+#endif // EIDSP_USE_FIXED_POINT
+
+/**
+ * @brief      Do inferencing over a processed feature matrix, or let a writer
+ *             fill the model input in place
+ *
+ * @param      fmatrix  Processed matrix, NULL if writer is set
+ * @param      writer   Fills the model input, or NULL
+ * @param      result   Output classifier results
+ * @param[in]  debug    Debug output enable
+ *
+ * @return     The ei impulse error.
+ */
+static EI_IMPULSE_ERROR run_inference_internal(
+    ei::matrix_t *fmatrix,
+    const ei_input_writer_t *writer,
+    ei_impulse_result_t *result,
+    bool debug)
+{
+    result->skipped = false;
 
 #if EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_UTENSOR
     // now turn into floats...
-    RamTensor<float> *input_x = new RamTensor<float>({ 1, static_cast<unsigned int>(fmatrix->rows * fmatrix->cols) });
+    size_t input_size = writer ? EI_CLASSIFIER_NN_INPUT_FRAME_SIZE : fmatrix->rows * fmatrix->cols;
+    RamTensor<float> *input_x = new RamTensor<float>({ 1, static_cast<unsigned int>(input_size) });
     float *buff = (float*)input_x->write(0, 0);
-    memcpy(buff, fmatrix->buffer, fmatrix->rows * fmatrix->cols * sizeof(float));
+    if (writer) {
+        ei_timestamp_t write_start = ei_timestamp_now();
+        if (writer->fn(writer->ctx, NULL, buff, input_size, 1.0f, 0) != EIDSP_OK) {
+            delete input_x;
+            return EI_IMPULSE_DSP_ERROR;
+        }
+        EI_TIMING_ADD(result->timing, dsp, ei_timestamp_since(write_start));
+    }
+    else {
+        memcpy(buff, fmatrix->buffer, input_size * sizeof(float));
+    }
 
     {
-        uint64_t ctx_start_ms = ei_read_timer_ms();
+        ei_timestamp_t ctx_start = ei_timestamp_now();
         Context ctx;
         get_trained_ctx(ctx, input_x);
         ctx.eval();
-        uint64_t ctx_end_ms = ei_read_timer_ms();
+        ei_timestamp_t ctx_time = ei_timestamp_since(ctx_start);
 
         if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
             return EI_IMPULSE_CANCELED;
         }
 
-        result->timing.classification = ctx_end_ms - ctx_start_ms;
+        EI_TIMING_SET(result->timing, classification, ctx_time);
 
         S_TENSOR pred_tensor = ctx.get(EI_CLASSIFIER_OUT_TENSOR_NAME);  // getting a reference to the output tensor
 
@@ -324,7 +838,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         }
 
         if (debug) {
-            ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
+            ei_printf("Predictions (time: %d us.):\n", static_cast<int>(result->timing.classification_us));
         }
         const float* ptr_pred = pred_tensor->read<float>(0, 0);
 
@@ -349,18 +863,19 @@ extern "C" EI_IMPULSE_ERROR run_inference(
             return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
         }
 #else
-        TfLiteStatus init_status = trained_model_init(ei_aligned_malloc);
+        TfLiteStatus init_status = compiled_model_begin();
         if (init_status != kTfLiteOk) {
             ei_printf("Failed to allocate TFLite arena (error code %d)\n", init_status);
             return EI_IMPULSE_TFLITE_ARENA_ALLOC_FAILED;
         }
 #endif
-        uint64_t ctx_start_ms = ei_read_timer_ms();
+        ei_timestamp_t ctx_start = ei_timestamp_now();
 
-        static bool tflite_first_run = true;
+        /* first run on this thread with EI_CLASSIFIER_THREAD_SAFE, like compiled_model_ready */
+        static EI_CLASSIFIER_THREAD_LOCAL bool tflite_first_run = true;
 
 #if (EI_CLASSIFIER_COMPILED != 1)
-        static const tflite::Model* model = nullptr;
+        static EI_CLASSIFIER_THREAD_LOCAL const tflite::Model* model = nullptr;
 #endif
 
 #if (EI_CLASSIFIER_COMPILED != 1)
@@ -434,12 +949,35 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 
         // Place our calculated x value in the model's input tensor
         bool int8_input = input->type == TfLiteType::kTfLiteInt8;
-        for (size_t ix = 0; ix < fmatrix->rows * fmatrix->cols; ix++) {
-            // Quantize the input if it is int8
-            if (int8_input) {
-                input->data.int8[ix] = static_cast<int8_t>(round(fmatrix->buffer[ix] / input->params.scale) + input->params.zero_point);
-            } else {
-                input->data.f[ix] = fmatrix->buffer[ix];
+        if (writer) {
+            // The writer fills the tensor in place, this is still DSP time
+            ei_timestamp_t write_start = ei_timestamp_now();
+            int ret = writer->fn(writer->ctx,
+                                 int8_input ? input->data.int8 : NULL,
+                                 int8_input ? NULL : input->data.f,
+                                 EI_CLASSIFIER_NN_INPUT_FRAME_SIZE,
+                                 input->params.scale, input->params.zero_point);
+            ei_timestamp_t write_time = ei_timestamp_since(write_start);
+            if (ret != EIDSP_OK) {
+                ei_printf("ERR: Failed to write the model input (%d)\n", ret);
+#if (EI_CLASSIFIER_COMPILED != 1)
+                ei_aligned_free(tensor_arena);
+#else
+                compiled_model_end(false);
+#endif
+                return EI_IMPULSE_DSP_ERROR;
+            }
+            EI_TIMING_ADD(result->timing, dsp, write_time);
+            ctx_start = ei_timestamp_add(ctx_start, write_time);
+        }
+        else {
+            for (size_t ix = 0; ix < fmatrix->rows * fmatrix->cols; ix++) {
+                // Quantize the input if it is int8
+                if (int8_input) {
+                    input->data.int8[ix] = static_cast<int8_t>(round(fmatrix->buffer[ix] / input->params.scale) + input->params.zero_point);
+                } else {
+                    input->data.f[ix] = fmatrix->buffer[ix];
+                }
             }
         }
 
@@ -452,16 +990,35 @@ extern "C" EI_IMPULSE_ERROR run_inference(
             return EI_IMPULSE_TFLITE_ERROR;
         }
 #else
-        trained_model_invoke();
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+        uint32_t profiler_sequence = ei_profiler_sequence();
+#endif
+        TfLiteStatus invoke_status = trained_model_invoke();
+        if (invoke_status != kTfLiteOk) {
+            ei_printf("Invoke failed (%d)\n", invoke_status);
+            compiled_model_end(true);
+            return EI_IMPULSE_TFLITE_ERROR;
+        }
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+        ei_profiler_summarize(profiler_sequence, result->timing.ops, EI_CLASSIFIER_PROFILER_MAX_OPS);
+        result->timing.ticks_per_second = ei_profiler_ticks_per_second();
+        if (debug) {
+            ei_printf("Operators (ticks):\n");
+            for (size_t ix = 0; ix < EI_CLASSIFIER_PROFILER_MAX_OPS && result->timing.ops[ix].op; ix++) {
+                ei_printf("%s:\t%u nodes, %lu ticks\n", result->timing.ops[ix].op,
+                    (unsigned)result->timing.ops[ix].nodes, (unsigned long)result->timing.ops[ix].ticks);
+            }
+        }
+#endif
 #endif
 
-        uint64_t ctx_end_ms = ei_read_timer_ms();
+        ei_timestamp_t ctx_time = ei_timestamp_since(ctx_start);
 
-        result->timing.classification = ctx_end_ms - ctx_start_ms;
+        EI_TIMING_SET(result->timing, classification, ctx_time);
 
         // Read the predicted y value from the model's output tensor
         if (debug) {
-            ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
+            ei_printf("Predictions (time: %d us.):\n", static_cast<int>(result->timing.classification_us));
         }
         bool int8_output = output->type == TfLiteType::kTfLiteInt8;
         for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
@@ -484,7 +1041,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 #if (EI_CLASSIFIER_COMPILED != 1)
         ei_aligned_free(tensor_arena);
 #else
-        trained_model_reset(ei_aligned_free);
+        compiled_model_end(false);
 #endif
 
         if (ei_run_impulse_check_canceled() == EI_IMPULSE_CANCELED) {
@@ -535,7 +1092,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         }
     }
 
-    uint64_t ctx_start_ms = ei_read_timer_ms();
+    ei_timestamp_t ctx_start = ei_timestamp_now();
 
 #if EI_CLASSIFIER_CUBEAI_QUANTIZED_IN_OUT == 1
     ai_network_report report;
@@ -550,12 +1107,35 @@ extern "C" EI_IMPULSE_ERROR run_inference(
     // No idea why this is necessary but UART1 stops working on ST IoT Discovery Kit otherwise?!
     HAL_Delay(1);
 
-    for (int ix = 0; ix < fmatrix->rows * fmatrix->cols; ix++) {
-        in_data[ix] = static_cast<int8_t>(round(fmatrix->buffer[ix] / input_scale) + input_zero_point);
+    if (writer) {
+        ei_timestamp_t write_start = ei_timestamp_now();
+        if (writer->fn(writer->ctx, (int8_t *)in_data, NULL, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE,
+                       input_scale, input_zero_point) != EIDSP_OK) {
+            return EI_IMPULSE_DSP_ERROR;
+        }
+        ei_timestamp_t write_time = ei_timestamp_since(write_start);
+        EI_TIMING_ADD(result->timing, dsp, write_time);
+        ctx_start = ei_timestamp_add(ctx_start, write_time);
+    }
+    else {
+        for (int ix = 0; ix < fmatrix->rows * fmatrix->cols; ix++) {
+            in_data[ix] = static_cast<int8_t>(round(fmatrix->buffer[ix] / input_scale) + input_zero_point);
+        }
     }
 #else
-    // fmatrix->buffer <-- input data
-    memcpy(in_data, fmatrix->buffer, AI_NETWORK_IN_1_SIZE * sizeof(float));
+    if (writer) {
+        ei_timestamp_t write_start = ei_timestamp_now();
+        if (writer->fn(writer->ctx, NULL, (float *)in_data, AI_NETWORK_IN_1_SIZE, 1.0f, 0) != EIDSP_OK) {
+            return EI_IMPULSE_DSP_ERROR;
+        }
+        ei_timestamp_t write_time = ei_timestamp_since(write_start);
+        EI_TIMING_ADD(result->timing, dsp, write_time);
+        ctx_start = ei_timestamp_add(ctx_start, write_time);
+    }
+    else {
+        // fmatrix->buffer <-- input data
+        memcpy(in_data, fmatrix->buffer, AI_NETWORK_IN_1_SIZE * sizeof(float));
+    }
 #endif
 
     ai_i32 n_batch;
@@ -579,12 +1159,12 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         return EI_IMPULSE_CUBEAI_ERROR;
     }
 
-    uint64_t ctx_end_ms = ei_read_timer_ms();
+    ei_timestamp_t ctx_time = ei_timestamp_since(ctx_start);
 
-    result->timing.classification = ctx_end_ms - ctx_start_ms;
+    EI_TIMING_SET(result->timing, classification, ctx_time);
 
     if (debug) {
-        ei_printf("Predictions (time: %d ms.):\n", result->timing.classification);
+        ei_printf("Predictions (time: %d us.):\n", static_cast<int>(result->timing.classification_us));
     }
     for (uint32_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
 #if EI_CLASSIFIER_CUBEAI_QUANTIZED_IN_OUT == 1
@@ -608,7 +1188,7 @@ extern "C" EI_IMPULSE_ERROR run_inference(
 
     // Anomaly detection
     {
-        uint64_t anomaly_start_ms = ei_read_timer_ms();
+        ei_timestamp_t anomaly_start = ei_timestamp_now();
 
         float input[EI_CLASSIFIER_ANOM_AXIS_SIZE];
         for (size_t ix = 0; ix < EI_CLASSIFIER_ANOM_AXIS_SIZE; ix++) {
@@ -618,15 +1198,15 @@ extern "C" EI_IMPULSE_ERROR run_inference(
         float anomaly = get_min_distance_to_cluster(
             input, EI_CLASSIFIER_ANOM_AXIS_SIZE, ei_classifier_anom_clusters, EI_CLASSIFIER_ANOM_CLUSTER_COUNT);
 
-        uint64_t anomaly_end_ms = ei_read_timer_ms();
+        ei_timestamp_t anomaly_time = ei_timestamp_since(anomaly_start);
 
         if (debug) {
-            ei_printf("Anomaly score (time: %d ms.): ", static_cast<int>(anomaly_end_ms - anomaly_start_ms));
+            ei_printf("Anomaly score (time: %d us.): ", static_cast<int>(anomaly_time.us));
             ei_printf_float(anomaly);
             ei_printf("\n");
         }
 
-        result->timing.anomaly = anomaly_end_ms - anomaly_start_ms;
+        EI_TIMING_SET(result->timing, anomaly, anomaly_time);
 
         result->anomaly = anomaly;
     }
@@ -666,7 +1246,7 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
 
     ei::matrix_t features_matrix(1, EI_CLASSIFIER_NN_INPUT_FRAME_SIZE);
 
-    uint64_t dsp_start_ms = ei_read_timer_ms();
+    ei_timestamp_t dsp_start = ei_timestamp_now();
 
     size_t out_features_index = 0;
 
@@ -693,10 +1273,10 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
         out_features_index += block.n_output_features;
     }
 
-    result->timing.dsp = ei_read_timer_ms() - dsp_start_ms;
+    EI_TIMING_SET(result->timing, dsp, ei_timestamp_since(dsp_start));
 
     if (debug) {
-        ei_printf("Features (%d ms.): ", result->timing.dsp);
+        ei_printf("Features (%d us.): ", static_cast<int>(result->timing.dsp_us));
         for (size_t ix = 0; ix < features_matrix.cols; ix++) {
             ei_printf_float(features_matrix.buffer[ix]);
             ei_printf(" ");
@@ -716,28 +1296,168 @@ extern "C" EI_IMPULSE_ERROR run_classifier(
 /**
  * @brief      Calculates the cepstral mean and variable normalization.
  *
- * @param      matrix      Source and destination matrix
- * @param      config_ptr  ei_dsp_config_mfcc_t struct pointer
+ * @param      matrix       Source matrix, a circular buffer of frames
+ * @param[in]  first_frame  Frame in the source matrix that holds the oldest frame
+ * @param      out_matrix   Destination matrix, frames in order
+ * @param      config_ptr   ei_dsp_config_mfcc_t struct pointer
+ *
+ * @return     EIDSP_OK if OK
  */
-static void calc_cepstral_mean_and_var_normalization(ei_matrix *matrix, void *config_ptr)
+static int calc_cepstral_mean_and_var_normalization(ei_matrix *matrix, size_t first_frame,
+                                                    ei_matrix *out_matrix, void *config_ptr)
 {
     ei_dsp_config_mfcc_t *config = (ei_dsp_config_mfcc_t *)config_ptr;
 
     /* Modify rows and colums ration for matrix normalization */
-    matrix->rows = EI_CLASSIFIER_NN_INPUT_FRAME_SIZE / config->num_cepstral;
-    matrix->cols = config->num_cepstral;
+    ei::matrix_t frames(EI_CLASSIFIER_NN_INPUT_FRAME_SIZE / config->num_cepstral, config->num_cepstral,
+                        matrix->buffer);
+    ei::matrix_t out_frames(EI_CLASSIFIER_NN_INPUT_FRAME_SIZE / config->num_cepstral, config->num_cepstral,
+                            out_matrix->buffer);
 
     // cepstral mean and variance normalization
-    int ret = speechpy::processing::cmvnw(matrix, config->win_size, true);
+    int ret = speechpy::processing::cmvnw(&frames, first_frame, &out_frames, config->win_size, true);
     if (ret != EIDSP_OK) {
         ei_printf("ERR: cmvnw failed (%d)\n", ret);
         EIDSP_ERR(ret);
     }
 
-    /* Reset rows and columns ratio */
-    matrix->rows = 1;
-    matrix->cols = EI_CLASSIFIER_NN_INPUT_FRAME_SIZE;
+    return EIDSP_OK;
+}
+
+/**
+ * @brief      Normalizes the continuous feature window straight into the model input,
+ *             quantizing on the way if the model takes int8
+ *
+ * @param      ctx          ei_feature_window_t struct pointer
+ * @param      int8_input   Quantized model input, or NULL
+ * @param      float_input  Float model input, or NULL
+ * @param[in]  input_size   Number of elements in the model input
+ * @param[in]  scale        Input quantization scale
+ * @param[in]  zero_point   Input quantization zero point
+ *
+ * @return     EIDSP_OK if OK
+ */
+static int write_feature_window(void *ctx, int8_t *int8_input, float *float_input, size_t input_size,
+                                float scale, int32_t zero_point)
+{
+    ei_feature_window_t *window = (ei_feature_window_t *)ctx;
+    uint32_t cols = window->config->num_cepstral;
+    uint32_t rows = EI_CLASSIFIER_NN_INPUT_FRAME_SIZE / cols;
+
+    if (input_size != EI_CLASSIFIER_NN_INPUT_FRAME_SIZE) {
+        EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+    }
+
+    // the prefix sums of the normalization come from the scratch arena
+    ei::scratch_arena::reserve(speechpy::processing::cmvnw_scratch_size(rows, EIDSP_USE_FIXED_POINT));
+    ei::scratch_arena::scope scratch;
+
+    int ret;
+#if EIDSP_USE_FIXED_POINT
+    (void)float_input;
+
+    if (!int8_input) {
+        EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+    }
+    ret = speechpy::processing::cmvnw_quantize(window->features, rows, cols, window->first_frame,
+                                               window->config->win_size, true,
+                                               speechpy::mfcc_stream_fixed::frac_bits,
+                                               scale, zero_point, int8_input);
+#else
+    ei::matrix_t frames(rows, cols, window->features->buffer);
+
+    if (int8_input) {
+        ret = speechpy::processing::cmvnw_quantize(&frames, window->first_frame, window->config->win_size,
+                                                   true, scale, zero_point, int8_input);
+    }
+    else {
+        ei::matrix_t out_frames(rows, cols, float_input);
+        ret = speechpy::processing::cmvnw(&frames, window->first_frame, &out_frames,
+                                          window->config->win_size, true);
+    }
+#endif
+    if (ret != EIDSP_OK) {
+        ei_printf("ERR: cmvnw failed (%d)\n", ret);
+        EIDSP_ERR(ret);
+    }
+
+    return EIDSP_OK;
+}
+
+#if EIDSP_USE_FIXED_POINT
+/**
+ * @brief      Copies features that are already quantized into the model input
+ *
+ * @param      ctx          The quantized features (int8_t pointer)
+ * @param      int8_input   Quantized model input, or NULL
+ * @param      float_input  Float model input, or NULL
+ * @param[in]  input_size   Number of elements in the model input
+ * @param[in]  scale        Input quantization scale (unused)
+ * @param[in]  zero_point   Input quantization zero point (unused)
+ *
+ * @return     EIDSP_OK if OK
+ */
+static int write_quantized_features(void *ctx, int8_t *int8_input, float *float_input, size_t input_size,
+                                    float scale, int32_t zero_point)
+{
+    (void)float_input;
+    (void)scale;
+    (void)zero_point;
+
+    if (!int8_input) {
+        EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+    }
+
+    memcpy(int8_input, ctx, input_size * sizeof(int8_t));
+
+    return EIDSP_OK;
+}
+#endif // EIDSP_USE_FIXED_POINT
+
+#if (EI_CLASSIFIER_INFERENCING_ENGINE == EI_CLASSIFIER_TFLITE) && (EI_CLASSIFIER_COMPILED == 1)
+/**
+ * @brief      Set up the compiled model (arena, kernel init and prepare),
+ *             unless it's still resident from a previous inference
+ *
+ * @return     kTfLiteOk if OK
+ */
+static TfLiteStatus compiled_model_begin(void)
+{
+    if (compiled_model_ready) {
+        return kTfLiteOk;
+    }
+
+    TfLiteStatus status = trained_model_init(ei_aligned_malloc);
+    if (status != kTfLiteOk) {
+        // free whatever was allocated before init failed
+        trained_model_reset(ei_aligned_free);
+        return status;
+    }
+
+    compiled_model_ready = true;
+    return kTfLiteOk;
+}
+
+/**
+ * @brief      Done with the compiled model for this inference. Frees it unless
+ *             it's kept resident (EI_CLASSIFIER_PERSISTENT_SESSION).
+ *
+ * @param[in]  release  Free the model even if it's kept resident
+ */
+static void compiled_model_end(bool release)
+{
+#if EI_CLASSIFIER_PERSISTENT_SESSION == 1
+    if (!release) {
+        return;
+    }
+#endif
+
+    if (compiled_model_ready) {
+        trained_model_reset(ei_aligned_free);
+        compiled_model_ready = false;
+    }
 }
+#endif // EI_CLASSIFIER_TFLITE && EI_CLASSIFIER_COMPILED
 
 #if EIDSP_SIGNAL_C_FN_POINTER == 0
 
@@ -764,7 +1484,8 @@ __attribute__((unused)) EI_IMPULSE_ERROR run_impulse(
 
     uint64_t next_tick = 0;
 
-    uint64_t sampling_us_start = ei_read_timer_us();
+    ei_timestamp_t sampling_start = ei_timestamp_now();
+    uint64_t sampling_us_start = sampling_start.us;
 
     // grab some data
     for (int i = 0; i < EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE; i += EI_CLASSIFIER_RAW_SAMPLES_PER_FRAME) {
@@ -786,7 +1507,7 @@ __attribute__((unused)) EI_IMPULSE_ERROR run_impulse(
         while (next_tick > ei_read_timer_us() - sampling_us_start);
     }
 
-    result->timing.sampling = (ei_read_timer_us() - sampling_us_start) / 1000;
+    EI_TIMING_SET(result->timing, sampling, ei_timestamp_since(sampling_start));
 
     signal_t signal;
     int err = numpy::signal_from_buffer(x, EI_CLASSIFIER_DSP_INPUT_FRAME_SIZE, &signal);
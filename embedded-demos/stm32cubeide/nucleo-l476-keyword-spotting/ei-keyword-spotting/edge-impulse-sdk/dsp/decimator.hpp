@@ -0,0 +1,219 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_DECIMATOR_H_
+#define _EIDSP_DECIMATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/config.hpp"
+#if EIDSP_USE_CMSIS_DSP
+#include "edge-impulse-sdk/CMSIS/DSP/Include/arm_math.h"
+#endif
+
+namespace ei {
+
+/**
+ * Decimate audio by 2, f.e. a microphone that runs at 32 kHz to a 16 kHz model,
+ * with a 47 tap half-band FIR as anti-alias filter. Relative to the input rate the
+ * passband is flat (within 0.1 dB) up to 0.22 fs, and everything above 0.28 fs
+ * is attenuated by at least 39 dB (65 dB above 0.31 fs), so content above the
+ * output Nyquist frequency doesn't alias back into the band.
+ *
+ * The filter runs in polyphase form: only the output samples are calculated, and
+ * as every other coefficient of a half-band filter is zero, one phase is a 24 tap
+ * FIR and the other one a delay. With CMSIS-DSP on a core with the DSP extension
+ * the FIR takes two taps per instruction (SMLAD).
+ *
+ * process() also converts the samples from the capture format (f.e. one channel of
+ * interleaved 24-bit I2S words) in the same pass, and keeps the filter history
+ * between calls, so audio can be pushed one DMA (half) buffer at a time. It does
+ * not allocate, so it's safe to call from an interrupt handler.
+ */
+class halfband_decimator {
+public:
+    halfband_decimator() {
+        reset();
+    }
+
+    /**
+     * Clear the filter history, f.e. when there was a gap in the audio stream
+     */
+    void reset() {
+        memset(_phase, 0, sizeof(_phase));
+        memset(_delay, 0, sizeof(_delay));
+        _pending = 0;
+        _has_pending = false;
+    }
+
+    /**
+     * Maximum number of output samples for `input_count` input samples
+     */
+    static size_t calculate_max_output(size_t input_count) {
+        return (input_count + 1) / 2;
+    }
+
+    /**
+     * Decimate a block of samples. Every input element is converted to int16 as
+     * `(int16_t)(input[ix * stride] >> shift)`, f.e. stride 2 and shift 8 reads the
+     * left channel of interleaved stereo with 24-bit samples in 32-bit words.
+     * @param input First input sample
+     * @param input_count Number of input samples
+     * @param stride Distance between input samples, in elements
+     * @param shift Right shift that turns an input element into an int16 sample
+     * @param output Output buffer, needs room for calculate_max_output(input_count)
+     *     samples. An odd input sample is kept until the next call.
+     * @returns Number of output samples
+     */
+    template<typename T>
+    size_t process(const T *input, size_t input_count, size_t stride, int shift, int16_t *output) {
+        size_t out_count = 0;
+
+        if (input_count > 0 && _has_pending) {
+            push_pair(_pending, static_cast<int16_t>(input[0] >> shift), output);
+            _has_pending = false;
+            input += stride;
+            input_count--;
+            out_count++;
+            output++;
+        }
+
+        while (input_count >= 2) {
+            size_t pairs = input_count / 2;
+            if (pairs > chunk_size) {
+                pairs = chunk_size;
+            }
+
+            // de-interleave into the two phases, no branches per sample
+            int16_t *phase = _phase + (phase_taps - 1);
+            int16_t *delay = _delay + delay_length;
+            const size_t pair_stride = stride * 2;
+            for (size_t ix = 0; ix < pairs; ix++) {
+                delay[ix] = static_cast<int16_t>(input[0] >> shift);
+                phase[ix] = static_cast<int16_t>(input[stride] >> shift);
+                input += pair_stride;
+            }
+
+            filter(pairs, output);
+
+            // keep the history for the next chunk
+            memmove(_phase, _phase + pairs, (phase_taps - 1) * sizeof(int16_t));
+            memmove(_delay, _delay + pairs, delay_length * sizeof(int16_t));
+
+            input_count -= pairs * 2;
+            out_count += pairs;
+            output += pairs;
+        }
+
+        if (input_count == 1) {
+            _pending = static_cast<int16_t>(input[0] >> shift);
+            _has_pending = true;
+        }
+
+        return out_count;
+    }
+
+private:
+    /* Number of taps of the FIR phase (the non-zero even coefficients) */
+    static const size_t phase_taps = 24;
+    /* Delay of the other phase, in output samples (the center tap) */
+    static const size_t delay_length = (phase_taps / 2) - 1;
+    /* Number of output samples per pass over the phase buffers */
+    static const size_t chunk_size = 32;
+
+    /**
+     * Filter one pair of input samples that was split over two calls
+     */
+    void push_pair(int16_t even, int16_t odd, int16_t *output) {
+        _delay[delay_length] = even;
+        _phase[phase_taps - 1] = odd;
+
+        filter(1, output);
+
+        memmove(_phase, _phase + 1, (phase_taps - 1) * sizeof(int16_t));
+        memmove(_delay, _delay + 1, delay_length * sizeof(int16_t));
+    }
+
+    /**
+     * Calculate `count` output samples from the phase buffers, which hold the
+     * history followed by `count` new samples
+     */
+    void filter(size_t count, int16_t *output) {
+        for (size_t n = 0; n < count; n++) {
+            const int16_t *x = _phase + n;
+
+            // center tap is 0.5
+            int32_t acc = static_cast<int32_t>(_delay[n]) << 14;
+
+#if EIDSP_USE_CMSIS_DSP && defined(ARM_MATH_DSP)
+            for (size_t k = 0; k < phase_taps; k += 4) {
+                acc = static_cast<int32_t>(__SMLAD(read_q15x2((q15_t*)&x[k]), read_q15x2((q15_t*)&coefficients()[k]), acc));
+                acc = static_cast<int32_t>(__SMLAD(read_q15x2((q15_t*)&x[k + 2]), read_q15x2((q15_t*)&coefficients()[k + 2]), acc));
+            }
+#else
+            const int16_t *h = coefficients();
+            for (size_t k = 0; k < phase_taps; k += 4) {
+                acc += static_cast<int32_t>(x[k]) * h[k];
+                acc += static_cast<int32_t>(x[k + 1]) * h[k + 1];
+                acc += static_cast<int32_t>(x[k + 2]) * h[k + 2];
+                acc += static_cast<int32_t>(x[k + 3]) * h[k + 3];
+            }
+#endif
+
+            acc = (acc + (1 << 14)) >> 15;
+            if (acc > INT16_MAX) {
+                acc = INT16_MAX;
+            }
+            else if (acc < INT16_MIN) {
+                acc = INT16_MIN;
+            }
+            output[n] = static_cast<int16_t>(acc);
+        }
+    }
+
+    /**
+     * The non-zero even coefficients of the half-band filter (Q15, Kaiser window,
+     * beta 5), symmetric so they're the same in either order. Together with the
+     * center tap of 0.5 they add up to 1 (unity gain at DC).
+     */
+    static const int16_t *coefficients() {
+        static const int16_t h[phase_taps] = {
+            -17, 43, -85, 149, -241, 371, -553, 813, -1206, 1875, -3347, 10390,
+            10390, -3347, 1875, -1206, 813, -553, 371, -241, 149, -85, 43, -17
+        };
+        return h;
+    }
+
+    /* FIR phase (odd input samples): history followed by the samples of the current chunk */
+    int16_t _phase[phase_taps - 1 + chunk_size];
+    /* Delayed phase (even input samples): history followed by the samples of the current chunk */
+    int16_t _delay[delay_length + chunk_size];
+    /* Even sample of a pair that was split over two calls */
+    int16_t _pending;
+    bool _has_pending;
+};
+
+} // namespace ei
+
+#endif // _EIDSP_DECIMATOR_H_
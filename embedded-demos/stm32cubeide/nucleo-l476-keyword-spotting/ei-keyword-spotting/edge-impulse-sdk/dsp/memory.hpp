@@ -23,7 +23,11 @@
 #ifndef _EIDSP_MEMORY_H_
 #define _EIDSP_MEMORY_H_
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/config.hpp"
 
 extern size_t ei_memory_in_use;
 extern size_t ei_memory_peak_use;
@@ -102,16 +106,211 @@ namespace ei {
     #define ei_dsp_register_matrix_alloc(...) (void)0
     #define ei_dsp_register_free(...) (void)0
     #define ei_dsp_register_matrix_free(...) (void)0
-    #define ei_dsp_malloc malloc
-    #define ei_dsp_calloc calloc
+    #define ei_dsp_malloc(size) ei::scratch_arena::allocate(size, false)
+    #define ei_dsp_calloc(num, size) ei::scratch_arena::allocate((num) * (size), true)
     #define ei_dsp_realloc realloc
-    #define ei_dsp_free(ptr, size) free(ptr)
+    #define ei_dsp_free(ptr, size) ei::scratch_arena::release(ptr, size)
     #define EI_DSP_MATRIX(name, ...) matrix_t name(__VA_ARGS__); if (!name.buffer) { EIDSP_ERR(EIDSP_OUT_OF_MEM); }
     #define EI_DSP_MATRIX_B(name, ...) matrix_t name(__VA_ARGS__); if (!name.buffer) { EIDSP_ERR(EIDSP_OUT_OF_MEM); }
     #define EI_DSP_QUANTIZED_MATRIX(name, ...) quantized_matrix_t name(__VA_ARGS__); if (!name.buffer) { EIDSP_ERR(EIDSP_OUT_OF_MEM); }
     #define EI_DSP_QUANTIZED_MATRIX_B(name, ...) quantized_matrix_t name(__VA_ARGS__); if (!name.buffer) { EIDSP_ERR(EIDSP_OUT_OF_MEM); }
 #endif
 
+/**
+ * Scratch arena for DSP temporaries (enable through EIDSP_USE_SCRATCH_ARENA).
+ * While a scratch_arena::scope is alive, ei_dsp_malloc / ei_dsp_calloc and matrices are
+ * served from one block by bumping a pointer. Freeing the most recent allocation pops it,
+ * everything else is released at once when the scope ends. Allocations made outside of a
+ * scope, inside a scratch_arena::bypass, or that don't fit in the block go to the heap.
+ * The block is allocated once by reserve(). Not thread-safe, like the DSP caches, unless
+ * EIDSP_THREAD_SAFE is set: then every thread has its own arena.
+ * ei_dsp_realloc always works on the heap, don't use it on scratch memory.
+ */
+class scratch_arena {
+private:
+    static const size_t header_size = 8;
+
+    typedef struct {
+        uint8_t *buffer;
+        size_t capacity;
+        size_t used;
+        size_t peak;
+        int depth;
+    } state_t;
+
+    static state_t *state() {
+        static EIDSP_THREAD_LOCAL state_t s = { NULL, 0, 0, 0, 0 };
+        return &s;
+    }
+
+public:
+    /**
+     * Serve allocations from the arena while this is alive, release them when it goes out of scope.
+     * Scopes can be nested.
+     */
+    class scope {
+    public:
+        scope() {
+#if EIDSP_USE_SCRATCH_ARENA
+            state_t *s = state();
+            _mark = s->used;
+            s->depth++;
+#endif
+        }
+
+        ~scope() {
+#if EIDSP_USE_SCRATCH_ARENA
+            state_t *s = state();
+            s->used = _mark;
+            s->depth--;
+#endif
+        }
+
+    private:
+        size_t _mark;
+    };
+
+    /**
+     * Allocate from the heap while this is alive, for buffers that outlive the current
+     * scope (f.e. cached filterbanks and FFT plans, streaming state)
+     */
+    class bypass {
+    public:
+        bypass() {
+#if EIDSP_USE_SCRATCH_ARENA
+            _depth = state()->depth;
+            state()->depth = 0;
+#endif
+        }
+
+        ~bypass() {
+#if EIDSP_USE_SCRATCH_ARENA
+            state()->depth = _depth;
+#endif
+        }
+
+    private:
+        int _depth;
+    };
+
+    /**
+     * Number of bytes an allocation takes in the arena (8 byte aligned, plus a header with the size)
+     */
+    static size_t size_of(size_t bytes) {
+        return header_size + ((bytes + 7) & ~static_cast<size_t>(7));
+    }
+
+    /**
+     * Make sure the arena holds at least `bytes`. Only grows the block
+     * when nothing is allocated from it.
+     * @returns true if the arena is big enough
+     */
+    static bool reserve(size_t bytes) {
+#if EIDSP_USE_SCRATCH_ARENA
+        state_t *s = state();
+        if (s->capacity >= bytes) {
+            return true;
+        }
+        if (s->depth > 0 || s->used > 0) {
+            return false;
+        }
+
+        free(s->buffer);
+        s->capacity = (bytes + 7) & ~static_cast<size_t>(7);
+        s->buffer = (uint8_t*)malloc(s->capacity);
+        if (!s->buffer) {
+            s->capacity = 0;
+            return false;
+        }
+        return true;
+#else
+        (void)bytes;
+        return false;
+#endif
+    }
+
+    /**
+     * Free the block, f.e. to get the RAM back between inferences (only outside of a scope)
+     */
+    static void clear() {
+#if EIDSP_USE_SCRATCH_ARENA
+        state_t *s = state();
+        if (s->depth > 0 || s->used > 0) {
+            return;
+        }
+        free(s->buffer);
+        s->buffer = NULL;
+        s->capacity = 0;
+        s->peak = 0;
+#endif
+    }
+
+    /**
+     * Highest number of bytes that was in use in the arena
+     * (also counted in ei_memory_peak_use with EIDSP_TRACK_ALLOCATIONS)
+     */
+    static size_t peak_use() {
+        return state()->peak;
+    }
+
+    /**
+     * Allocate a block of memory, from the arena if a scope is alive and it fits
+     * @param bytes Size of the block
+     * @param zero Initialize the block to zero
+     */
+    static void *allocate(size_t bytes, bool zero) {
+#if EIDSP_USE_SCRATCH_ARENA
+        state_t *s = state();
+        size_t size = size_of(bytes);
+        if (s->depth > 0 && s->buffer && size <= s->capacity - s->used) {
+            uint8_t *block = s->buffer + s->used;
+            *(size_t*)block = size;
+            void *ptr = block + header_size;
+            s->used += size;
+            if (s->used > s->peak) {
+                s->peak = s->used;
+#if EIDSP_TRACK_ALLOCATIONS
+                // the arena peak includes the block headers and alignment
+                if (s->peak > ei_memory_peak_use) {
+                    ei_memory_peak_use = s->peak;
+                }
+#endif
+            }
+            if (zero) {
+                memset(ptr, 0, bytes);
+            }
+            return ptr;
+        }
+#endif
+        return zero ? calloc(bytes, 1) : malloc(bytes);
+    }
+
+    /**
+     * Free a block of memory returned by allocate()
+     * @param ptr The block
+     * @param bytes Size of the block (arena blocks keep track of their own size)
+     */
+    static void release(void *ptr, size_t bytes) {
+        if (!ptr) {
+            return;
+        }
+#if EIDSP_USE_SCRATCH_ARENA
+        state_t *s = state();
+        uint8_t *p = (uint8_t*)ptr;
+        if (s->buffer && p > s->buffer && p < s->buffer + s->capacity) {
+            // only the most recent allocation can be popped, the rest goes with the scope
+            uint8_t *block = p - header_size;
+            if (block + *(size_t*)block == s->buffer + s->used) {
+                s->used = block - s->buffer;
+            }
+            return;
+        }
+#endif
+        (void)bytes;
+        free(ptr);
+    }
+};
+
 #if EIDSP_TRACK_ALLOCATIONS
 class memory {
 
@@ -122,7 +321,7 @@ public:
      * @param size The size of the memory block, in bytes.
      */
     static void *ei_malloc(const char *fn, const char *file, int line, size_t size) {
-        void *ptr = malloc(size);
+        void *ptr = scratch_arena::allocate(size, false);
         if (ptr) {
             ei_dsp_register_alloc_internal(fn, file, line, size);
         }
@@ -136,7 +335,7 @@ public:
      * @param size Size of each element
      */
     static void *ei_calloc(const char *fn, const char *file, int line, size_t num, size_t size) {
-        void *ptr = calloc(num, size);
+        void *ptr = scratch_arena::allocate(num * size, true);
         if (ptr) {
             ei_dsp_register_alloc_internal(fn, file, line, num * size);
         }
@@ -149,7 +348,7 @@ public:
      * @param size Size of the block of memory previously allocated.
      */
     static void ei_free(const char *fn, const char *file, int line, void *ptr, size_t size) {
-        free(ptr);
+        scratch_arena::release(ptr, size);
         ei_dsp_register_free_internal(fn, file, line, size);
     }
 
@@ -51,6 +51,50 @@ namespace ei {
 // lookup table for quantized values between 0.0f and 1.0f
 static const float quantized_values_one_zero[] = { (0.0f / 1.0f), (1.0f / 100.0f), (2.0f / 100.0f), (3.0f / 100.0f), (4.0f / 100.0f), (1.0f / 22.0f), (1.0f / 21.0f), (1.0f / 20.0f), (1.0f / 19.0f), (1.0f / 18.0f), (1.0f / 17.0f), (6.0f / 100.0f), (1.0f / 16.0f), (1.0f / 15.0f), (7.0f / 100.0f), (1.0f / 14.0f), (1.0f / 13.0f), (8.0f / 100.0f), (1.0f / 12.0f), (9.0f / 100.0f), (1.0f / 11.0f), (2.0f / 21.0f), (1.0f / 10.0f), (2.0f / 19.0f), (11.0f / 100.0f), (1.0f / 9.0f), (2.0f / 17.0f), (12.0f / 100.0f), (1.0f / 8.0f), (13.0f / 100.0f), (2.0f / 15.0f), (3.0f / 22.0f), (14.0f / 100.0f), (1.0f / 7.0f), (3.0f / 20.0f), (2.0f / 13.0f), (3.0f / 19.0f), (16.0f / 100.0f), (1.0f / 6.0f), (17.0f / 100.0f), (3.0f / 17.0f), (18.0f / 100.0f), (2.0f / 11.0f), (3.0f / 16.0f), (19.0f / 100.0f), (4.0f / 21.0f), (1.0f / 5.0f), (21.0f / 100.0f), (4.0f / 19.0f), (3.0f / 14.0f), (22.0f / 100.0f), (2.0f / 9.0f), (5.0f / 22.0f), (23.0f / 100.0f), (3.0f / 13.0f), (4.0f / 17.0f), (5.0f / 21.0f), (24.0f / 100.0f), (1.0f / 4.0f), (26.0f / 100.0f), (5.0f / 19.0f), (4.0f / 15.0f), (27.0f / 100.0f), (3.0f / 11.0f), (5.0f / 18.0f), (28.0f / 100.0f), (2.0f / 7.0f), (29.0f / 100.0f), (5.0f / 17.0f), (3.0f / 10.0f), (4.0f / 13.0f), (31.0f / 100.0f), (5.0f / 16.0f), (6.0f / 19.0f), (7.0f / 22.0f), (32.0f / 100.0f), (33.0f / 100.0f), (1.0f / 3.0f), (34.0f / 100.0f), (7.0f / 20.0f), (6.0f / 17.0f), (5.0f / 14.0f), (36.0f / 100.0f), (4.0f / 11.0f), (7.0f / 19.0f), (37.0f / 100.0f), (3.0f / 8.0f), (38.0f / 100.0f), (8.0f / 21.0f), (5.0f / 13.0f), (7.0f / 18.0f), (39.0f / 100.0f), (2.0f / 5.0f), (9.0f / 22.0f), (41.0f / 100.0f), (7.0f / 17.0f), (5.0f / 12.0f), (42.0f / 100.0f), (8.0f / 19.0f), (3.0f / 7.0f), (43.0f / 100.0f), (7.0f / 16.0f), (44.0f / 100.0f), (4.0f / 9.0f), (9.0f / 20.0f), (5.0f / 11.0f), (46.0f / 100.0f), (6.0f / 13.0f), (7.0f / 15.0f), (47.0f / 100.0f), (8.0f / 17.0f), (9.0f / 19.0f), (10.0f / 21.0f), (48.0f / 100.0f), (49.0f / 100.0f), (1.0f / 2.0f), (51.0f / 100.0f), (52.0f / 100.0f), (11.0f / 21.0f), (10.0f / 19.0f), (9.0f / 17.0f), (53.0f / 100.0f), (8.0f / 15.0f), (7.0f / 13.0f), (54.0f / 100.0f), (6.0f / 11.0f), (11.0f / 20.0f), (5.0f / 9.0f), (56.0f / 100.0f), (9.0f / 16.0f), (57.0f / 100.0f), (4.0f / 7.0f), (11.0f / 19.0f), (58.0f / 100.0f), (7.0f / 12.0f), (10.0f / 17.0f), (59.0f / 100.0f), (13.0f / 22.0f), (3.0f / 5.0f), (61.0f / 100.0f), (11.0f / 18.0f), (8.0f / 13.0f), (13.0f / 21.0f), (62.0f / 100.0f), (5.0f / 8.0f), (63.0f / 100.0f), (12.0f / 19.0f), (7.0f / 11.0f), (64.0f / 100.0f), (9.0f / 14.0f), (11.0f / 17.0f), (13.0f / 20.0f), (66.0f / 100.0f), (2.0f / 3.0f), (67.0f / 100.0f), (68.0f / 100.0f), (15.0f / 22.0f), (13.0f / 19.0f), (11.0f / 16.0f), (69.0f / 100.0f), (9.0f / 13.0f), (7.0f / 10.0f), (12.0f / 17.0f), (71.0f / 100.0f), (5.0f / 7.0f), (72.0f / 100.0f), (13.0f / 18.0f), (8.0f / 11.0f), (73.0f / 100.0f), (11.0f / 15.0f), (14.0f / 19.0f), (74.0f / 100.0f), (3.0f / 4.0f), (76.0f / 100.0f), (16.0f / 21.0f), (13.0f / 17.0f), (10.0f / 13.0f), (77.0f / 100.0f), (17.0f / 22.0f), (7.0f / 9.0f), (78.0f / 100.0f), (11.0f / 14.0f), (15.0f / 19.0f), (79.0f / 100.0f), (4.0f / 5.0f), (17.0f / 21.0f), (81.0f / 100.0f), (13.0f / 16.0f), (9.0f / 11.0f), (82.0f / 100.0f), (14.0f / 17.0f), (83.0f / 100.0f), (5.0f / 6.0f), (84.0f / 100.0f), (16.0f / 19.0f), (11.0f / 13.0f), (17.0f / 20.0f), (6.0f / 7.0f), (86.0f / 100.0f), (19.0f / 22.0f), (13.0f / 15.0f), (87.0f / 100.0f), (7.0f / 8.0f), (88.0f / 100.0f), (15.0f / 17.0f), (8.0f / 9.0f), (89.0f / 100.0f), (17.0f / 19.0f), (9.0f / 10.0f), (19.0f / 21.0f), (10.0f / 11.0f), (91.0f / 100.0f), (11.0f / 12.0f), (92.0f / 100.0f), (12.0f / 13.0f), (13.0f / 14.0f), (93.0f / 100.0f), (14.0f / 15.0f), (15.0f / 16.0f), (94.0f / 100.0f), (16.0f / 17.0f), (17.0f / 18.0f), (18.0f / 19.0f), (19.0f / 20.0f), (20.0f / 21.0f), (21.0f / 22.0f), (96.0f / 100.0f), (97.0f / 100.0f), (98.0f / 100.0f), (99.0f / 100.0f), (1.0f / 1.0f) };
 
+typedef enum {
+    FFT_PLAN_REAL = 0,
+    FFT_PLAN_COMPLEX = 1
+} fft_plan_type_t;
+
+/**
+ * Everything needed to run an FFT of a given size: the CMSIS-DSP instance or KissFFT
+ * configuration (twiddles and factorization), and scratch buffers, so no allocation or
+ * initialization has to happen per transform. Get one through numpy::fft_plan.
+ */
+typedef struct {
+    fft_plan_type_t type;
+    size_t n_fft;
+    bool inverse;
+
+    void *kiss_cfg;         // kiss_fftr_cfg (real) or kiss_fft_cfg (complex)
+    size_t kiss_cfg_size;
+#if EIDSP_USE_CMSIS_DSP
+    bool use_cmsis;         // n_fft is supported by arm_rfft_fast_f32
+    arm_rfft_fast_instance_f32 rfft_instance;
+#endif
+
+    float *input;           // real: n_fft floats, complex: n_fft fft_complex_t
+    float *output;          // real: n_fft + 2 floats, complex: n_fft fft_complex_t
+    size_t input_size;      // in bytes
+    size_t output_size;     // in bytes
+
+    fft_complex_t *spectrum;    // real only, (n_fft / 2 + 1) scratch for callers (f.e. the DCT)
+    float *twiddles;            // real only, cos / sin pairs for the DCT, (n_fft / 2 + 1) * 2 floats
+} fft_plan_t;
+
+/**
+ * The first coefficients of an orthonormal DCT-II as a matrix, for numpy::dct2_truncated.
+ * Stored transposed (one row of coefficients per input), so a frame is transformed
+ * by adding up scaled rows, which vectorizes without reordering the sums.
+ */
+typedef struct {
+    size_t n;                   // number of inputs
+    size_t num_coefficients;    // number of coefficients (the first ones)
+    size_t stride;              // floats per row, num_coefficients padded with zeros to a multiple of 8
+                                // (no padding with CMSIS-DSP, arm_mat_mult_f32 takes the basis as is)
+    float *basis;               // n x stride
+} dct_basis_t;
+
 class numpy {
 public:
     /**
@@ -416,6 +460,139 @@ public:
         return EIDSP_OK;
     }
 
+    /**
+     * Get the orthonormal DCT-II basis for the first `num_coefficients` coefficients of an
+     * `n` point DCT. Bases are built on first use and kept in a cache
+     * (EIDSP_DCT_BASIS_CACHE_SIZE entries), like the FFT plans. A basis stays valid until a
+     * basis for another size evicts it, or until clear_dct_bases() is called.
+     * With EIDSP_THREAD_SAFE every thread has its own cache.
+     * @param basis Out, pointer to the basis
+     * @param n Number of inputs
+     * @param num_coefficients Number of coefficients, at most n
+     * @returns EIDSP_OK if OK
+     */
+    static int dct2_basis(const dct_basis_t **basis, size_t n, size_t num_coefficients) {
+        dct_basis_cache_t *cache = dct_basis_cache();
+
+        for (size_t ix = 0; ix < EIDSP_DCT_BASIS_CACHE_SIZE; ix++) {
+            dct_basis_t *entry = &cache->bases[ix];
+            if (entry->basis && entry->n == n && entry->num_coefficients == num_coefficients) {
+                *basis = entry;
+                return EIDSP_OK;
+            }
+        }
+
+        if (n == 0 || num_coefficients == 0 || num_coefficients > n) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        // cached, so it outlives the current scratch scope
+        scratch_arena::bypass bypass;
+
+        dct_basis_t *entry = &cache->bases[cache->next];
+        free_dct_basis(entry);
+
+#if EIDSP_USE_CMSIS_DSP
+        const size_t stride = num_coefficients;
+#else
+        const size_t stride = (num_coefficients + 7) & ~static_cast<size_t>(7);
+#endif
+
+        entry->basis = (float*)ei_dsp_calloc(n * stride * sizeof(float), 1);
+        if (!entry->basis) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+        entry->n = n;
+        entry->num_coefficients = num_coefficients;
+        entry->stride = stride;
+
+        const double size = static_cast<double>(n);
+        for (size_t k = 0; k < num_coefficients; k++) {
+            double scale = k == 0 ? sqrt(1.0 / size) : sqrt(2.0 / size);
+            for (size_t ix = 0; ix < n; ix++) {
+                entry->basis[ix * stride + k] = static_cast<float>(
+                    scale * cos(M_PI * static_cast<double>(k) * (2.0 * ix + 1.0) / (2.0 * size)));
+            }
+        }
+
+        cache->next = (cache->next + 1) % EIDSP_DCT_BASIS_CACHE_SIZE;
+
+        *basis = entry;
+        return EIDSP_OK;
+    }
+
+    /**
+     * Free all cached DCT bases
+     */
+    static void clear_dct_bases() {
+        dct_basis_cache_t *cache = dct_basis_cache();
+
+        for (size_t ix = 0; ix < EIDSP_DCT_BASIS_CACHE_SIZE; ix++) {
+            free_dct_basis(&cache->bases[ix]);
+        }
+        cache->next = 0;
+    }
+
+    /**
+     * The first `output->cols` coefficients of the orthonormal DCT-II of every row of
+     * a matrix, the same as dct2 with DCT_NORMALIZATION_ORTHO followed by dropping the
+     * other columns. Only the coefficients that are kept are calculated, as one
+     * matrix product over all rows against the cached basis (see dct2_basis).
+     * @param input Input matrix, one transform per row
+     * @param output Output matrix, same number of rows, may not overlap input
+     * @returns EIDSP_OK if OK
+     */
+    static int dct2_truncated(const matrix_t *input, matrix_t *output) {
+        if (input->rows != output->rows) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+        if (input->rows == 0) {
+            return EIDSP_OK;
+        }
+
+        const dct_basis_t *basis;
+        int ret = dct2_basis(&basis, input->cols, output->cols);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+#if EIDSP_USE_CMSIS_DSP
+        arm_matrix_instance_f32 input_instance = { static_cast<uint16_t>(input->rows),
+            static_cast<uint16_t>(input->cols), input->buffer };
+        arm_matrix_instance_f32 basis_instance = { static_cast<uint16_t>(basis->n),
+            static_cast<uint16_t>(basis->num_coefficients), basis->basis };
+        arm_matrix_instance_f32 output_instance = { static_cast<uint16_t>(output->rows),
+            static_cast<uint16_t>(output->cols), output->buffer };
+
+        arm_status status = arm_mat_mult_f32(&input_instance, &basis_instance, &output_instance);
+        if (status != ARM_MATH_SUCCESS) {
+            EIDSP_ERR(status);
+        }
+#else
+        for (size_t row = 0; row < input->rows; row++) {
+            dct2_truncated_row(basis, input->buffer + (row * input->cols), output->buffer + (row * output->cols));
+        }
+#endif
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * The first `num_coefficients` coefficients of the orthonormal DCT-II of `input`,
+     * see the matrix version
+     * @param input `n` inputs
+     * @param n Number of inputs
+     * @param output Out buffer, num_coefficients elements, may not overlap input
+     * @param num_coefficients Number of coefficients, at most n
+     * @returns EIDSP_OK if OK
+     */
+    static int dct2_truncated(const float *input, size_t n, float *output, size_t num_coefficients) {
+        const matrix_t input_matrix(1, n, const_cast<float*>(input));
+        matrix_t output_matrix(1, num_coefficients, output);
+
+        return dct2_truncated(&input_matrix, &output_matrix);
+    }
+
     /**
      * Quantize a float value between zero and one
      * @param value Float value
@@ -477,6 +654,23 @@ public:
      * @returns 0 if OK
      */
     static int pad_1d_symmetric(matrix_t *input, matrix_t *output, uint16_t pad_before, uint16_t pad_after) {
+        return pad_1d_symmetric(input, output, pad_before, pad_after, 0);
+    }
+
+    /**
+     * Pad an array that is stored as a circular buffer of rows.
+     * Pads with the reflection of the vector mirrored along the edge of the array.
+     * @param input Input matrix (MxN), the logical first row is at `first_row`,
+     *              rows wrap around to the start of the buffer
+     * @param output Output matrix of size (M+pad_before+pad_after x N)
+     * @param pad_before Number of items to pad before
+     * @param pad_after Number of items to pad after
+     * @param first_row Row in the input buffer that holds the first (oldest) row
+     * @returns 0 if OK
+     */
+    static int pad_1d_symmetric(matrix_t *input, matrix_t *output, uint16_t pad_before, uint16_t pad_after,
+        uint32_t first_row)
+    {
         if (output->cols != input->cols) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
@@ -489,13 +683,19 @@ public:
             EIDSP_ERR(EIDSP_INPUT_MATRIX_EMPTY);
         }
 
+        if (first_row >= input->rows) {
+            EIDSP_ERR(EIDSP_OUT_OF_BOUNDS);
+        }
+
+        const size_t row_size = input->cols * sizeof(float);
+
         uint32_t pad_before_index = 0;
         bool pad_before_direction_up = true;
 
         for (int32_t ix = pad_before - 1; ix >= 0; ix--) {
             memcpy(output->buffer + (input->cols * ix),
-                input->buffer + (pad_before_index * input->cols),
-                input->cols * sizeof(float));
+                ring_row(input, first_row, pad_before_index),
+                row_size);
 
             if (pad_before_index == 0 && !pad_before_direction_up) {
                 pad_before_direction_up = true;
@@ -511,17 +711,24 @@ public:
             }
         }
 
+        // copy the input in (at most) two blocks, up to the end of the buffer and the wrapped part
+        uint32_t rows_to_end = input->rows - first_row;
         memcpy(output->buffer + (input->cols * pad_before),
-            input->buffer,
-            input->rows * input->cols * sizeof(float));
+            input->buffer + (first_row * input->cols),
+            rows_to_end * row_size);
+        if (first_row > 0) {
+            memcpy(output->buffer + (input->cols * (pad_before + rows_to_end)),
+                input->buffer,
+                first_row * row_size);
+        }
 
         int32_t pad_after_index = input->rows - 1;
         bool pad_after_direction_up = false;
 
         for (int32_t ix = 0; ix < pad_after; ix++) {
             memcpy(output->buffer + (input->cols * (ix + pad_before + input->rows)),
-                input->buffer + (pad_after_index * input->cols),
-                input->cols * sizeof(float));
+                ring_row(input, first_row, pad_after_index),
+                row_size);
 
             if (pad_after_index == 0 && !pad_after_direction_up) {
                 pad_after_direction_up = true;
@@ -1094,64 +1301,116 @@ public:
             EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
         }
 
-        // truncate if needed
-        if (src_size > n_fft) {
-            src_size = n_fft;
-        }
-
-        // declare input and output arrays
-        EI_DSP_MATRIX(fft_input, 1, n_fft);
-        if (!fft_input.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        fft_plan_t *plan;
+        int ret = fft_plan(&plan, FFT_PLAN_REAL, n_fft);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
         }
 
-        // copy from src to fft_input
-        memcpy(fft_input.buffer, src, src_size * sizeof(float));
-        // pad to the rigth with zeros
-        memset(fft_input.buffer + src_size, 0, (n_fft - src_size) * sizeof(kiss_fft_scalar));
+        rfft_load_input(plan, src, src_size);
 
 #if EIDSP_USE_CMSIS_DSP
-        if (n_fft != 32 && n_fft != 64 && n_fft != 128 && n_fft != 256 &&
-            n_fft != 512 && n_fft != 1024 && n_fft != 2048 && n_fft != 4096) {
-            int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
-            if (ret != EIDSP_OK) {
-                EIDSP_ERR(ret);
-            }
+        if (!plan->use_cmsis) {
+            software_rfft(plan, output, n_fft_out_features);
         }
         else {
-            // hardware acceleration only works for the powers above...
-            arm_rfft_fast_instance_f32 rfft_instance;
-            arm_status status = arm_rfft_fast_init_f32(&rfft_instance, n_fft);
-            if (status != ARM_MATH_SUCCESS) {
-                return status;
-            }
-
-            EI_DSP_MATRIX(fft_output, 1, n_fft);
-            if (!fft_output.buffer) {
-                EIDSP_ERR(EIDSP_OUT_OF_MEM);
-            }
-
-            arm_rfft_fast_f32(&rfft_instance, fft_input.buffer, fft_output.buffer, 0);
+            // hardware acceleration only works for powers of 2 between 32 and 4096
+            arm_rfft_fast_f32(&plan->rfft_instance, plan->input, plan->output, 0);
 
-            output[0] = fft_output.buffer[0];
-            output[n_fft_out_features - 1] = fft_output.buffer[1];
+            output[0] = plan->output[0];
+            output[n_fft_out_features - 1] = plan->output[1];
 
             size_t fft_output_buffer_ix = 2;
             for (size_t ix = 1; ix < n_fft_out_features - 1; ix += 1) {
                 float rms_result;
-                arm_rms_f32(fft_output.buffer + fft_output_buffer_ix, 2, &rms_result);
+                arm_rms_f32(plan->output + fft_output_buffer_ix, 2, &rms_result);
                 output[ix] = rms_result * sqrt(2);
 
                 fft_output_buffer_ix += 2;
             }
         }
 #else
-        int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
+        software_rfft(plan, output, n_fft_out_features);
+#endif
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Power spectrum of real input, |X[k]|^2 / n_fft for the n_fft / 2 + 1 bins of the rfft.
+     * Goes from the complex FFT output to the scaled squared magnitude in one pass, without
+     * the square root of rfft (and squaring it again), and optionally sums the bins on the
+     * way (the frame energy of the MFCC / MFE blocks, the same as numpy::sum over the output).
+     * @param src Source buffer
+     * @param src_size Size of the source buffer, zero padded or truncated to n_fft
+     * @param output Output buffer
+     * @param output_size Size of the output buffer, should be n_fft / 2 + 1
+     * @param n_fft Number of FFT points
+     * @param energy If not NULL, receives the sum of the output
+     * @returns 0 if OK
+     */
+    static int power_spectrum(const float *src, size_t src_size, float *output, size_t output_size,
+        size_t n_fft, float *energy = NULL)
+    {
+        size_t n_fft_out_features = (n_fft / 2) + 1;
+        if (output_size != n_fft_out_features) {
+            EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
+        }
+
+        fft_plan_t *plan;
+        int ret = fft_plan(&plan, FFT_PLAN_REAL, n_fft);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
+
+        rfft_load_input(plan, src, src_size);
+
+        const float scale = 1.0f / static_cast<float>(n_fft);
+
+#if EIDSP_USE_CMSIS_DSP
+        if (plan->use_cmsis) {
+            // hardware acceleration only works for powers of 2 between 32 and 4096
+            arm_rfft_fast_f32(&plan->rfft_instance, plan->input, plan->output, 0);
+
+            // packed output: DC and Nyquist (both real) first, then the other bins
+            arm_cmplx_mag_squared_f32(plan->output + 2, output + 1, n_fft_out_features - 2);
+            output[n_fft_out_features - 1] = plan->output[1] * plan->output[1];
+            output[0] = plan->output[0] * plan->output[0];
+
+            if (energy) {
+                float sum = 0.0f;
+                for (size_t ix = 0; ix < n_fft_out_features; ix++) {
+                    output[ix] *= scale;
+                    sum += output[ix];
+                }
+                *energy = sum;
+            }
+            else {
+                arm_scale_f32(output, scale, output, n_fft_out_features);
+            }
+
+            return EIDSP_OK;
+        }
 #endif
 
+        const kiss_fft_cpx *fft_output = (const kiss_fft_cpx*)plan->output;
+        kiss_fftr((kiss_fftr_cfg)plan->kiss_cfg, plan->input, (kiss_fft_cpx*)plan->output);
+
+        if (energy) {
+            float sum = 0.0f;
+            for (size_t ix = 0; ix < n_fft_out_features; ix++) {
+                float bin = ((fft_output[ix].r * fft_output[ix].r) + (fft_output[ix].i * fft_output[ix].i)) * scale;
+                output[ix] = bin;
+                sum += bin;
+            }
+            *energy = sum;
+        }
+        else {
+            for (size_t ix = 0; ix < n_fft_out_features; ix++) {
+                output[ix] = ((fft_output[ix].r * fft_output[ix].r) + (fft_output[ix].i * fft_output[ix].i)) * scale;
+            }
+        }
+
         return EIDSP_OK;
     }
 
@@ -1171,75 +1430,94 @@ public:
             EIDSP_ERR(EIDSP_BUFFER_SIZE_MISMATCH);
         }
 
-        // truncate if needed
-        if (src_size > n_fft) {
-            src_size = n_fft;
-        }
-
-        // declare input and output arrays
-        float *fft_input_buffer = NULL;
-        if (src_size == n_fft) {
-            fft_input_buffer = (float*)src;
-        }
-
-        EI_DSP_MATRIX_B(fft_input, 1, n_fft, fft_input_buffer);
-        if (!fft_input.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        fft_plan_t *plan;
+        int ret = fft_plan(&plan, FFT_PLAN_REAL, n_fft);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
         }
 
-        if (!fft_input_buffer) {
-            // copy from src to fft_input
-            memcpy(fft_input.buffer, src, src_size * sizeof(float));
-            // pad to the rigth with zeros
-            memset(fft_input.buffer + src_size, 0, (n_fft - src_size) * sizeof(float));
-        }
+        rfft_load_input(plan, src, src_size);
 
 #if EIDSP_USE_CMSIS_DSP
-        if (n_fft != 32 && n_fft != 64 && n_fft != 128 && n_fft != 256 &&
-            n_fft != 512 && n_fft != 1024 && n_fft != 2048 && n_fft != 4096) {
-            int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
-            if (ret != EIDSP_OK) {
-                EIDSP_ERR(ret);
-            }
+        if (!plan->use_cmsis) {
+            kiss_fftr((kiss_fftr_cfg)plan->kiss_cfg, plan->input, (kiss_fft_cpx*)output);
         }
         else {
-            // hardware acceleration only works for the powers above...
-            arm_rfft_fast_instance_f32 rfft_instance;
-            arm_status status = arm_rfft_fast_init_f32(&rfft_instance, n_fft);
-            if (status != ARM_MATH_SUCCESS) {
-                return status;
-            }
-
-            EI_DSP_MATRIX(fft_output, 1, n_fft);
-            if (!fft_output.buffer) {
-                EIDSP_ERR(EIDSP_OUT_OF_MEM);
-            }
+            // hardware acceleration only works for powers of 2 between 32 and 4096
+            arm_rfft_fast_f32(&plan->rfft_instance, plan->input, plan->output, 0);
 
-            arm_rfft_fast_f32(&rfft_instance, fft_input.buffer, fft_output.buffer, 0);
-
-            output[0].r = fft_output.buffer[0];
+            output[0].r = plan->output[0];
             output[0].i = 0.0f;
-            output[n_fft_out_features - 1].r = fft_output.buffer[1];
+            output[n_fft_out_features - 1].r = plan->output[1];
             output[n_fft_out_features - 1].i = 0.0f;
 
             size_t fft_output_buffer_ix = 2;
             for (size_t ix = 1; ix < n_fft_out_features - 1; ix += 1) {
-                output[ix].r = fft_output.buffer[fft_output_buffer_ix];
-                output[ix].i = fft_output.buffer[fft_output_buffer_ix + 1];
+                output[ix].r = plan->output[fft_output_buffer_ix];
+                output[ix].i = plan->output[fft_output_buffer_ix + 1];
 
                 fft_output_buffer_ix += 2;
             }
         }
 #else
-        int ret = software_rfft(fft_input.buffer, output, n_fft, n_fft_out_features);
+        kiss_fftr((kiss_fftr_cfg)plan->kiss_cfg, plan->input, (kiss_fft_cpx*)output);
+#endif
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Get the FFT plan for a transform size. Plans are created on first use and kept
+     * in a registry (EIDSP_FFT_PLAN_CACHE_SIZE entries), so rfft, power_spectrum and the
+     * DCT don't allocate or initialize anything per transform once the plan exists.
+     * A plan stays valid until a plan for another size evicts it, or until
+     * clear_fft_plans() is called. With EIDSP_THREAD_SAFE every thread has its own registry.
+     * @param plan Out, pointer to the plan
+     * @param type FFT_PLAN_REAL (rfft) or FFT_PLAN_COMPLEX
+     * @param n_fft Number of points
+     * @param inverse Inverse transform (complex only)
+     * @returns EIDSP_OK if OK
+     */
+    static int fft_plan(fft_plan_t **plan, fft_plan_type_t type, size_t n_fft, bool inverse = false) {
+        fft_plan_registry_t *registry = fft_plan_registry();
+
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            fft_plan_t *entry = &registry->plans[ix];
+            if (entry->input && entry->type == type && entry->n_fft == n_fft && entry->inverse == inverse) {
+                *plan = entry;
+                return EIDSP_OK;
+            }
+        }
+
+        // cached, so it outlives the current scratch scope
+        scratch_arena::bypass bypass;
+
+        fft_plan_t *entry = &registry->plans[registry->next];
+        free_fft_plan(entry);
+
+        int ret = create_fft_plan(entry, type, n_fft, inverse);
         if (ret != EIDSP_OK) {
             EIDSP_ERR(ret);
         }
-#endif
 
+        registry->next = (registry->next + 1) % EIDSP_FFT_PLAN_CACHE_SIZE;
+
+        *plan = entry;
         return EIDSP_OK;
     }
 
+    /**
+     * Free all FFT plans
+     */
+    static void clear_fft_plans() {
+        fft_plan_registry_t *registry = fft_plan_registry();
+
+        for (size_t ix = 0; ix < EIDSP_FFT_PLAN_CACHE_SIZE; ix++) {
+            free_fft_plan(&registry->plans[ix]);
+        }
+        registry->next = 0;
+    }
+
     /**
      * Return evenly spaced numbers over a specified interval.
      * Returns num evenly spaced samples, calculated over the interval [start, stop].
@@ -1334,6 +1612,31 @@ public:
         signal->get_data = [data](size_t offset, size_t length, float *out_ptr) {
             return numpy::signal_get_data(data, offset, length, out_ptr);
         };
+#endif
+        return EIDSP_OK;
+    }
+
+    /**
+     * Create a signal structure from an int16 buffer (f.e. audio samples), that
+     * reads as float in -1..1 through get_data and as is through get_data_int16.
+     * @param data Buffer, make sure to keep this pointer alive
+     * @param data_size Size of the buffer
+     * @param signal Output signal
+     * @returns EIDSP_OK if ok
+     */
+    static int signal_from_int16_buffer(const int16_t *data, size_t data_size, signal_t *signal)
+    {
+        signal->total_length = data_size;
+#ifdef __MBED__
+        signal->get_data = mbed::callback(&numpy::signal_get_data_int16, data);
+        signal->get_data_int16 = mbed::callback(&numpy::signal_get_data_int16_raw, data);
+#else
+        signal->get_data = [data](size_t offset, size_t length, float *out_ptr) {
+            return numpy::signal_get_data_int16(data, offset, length, out_ptr);
+        };
+        signal->get_data_int16 = [data](size_t offset, size_t length, int16_t *out_ptr) {
+            return numpy::signal_get_data_int16_raw(data, offset, length, out_ptr);
+        };
 #endif
         return EIDSP_OK;
     }
@@ -1341,9 +1644,13 @@ public:
 
     /**
      * > 50% faster then the math.h log() function
-     * in return for a small loss in accuracy (0.00001 average diff with log())
+     * in return for a small loss in accuracy (max abs. diff with log() 2.3e-5 over all
+     * positive normal floats, 6.9e-6 on average)
      * From: https://stackoverflow.com/questions/39821367/very-fast-approximate-logarithm-natural-log-function-in-c/39822314#39822314
      * Licensed under the CC BY-SA 3.0
+     * Plain multiply-adds (fused by the compiler where the FPU has FMA) rather than fmaf,
+     * which is a library call on targets without FMA and keeps the array version below
+     * from being vectorized.
      * @param a Input number
      * @returns Natural log value of a
      */
@@ -1352,88 +1659,262 @@ public:
         float m, r, s, t, i, f;
         int32_t e, g;
 
-        g = (int32_t) * ((int32_t *)&a);
+        memcpy(&g, &a, sizeof(g));
         e = (g - 0x3f2aaaab) & 0xff800000;
         g = g - e;
-        m = (float) * ((float *)&g);
+        memcpy(&m, &g, sizeof(m));
         i = (float)e * 1.19209290e-7f; // 0x1.0p-23
         /* m in [2/3, 4/3] */
         f = m - 1.0f;
         s = f * f;
         /* Compute log1p(f) for f in [-1/3, 1/3] */
-        r = fmaf(0.230836749f, f, -0.279208571f); // 0x1.d8c0f0p-3, -0x1.1de8dap-2
-        t = fmaf(0.331826031f, f, -0.498910338f); // 0x1.53ca34p-2, -0x1.fee25ap-2
-        r = fmaf(r, s, t);
-        r = fmaf(r, s, f);
-        r = fmaf(i, 0.693147182f, r); // 0x1.62e430p-1 // log(2)
+        r = (0.230836749f * f) - 0.279208571f; // 0x1.d8c0f0p-3, -0x1.1de8dap-2
+        t = (0.331826031f * f) - 0.498910338f; // 0x1.53ca34p-2, -0x1.fee25ap-2
+        r = (r * s) + t;
+        r = (r * s) + f;
+        r = (i * 0.693147182f) + r; // 0x1.62e430p-1 // log(2)
 
         return r;
     }
 
+    /**
+     * Natural log of an array, numpy::log(float) per element in a loop without calls or
+     * branches, so the compiler can vectorize it (4 floats per instruction with SSE at -O3).
+     * Optionally replaces zeros by FLT_EPSILON in the same pass, like
+     * functions::zero_handling. Same error as numpy::log(float).
+     * @param input Input array
+     * @param output Output array, can be the same as input
+     * @param size Number of elements
+     * @param zero_handling Replace zeros by FLT_EPSILON before taking the log
+     */
+    static void log(const float *input, float *output, size_t size, bool zero_handling = false)
+    {
+        if (zero_handling) {
+            for (size_t ix = 0; ix < size; ix++) {
+                // v + FLT_EPSILON if v is zero, else v + 0: no branch, so it vectorizes
+                const float v = input[ix];
+                output[ix] = numpy::log(v + (static_cast<float>(v == 0.0f) * FLT_EPSILON));
+            }
+        }
+        else {
+            for (size_t ix = 0; ix < size; ix++) {
+                output[ix] = numpy::log(input[ix]);
+            }
+        }
+    }
+
     /**
      * Calculate the natural log value of a matrix. Does an in-place replacement.
      * @param matrix Matrix (MxN)
+     * @param zero_handling Replace zeros by FLT_EPSILON before taking the log
      * @returns 0 if OK
      */
-    static int log(matrix_t *matrix)
+    static int log(matrix_t *matrix, bool zero_handling = false)
     {
-        for (uint32_t ix = 0; ix < matrix->rows * matrix->cols; ix++) {
-            matrix->buffer[ix] = numpy::log(matrix->buffer[ix]);
-        }
+        log(matrix->buffer, matrix->buffer, matrix->rows * matrix->cols, zero_handling);
 
         return EIDSP_OK;
     }
 
 private:
-    static int software_rfft(float *fft_input, float *output, size_t n_fft, size_t n_fft_out_features) {
-        kiss_fft_cpx *fft_output = (kiss_fft_cpx*)ei_dsp_malloc(n_fft_out_features * sizeof(kiss_fft_cpx));
-        if (!fft_output) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    /**
+     * Pointer to logical row `row` of a matrix that is used as a circular buffer of rows
+     */
+    static inline float *ring_row(matrix_t *matrix, uint32_t first_row, uint32_t row) {
+        uint32_t physical_row = first_row + row;
+        if (physical_row >= matrix->rows) {
+            physical_row -= matrix->rows;
         }
+        return matrix->buffer + (physical_row * matrix->cols);
+    }
 
-        size_t kiss_fftr_mem_length;
+    typedef struct {
+        fft_plan_t plans[EIDSP_FFT_PLAN_CACHE_SIZE];
+        size_t next;
+    } fft_plan_registry_t;
 
-        // create fftr context
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
-        if (!cfg) {
-            ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    typedef struct {
+        dct_basis_t bases[EIDSP_DCT_BASIS_CACHE_SIZE];
+        size_t next;
+    } dct_basis_cache_t;
+
+    static dct_basis_cache_t *dct_basis_cache() {
+        static EIDSP_THREAD_LOCAL dct_basis_cache_t cache = { };
+        return &cache;
+    }
+
+    static void free_dct_basis(dct_basis_t *basis) {
+        if (basis->basis) {
+            ei_dsp_free(basis->basis, basis->n * basis->stride * sizeof(float));
+            basis->basis = NULL;
         }
+    }
 
-        ei_dsp_register_alloc(kiss_fftr_mem_length);
+#if EIDSP_USE_CMSIS_DSP == 0
+    /**
+     * One row of dct2_truncated: the output is the sum of the basis rows scaled by
+     * the inputs. The coefficients are done eight at a time (the basis rows are padded
+     * to a multiple of eight) in two 4 float vectors, so there are two independent
+     * chains of SIMD adds, and no sum is reordered (the result is the same with or
+     * without the vectors). The loop vectorizer doesn't do this reliably by itself,
+     * hence the GCC vector extensions.
+     */
+    static void dct2_truncated_row(const dct_basis_t *basis, const float *input, float *output) {
+        for (size_t k = 0; k < basis->stride; k += 8) {
+            float acc[8];
+            const float *row = basis->basis + k;
+
+#if defined(__GNUC__)
+            typedef float v4sf __attribute__((vector_size(16)));
+            v4sf lo = { 0.0f, 0.0f, 0.0f, 0.0f };
+            v4sf hi = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+            for (size_t ix = 0; ix < basis->n; ix++, row += basis->stride) {
+                const v4sf x = { input[ix], input[ix], input[ix], input[ix] };
+                v4sf b_lo, b_hi;
+                memcpy(&b_lo, row, sizeof(v4sf));
+                memcpy(&b_hi, row + 4, sizeof(v4sf));
+                lo += x * b_lo;
+                hi += x * b_hi;
+            }
 
-        // execute the rfft operation
-        kiss_fftr(cfg, fft_input, fft_output);
+            memcpy(acc, &lo, sizeof(v4sf));
+            memcpy(acc + 4, &hi, sizeof(v4sf));
+#else
+            for (size_t c = 0; c < 8; c++) {
+                acc[c] = 0.0f;
+            }
+            for (size_t ix = 0; ix < basis->n; ix++, row += basis->stride) {
+                for (size_t c = 0; c < 8; c++) {
+                    acc[c] += input[ix] * row[c];
+                }
+            }
+#endif
 
-        // and write back to the output
-        for (size_t ix = 0; ix < n_fft_out_features; ix++) {
-            output[ix] = sqrt(pow(fft_output[ix].r, 2) + pow(fft_output[ix].i, 2));
+            for (size_t c = 0; c < 8 && k + c < basis->num_coefficients; c++) {
+                output[k + c] = acc[c];
+            }
+        }
+    }
+#endif // EIDSP_USE_CMSIS_DSP == 0
+
+    static fft_plan_registry_t *fft_plan_registry() {
+        static EIDSP_THREAD_LOCAL fft_plan_registry_t registry = { };
+        return &registry;
+    }
+
+    static int create_fft_plan(fft_plan_t *plan, fft_plan_type_t type, size_t n_fft, bool inverse) {
+        memset(plan, 0, sizeof(fft_plan_t));
+
+        if (n_fft == 0 || (type == FFT_PLAN_REAL && (n_fft & 1) == 1) || (type == FFT_PLAN_REAL && inverse)) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        plan->type = type;
+        plan->n_fft = n_fft;
+        plan->inverse = inverse;
+
+        if (type == FFT_PLAN_REAL) {
+#if EIDSP_USE_CMSIS_DSP
+            plan->use_cmsis = n_fft == 32 || n_fft == 64 || n_fft == 128 || n_fft == 256 ||
+                n_fft == 512 || n_fft == 1024 || n_fft == 2048 || n_fft == 4096;
+
+            if (plan->use_cmsis) {
+                arm_status status = arm_rfft_fast_init_f32(&plan->rfft_instance, n_fft);
+                if (status != ARM_MATH_SUCCESS) {
+                    return status;
+                }
+            }
+#endif
+            plan->input_size = n_fft * sizeof(float);
+            plan->output_size = (n_fft + 2) * sizeof(float);
+        }
+        else {
+            plan->input_size = n_fft * sizeof(fft_complex_t);
+            plan->output_size = n_fft * sizeof(fft_complex_t);
+        }
+
+#if EIDSP_USE_CMSIS_DSP
+        if (!plan->use_cmsis) {
+#endif
+            if (type == FFT_PLAN_REAL) {
+                plan->kiss_cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &plan->kiss_cfg_size);
+            }
+            else {
+                plan->kiss_cfg = kiss_fft_alloc(n_fft, inverse ? 1 : 0, NULL, NULL, &plan->kiss_cfg_size);
+            }
+            if (!plan->kiss_cfg) {
+                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+            }
+            ei_dsp_register_alloc(plan->kiss_cfg_size);
+#if EIDSP_USE_CMSIS_DSP
         }
+#endif
 
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
-        ei_dsp_free(fft_output, n_fft_out_features * sizeof(kiss_fft_cpx));
+        plan->input = (float*)ei_dsp_calloc(plan->input_size, 1);
+        plan->output = (float*)ei_dsp_calloc(plan->output_size, 1);
+        if (type == FFT_PLAN_REAL) {
+            plan->spectrum = (fft_complex_t*)ei_dsp_calloc(n_fft / 2 + 1, sizeof(fft_complex_t));
+        }
+
+        if (!plan->input || !plan->output || (type == FFT_PLAN_REAL && !plan->spectrum)) {
+            free_fft_plan(plan);
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
 
         return EIDSP_OK;
     }
 
-    static int software_rfft(float *fft_input, fft_complex_t *output, size_t n_fft, size_t n_fft_out_features)
-    {
-        // create fftr context
-        size_t kiss_fftr_mem_length;
+    static void free_fft_plan(fft_plan_t *plan) {
+        if (plan->kiss_cfg) {
+            ei_dsp_free(plan->kiss_cfg, plan->kiss_cfg_size);
+            plan->kiss_cfg = NULL;
+        }
+        if (plan->input) {
+            ei_dsp_free(plan->input, plan->input_size);
+            plan->input = NULL;
+        }
+        if (plan->output) {
+            ei_dsp_free(plan->output, plan->output_size);
+            plan->output = NULL;
+        }
+        if (plan->spectrum) {
+            ei_dsp_free(plan->spectrum, (plan->n_fft / 2 + 1) * sizeof(fft_complex_t));
+            plan->spectrum = NULL;
+        }
+        if (plan->twiddles) {
+            ei_dsp_free(plan->twiddles, (plan->n_fft / 2 + 1) * 2 * sizeof(float));
+            plan->twiddles = NULL;
+        }
+    }
 
-        kiss_fftr_cfg cfg = kiss_fftr_alloc(n_fft, 0, NULL, NULL, &kiss_fftr_mem_length);
-        if (!cfg) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    /**
+     * Copy src into the plan's input buffer, truncating or zero padding to n_fft.
+     * src can be the plan's input buffer already.
+     */
+    static void rfft_load_input(fft_plan_t *plan, const float *src, size_t src_size) {
+        // truncate if needed
+        if (src_size > plan->n_fft) {
+            src_size = plan->n_fft;
         }
 
-        ei_dsp_register_alloc(kiss_fftr_mem_length);
+        if (src != plan->input) {
+            memcpy(plan->input, src, src_size * sizeof(float));
+        }
+        // pad to the right with zeros
+        memset(plan->input + src_size, 0, (plan->n_fft - src_size) * sizeof(float));
+    }
 
-        // execute the rfft operation
-        kiss_fftr(cfg, fft_input, (kiss_fft_cpx*)output);
+    static void software_rfft(fft_plan_t *plan, float *output, size_t n_fft_out_features) {
+        kiss_fft_cpx *fft_output = (kiss_fft_cpx*)plan->output;
 
-        ei_dsp_free(cfg, kiss_fftr_mem_length);
+        // execute the rfft operation
+        kiss_fftr((kiss_fftr_cfg)plan->kiss_cfg, plan->input, fft_output);
 
-        return EIDSP_OK;
+        // and write back to the output
+        for (size_t ix = 0; ix < n_fft_out_features; ix++) {
+            output[ix] = sqrt(pow(fft_output[ix].r, 2) + pow(fft_output[ix].i, 2));
+        }
     }
 
     static int signal_get_data(float *in_buffer, size_t offset, size_t length, float *out_ptr)
@@ -1442,6 +1923,17 @@ private:
         return 0;
     }
 
+    static int signal_get_data_int16(const int16_t *in_buffer, size_t offset, size_t length, float *out_ptr)
+    {
+        return int16_to_float(in_buffer + offset, out_ptr, length);
+    }
+
+    static int signal_get_data_int16_raw(const int16_t *in_buffer, size_t offset, size_t length, int16_t *out_ptr)
+    {
+        memcpy(out_ptr, in_buffer + offset, length * sizeof(int16_t));
+        return 0;
+    }
+
 #if EIDSP_USE_CMSIS_DSP
     /**
      * @brief      The CMSIS std variance function with the same behaviour as the NumPy
@@ -35,9 +35,9 @@
 #endif // __MBED__
 #endif // __cplusplus
 
-#if EIDSP_TRACK_ALLOCATIONS
+#ifdef __cplusplus
 #include "../../../ei-keyword-spotting/edge-impulse-sdk/dsp/memory.hpp"
-#endif
+#endif // __cplusplus
 
 #ifdef __cplusplus
 namespace ei {
@@ -88,7 +88,7 @@ typedef struct ei_matrix {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (float*)calloc(n_rows * n_cols * sizeof(float), 1);
+            buffer = (float*)scratch_arena::allocate(n_rows * n_cols * sizeof(float), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -111,7 +111,7 @@ typedef struct ei_matrix {
 
     ~ei_matrix() {
         if (buffer && buffer_managed_by_me) {
-            free(buffer);
+            scratch_arena::release(buffer, rows * cols * sizeof(float));
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -177,7 +177,7 @@ typedef struct ei_quantized_matrix {
             buffer_managed_by_me = false;
         }
         else {
-            buffer = (uint8_t*)calloc(n_rows * n_cols * sizeof(uint8_t), 1);
+            buffer = (uint8_t*)scratch_arena::allocate(n_rows * n_cols * sizeof(uint8_t), true);
             buffer_managed_by_me = true;
         }
         rows = n_rows;
@@ -200,7 +200,7 @@ typedef struct ei_quantized_matrix {
 
     ~ei_quantized_matrix() {
         if (buffer && buffer_managed_by_me) {
-            free(buffer);
+            scratch_arena::release(buffer, rows * cols * sizeof(uint8_t));
 
 #if EIDSP_TRACK_ALLOCATIONS
             if (_fn) {
@@ -249,6 +249,23 @@ typedef struct ei_signal_t {
 #endif // __MBED__
 #endif // EIDSP_SIGNAL_C_FN_POINTER == 1
 
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+    /**
+     * Optional, retrieve part of the signal as int16 (f.e. audio straight from a
+     * microphone), scaled the same as get_data times 32768. DSP blocks that work on
+     * integers read through this instead of get_data when it's set, which saves
+     * converting to float and back. get_data still needs to be set.
+     * @param offset The offset in the signal
+     * @param length The total length of the signal
+     * @param out_ptr An out buffer to set the signal data
+     */
+#ifdef __MBED__
+    mbed::Callback<int(size_t offset, size_t length, int16_t *out_ptr)> get_data_int16;
+#else
+    std::function<int(size_t offset, size_t length, int16_t *out_ptr)> get_data_int16;
+#endif // __MBED__
+#endif // EIDSP_SIGNAL_C_FN_POINTER == 0
+
     size_t total_length;
 } signal_t;
 
@@ -0,0 +1,202 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_SPEECHPY_MFCC_STATIC_H_
+#define _EIDSP_SPEECHPY_MFCC_STATIC_H_
+
+#include <stdint.h>
+#include <float.h>
+
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/memory.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/numpy.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/feature.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/processing.hpp"
+
+namespace ei {
+namespace speechpy {
+
+/**
+ * MFCC for a configuration that is known at compile time (f.e. the MFCC block of
+ * the model, see EI_CLASSIFIER_MFCC_STATIC in model_metadata.h). Gives the same
+ * output as processing::preemphasis followed by feature::mfcc, but:
+ *  - the frame length and stride are in samples, so the number of frames is
+ *    integer math and there is no frame index vector (no heap)
+ *  - every frame is read, pre-emphasized and turned into its cepstral coefficients
+ *    in one go, without the window sized MFE and energy matrices
+ *  - the per frame buffers and loop bounds are constants, so the compiler can
+ *    unroll and vectorize the loops over the samples and coefficients
+ * The filterbank, the FFT plan and the DCT basis still come from the same caches as the
+ * generic path: they are built on the first window, not at compile time.
+ *
+ * @tparam SamplingFrequency Sampling frequency of the signal, in Hz
+ * @tparam FrameLength Length of a frame, in samples
+ * @tparam FrameStride Step between frames, in samples
+ * @tparam NumCepstral Number of cepstral coefficients
+ * @tparam NumFilters Number of filters in the filterbank
+ * @tparam FFTLength Number of FFT points
+ * @tparam LowFrequency Lowest band edge of the mel filters, in Hz
+ * @tparam HighFrequency Highest band edge of the mel filters, in Hz
+ * @tparam PreShift Pre-emphasis shift, in samples
+ */
+template<uint32_t SamplingFrequency, size_t FrameLength, size_t FrameStride, size_t NumCepstral,
+         size_t NumFilters, size_t FFTLength, uint32_t LowFrequency, uint32_t HighFrequency, size_t PreShift>
+class mfcc_static {
+public:
+    static_assert(FrameLength > 0 && FrameStride > 0, "frame length and stride need at least one sample");
+    static_assert(NumCepstral <= NumFilters, "more cepstral coefficients than filters");
+    static_assert(PreShift > 0 && PreShift <= FrameLength, "pre-emphasis shift out of range");
+    static_assert(HighFrequency > LowFrequency && HighFrequency <= SamplingFrequency / 2, "invalid band edges");
+
+    /* Number of bins of the power spectrum */
+    static const size_t coefficients = FFTLength / 2 + 1;
+
+    /**
+     * Number of frames in a signal, the same as processing::calculate_no_of_stack_frames
+     * without zero padding (the last frame that fits is left out)
+     * @param signal_length Number of samples
+     */
+    static constexpr size_t calculate_no_of_frames(size_t signal_length) {
+        return signal_length < FrameLength ? 0 : (signal_length - FrameLength) / FrameStride;
+    }
+
+    /**
+     * Number of bytes of scratch memory (see scratch_arena) that mfcc() needs
+     */
+    static size_t scratch_size() {
+        return scratch_arena::size_of((PreShift + FrameLength) * sizeof(float)) +
+            scratch_arena::size_of(coefficients * sizeof(float)) +
+            scratch_arena::size_of(NumFilters * sizeof(float));
+    }
+
+    /**
+     * Compute the MFCC of a signal. Pre-emphasis is part of it: the first samples
+     * are pre-emphasized with the last samples of the signal, like processing::preemphasis.
+     * @param out_features Out matrix, calculate_no_of_frames(signal->total_length) rows
+     *     of NumCepstral columns
+     * @param signal Audio signal
+     * @param pre_cof The pre-emphasis coefficient
+     * @returns EIDSP_OK if OK
+     */
+    static int mfcc(matrix_t *out_features, signal_t *signal, float pre_cof) {
+        const size_t signal_length = signal->total_length;
+        const size_t frame_count = calculate_no_of_frames(signal_length);
+
+        if (out_features->rows != frame_count || out_features->cols != NumCepstral) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+        if (frame_count == 0) {
+            return EIDSP_OK;
+        }
+
+        const sparse_filterbank_t *filterbank;
+        int ret = feature::sparse_filterbank(
+            &filterbank, NumFilters, coefficients, SamplingFrequency, LowFrequency, HighFrequency);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        // the PreShift samples before the frame, followed by the frame
+        EI_DSP_MATRIX(frame, 1, PreShift + FrameLength);
+        EI_DSP_MATRIX(power_spectrum, 1, coefficients);
+        EI_DSP_MATRIX(mel, 1, NumFilters);
+
+        // the history of the first frame is the end of the signal
+        float end_of_signal[PreShift];
+        ret = signal->get_data(signal_length - PreShift, PreShift, end_of_signal);
+        if (ret != 0) {
+            EIDSP_ERR(ret);
+        }
+
+        for (size_t ix = 0; ix < frame_count; ix++) {
+            const size_t offset = ix * FrameStride;
+
+            if (offset >= PreShift) {
+                ret = signal->get_data(offset - PreShift, PreShift + FrameLength, frame.buffer);
+            }
+            else {
+                for (size_t k = 0; k < PreShift - offset; k++) {
+                    frame.buffer[k] = end_of_signal[offset + k];
+                }
+                ret = signal->get_data(0, offset + FrameLength, frame.buffer + (PreShift - offset));
+            }
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+
+            ret = calculate_frame(frame.buffer, pre_cof, filterbank, power_spectrum.buffer, mel.buffer,
+                out_features->buffer + (ix * NumCepstral));
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+private:
+    /**
+     * Pre-emphasize a frame and calculate its cepstral coefficients, with the same
+     * steps in the same order as feature::mfe and feature::mfcc
+     * @param frame PreShift samples of history followed by the frame, the pre-emphasized
+     *     frame is written to the start of the buffer
+     */
+    static int calculate_frame(float *frame, float pre_cof, const sparse_filterbank_t *filterbank,
+        float *power_spectrum, float *mel, float *out)
+    {
+        // y[n] = x[n] - cof * x[n - shift], in place: x[n - shift] is read before it's overwritten
+        for (size_t k = 0; k < FrameLength; k++) {
+            frame[k] = frame[k + PreShift] - (pre_cof * frame[k]);
+        }
+
+        float energy;
+        int ret = processing::power_spectrum(frame, FrameLength, power_spectrum, coefficients, FFTLength, &energy);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        if (energy == 0) {
+            energy = FLT_EPSILON;
+        }
+
+        ret = feature::mel_energies(filterbank, power_spectrum, coefficients, mel);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        numpy::log(mel, mel, NumFilters, true);
+
+        ret = numpy::dct2_truncated(mel, NumFilters, out, NumCepstral);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        // the log of the frame energy replaces the first coefficient (DC elimination)
+        out[0] = numpy::log(energy);
+
+        return EIDSP_OK;
+    }
+};
+
+} // namespace speechpy
+} // namespace ei
+
+#endif // _EIDSP_SPEECHPY_MFCC_STATIC_H_
@@ -24,25 +24,231 @@
 #define _EIDSP_SPEECHPY_PROCESSING_H_
 
 #include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/numpy.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/fixed_point.hpp"
 
 namespace ei {
 namespace speechpy {
 
-// one stack frame returned by stack_frames
+// the frames of a signal as returned by stack_frames: frame_count frames of frame_length
+// samples, the first one at the start of the signal and every next one frame_stride further
 typedef struct ei_stack_frames_info {
     signal_t *signal;
-    std::vector<uint32_t> *frame_ixs;
-    int frame_length;
+    size_t frame_length;
+    size_t frame_stride;
+    size_t frame_count;
 
-    // start_ixs is owned by us
-    ~ei_stack_frames_info() {
-        if (frame_ixs) {
-            delete frame_ixs;
-        }
+    /**
+     * Offset of frame `ix` in the signal
+     */
+    size_t frame_offset(size_t ix) const {
+        return ix * frame_stride;
     }
 } stack_frames_info_t;
 
 namespace processing {
+    /**
+     * Pre-emphasis filter for audio that comes in blocks, y[n] = x[n] - cof * x[n - shift].
+     * The last `shift` input samples are kept between calls, so filtering a signal block by
+     * block gives the same output as filtering it in one go. Blocks go through a window of
+     * [history | up to 64 samples], so the inner loop is a plain multiply-subtract over two
+     * arrays that the compiler vectorizes (no per sample roll of the history or branch).
+     */
+    class preemphasis_filter {
+public:
+        preemphasis_filter()
+            : _shift(0), _cof(0.0f), _window(NULL)
+        {
+        }
+
+        ~preemphasis_filter() {
+            free_window();
+        }
+
+        // owns its window, a copy would free it a second time
+        preemphasis_filter(const preemphasis_filter &) = delete;
+        preemphasis_filter &operator=(const preemphasis_filter &) = delete;
+
+        /**
+         * Number of bytes of scratch memory (see scratch_arena) that init() allocates
+         * @param shift (int): The shift step.
+         */
+        static size_t scratch_size(size_t shift) {
+            return shift == 0 ? 0 : scratch_arena::size_of((shift + chunk_size) * sizeof(float));
+        }
+
+        /**
+         * Configure the filter, the history starts out as zeros. Can be called again to re-configure.
+         * @param shift (int): The shift step. 0 passes the signal through unchanged.
+         * @param cof (float): The preemphasising coefficient. 0 equals to no filtering.
+         * @returns EIDSP_OK if OK
+         */
+        int init(size_t shift, float cof) {
+            free_window();
+
+            _shift = shift;
+            _cof = cof;
+
+            if (_shift > 0) {
+                _window = (float*)ei_dsp_calloc((_shift + chunk_size) * sizeof(float), 1);
+                if (!_window) {
+                    EIDSP_ERR(EIDSP_OUT_OF_MEM);
+                }
+            }
+
+            return EIDSP_OK;
+        }
+
+        /**
+         * Whether init() was called successfully
+         */
+        bool is_initialized() {
+            return _shift == 0 || _window != NULL;
+        }
+
+        /**
+         * Set the history to zeros, f.e. when there was a gap in the audio stream
+         */
+        void reset() {
+            if (_window) {
+                memset(_window, 0, _shift * sizeof(float));
+            }
+        }
+
+        /**
+         * Set the history: the `shift` samples that come before the next block
+         */
+        void set_history(const float *samples) {
+            if (_window) {
+                memcpy(_window, samples, _shift * sizeof(float));
+            }
+        }
+
+        /**
+         * Add samples to the history without filtering them (samples that are not
+         * part of any frame still count as history for the next one)
+         */
+        void push_history(const float *samples, size_t length) {
+            if (!_window) {
+                return;
+            }
+            if (length >= _shift) {
+                memcpy(_window, samples + (length - _shift), _shift * sizeof(float));
+            }
+            else {
+                memmove(_window, _window + length, (_shift - length) * sizeof(float));
+                memcpy(_window + (_shift - length), samples, length * sizeof(float));
+            }
+        }
+
+        /**
+         * Pre-emphasize a block in place
+         */
+        void process(float *buffer, size_t length) {
+            if (!_window) {
+                return;
+            }
+
+            for (size_t offset = 0; offset < length; offset += chunk_size) {
+                size_t count = length - offset < chunk_size ? length - offset : chunk_size;
+
+                memcpy(_window + _shift, buffer + offset, count * sizeof(float));
+                filter_window(buffer + offset, count);
+            }
+        }
+
+        /**
+         * Convert int16 samples (f.e. straight from a microphone) to float, scaled to -1..1
+         * like numpy::int16_to_float, and pre-emphasize them, in one pass
+         */
+        void process(const int16_t *input, float *output, size_t length) {
+            const float scale = 1.0f / 32768.0f;
+
+            if (!_window) {
+                for (size_t ix = 0; ix < length; ix++) {
+                    output[ix] = static_cast<float>(input[ix]) * scale;
+                }
+                return;
+            }
+
+            for (size_t offset = 0; offset < length; offset += chunk_size) {
+                size_t count = length - offset < chunk_size ? length - offset : chunk_size;
+
+                float *block = _window + _shift;
+                for (size_t ix = 0; ix < count; ix++) {
+                    block[ix] = static_cast<float>(input[offset + ix]) * scale;
+                }
+                filter_window(output + offset, count);
+            }
+        }
+
+        /**
+         * Read part of a signal and pre-emphasize it, continuing from the history. Reads
+         * int16 samples through get_data_int16 when the signal has it.
+         * @param signal Signal to read from
+         * @param offset Offset in the signal
+         * @param length Number of samples
+         * @param out_buffer Out buffer, `length` floats
+         * @returns 0 if OK
+         */
+        int read(signal_t *signal, size_t offset, size_t length, float *out_buffer) {
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+            if (signal->get_data_int16) {
+                int16_t buffer[chunk_size];
+
+                for (size_t ix = 0; ix < length; ix += chunk_size) {
+                    size_t count = length - ix < chunk_size ? length - ix : chunk_size;
+
+                    int ret = signal->get_data_int16(offset + ix, count, buffer);
+                    if (ret != 0) {
+                        EIDSP_ERR(ret);
+                    }
+                    process(buffer, out_buffer + ix, count);
+                }
+
+                return EIDSP_OK;
+            }
+#endif
+
+            int ret = signal->get_data(offset, length, out_buffer);
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+            process(out_buffer, length);
+
+            return EIDSP_OK;
+        }
+
+private:
+        static const size_t chunk_size = 64;
+
+        /**
+         * Filter the `count` samples after the history in the window into out,
+         * then keep the last `shift` of them as the new history
+         */
+        void filter_window(float *out, size_t count) {
+            const float *history = _window;
+            const float *block = _window + _shift;
+            const float cof = _cof;
+
+            for (size_t ix = 0; ix < count; ix++) {
+                out[ix] = block[ix] - (cof * history[ix]);
+            }
+
+            memmove(_window, _window + count, _shift * sizeof(float));
+        }
+
+        void free_window() {
+            if (_window) {
+                ei_dsp_free(_window, (_shift + chunk_size) * sizeof(float));
+                _window = NULL;
+            }
+        }
+
+        size_t _shift;
+        float _cof;
+        float *_window;     // history (shift floats) followed by room for one chunk
+    };
+
     /**
      * Lazy Preemphasising on the signal.
      * @param signal: The input signal.
@@ -52,20 +258,29 @@ namespace processing {
     class preemphasis {
 public:
         preemphasis(ei_signal_t *signal, int shift = 1, float cof = 0.98f)
-            : _signal(signal), _shift(shift), _cof(cof)
+            : _signal(signal), _shift(shift)
         {
-            _prev_buffer = (float*)ei_dsp_calloc(shift * sizeof(float), 1);
-            _end_of_signal_buffer = (float*)ei_dsp_calloc(shift * sizeof(float), 1);
-            _next_offset_should_be = 0;
-
             if (shift < 0) {
                 _shift = signal->total_length + shift;
             }
 
+            _prev_buffer = (float*)ei_dsp_calloc(_shift * sizeof(float), 1);
+            _end_of_signal_buffer = (float*)ei_dsp_calloc(_shift * sizeof(float), 1);
+
             if (!_prev_buffer || !_end_of_signal_buffer) return;
 
+            if (_filter.init(_shift, cof) != EIDSP_OK) return;
+
             // we need to get the shift bytes from the end of the buffer...
-            signal->get_data(signal->total_length - shift, shift, _end_of_signal_buffer);
+            signal->get_data(signal->total_length - _shift, _shift, _end_of_signal_buffer);
+        }
+
+        /**
+         * Number of bytes of scratch memory (see scratch_arena) that the constructor allocates
+         * @param shift (int): The shift step, at least 0.
+         */
+        static size_t scratch_size(size_t shift) {
+            return 2 * scratch_arena::size_of(shift * sizeof(float)) + preemphasis_filter::scratch_size(shift);
         }
 
         /**
@@ -75,48 +290,25 @@ public:
          * @param length Length of the audio signal
          */
         int get_data(size_t offset, size_t length, float *out_buffer) {
-            if (!_prev_buffer || !_end_of_signal_buffer) {
+            if (!_prev_buffer || !_end_of_signal_buffer || !_filter.is_initialized()) {
                 EIDSP_ERR(EIDSP_OUT_OF_MEM);
             }
             if (offset + length > _signal->total_length) {
                 EIDSP_ERR(EIDSP_OUT_OF_BOUNDS);
             }
 
-            int ret;
-            if (static_cast<int32_t>(offset) - _shift >= 0) {
-                ret = _signal->get_data(offset - _shift, _shift, _prev_buffer);
+            // the `shift` samples before offset, wrapping around to the end of the signal
+            size_t wrapped = offset < static_cast<size_t>(_shift) ? _shift - offset : 0;
+            memcpy(_prev_buffer, _end_of_signal_buffer + (_shift - wrapped), wrapped * sizeof(float));
+            if (wrapped < static_cast<size_t>(_shift)) {
+                int ret = _signal->get_data(offset + wrapped - _shift, _shift - wrapped, _prev_buffer + wrapped);
                 if (ret != 0) {
                     EIDSP_ERR(ret);
                 }
             }
-            // else we'll use the end_of_signal_buffer; so no need to check
-
-            ret = _signal->get_data(offset, length, out_buffer);
-            if (ret != 0) {
-                EIDSP_ERR(ret);
-            }
-
-            // now we have the signal and we can preemphasize
-            for (size_t ix = 0; ix < length; ix++) {
-                float now = out_buffer[ix];
-
-                // under shift? read from end
-                if (offset + ix < static_cast<uint32_t>(_shift)) {
-                    out_buffer[ix] = now - (_cof * _end_of_signal_buffer[offset + ix]);
-                }
-                // otherwise read from history buffer
-                else {
-                    out_buffer[ix] = now - (_cof * _prev_buffer[0]);
-                }
-
-                // roll through and overwrite last element
-                numpy::roll(_prev_buffer, _shift, -1);
-                _prev_buffer[_shift - 1] = now;
-            }
-
-            _next_offset_should_be += length;
+            _filter.set_history(_prev_buffer);
 
-            return EIDSP_OK;
+            return _filter.read(_signal, offset, length, out_buffer);
         }
 
         ~preemphasis() {
@@ -131,10 +323,9 @@ public:
 private:
         ei_signal_t *_signal;
         int _shift;
-        float _cof;
         float *_prev_buffer;
         float *_end_of_signal_buffer;
-        size_t _next_offset_should_be;
+        preemphasis_filter _filter;
     };
 }
 
@@ -154,34 +345,47 @@ namespace processing {
             shift = signal_size + shift;
         }
 
-        // so we need to keep some history
-        float *prev_buffer = (float*)ei_dsp_calloc(shift * sizeof(float), 1);
+        preemphasis_filter filter;
+        int ret = filter.init(shift, cof);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
 
-        // signal - cof * xt::roll(signal, shift)
-        for (size_t ix = 0; ix < signal_size; ix++) {
-            float now = signal[ix];
+        // signal - cof * xt::roll(signal, shift), the first samples wrap around to the end
+        filter.set_history(signal + signal_size - shift);
+        filter.process(signal, signal_size);
 
-            // under shift? read from end
-            if (ix < static_cast<uint32_t>(shift)) {
-                signal[ix] = now - (cof * signal[signal_size - shift + ix]);
-            }
-            // otherwise read from history buffer
-            else {
-                signal[ix] = now - (cof * prev_buffer[0]);
-            }
+        return EIDSP_OK;
+    }
 
-            // roll through and overwrite last element
-            numpy::roll(prev_buffer, shift, -1);
-            prev_buffer[shift - 1] = now;
-        }
+    /**
+     * Number of samples in `seconds` (a frame length or stride), rounded to the nearest sample
+     */
+    static size_t frame_samples(uint32_t sampling_frequency, float seconds) {
+        int samples = static_cast<int>(round(static_cast<float>(sampling_frequency) * seconds));
+        return samples > 0 ? static_cast<size_t>(samples) : 0;
+    }
 
-        ei_dsp_free(prev_buffer, shift * sizeof(float));
+    /**
+     * Number of frames in a signal, in integers: (signal_length - frame_length) / frame_stride,
+     * rounded up with zero padding and down without. The last frame that fits without
+     * padding is left out, like in speechpy. 0 if the signal is shorter than a frame.
+     */
+    static size_t count_frames(size_t signal_length, size_t frame_length, size_t frame_stride, bool zero_padding) {
+        if (signal_length < frame_length) {
+            return 0;
+        }
 
-        return EIDSP_OK;
+        size_t length = signal_length - frame_length;
+        if (zero_padding) {
+            return (length + frame_stride - 1) / frame_stride;
+        }
+        return length / frame_stride;
     }
 
     /**
-     * Frame a signal into overlapping frames.
+     * Frame a signal into overlapping frames. Only describes the frames (see
+     * stack_frames_info_t), nothing is allocated and the signal is not touched.
      * @param info This is both the base object and where we'll store our results.
      * @param sampling_frequency (int): The sampling frequency of the signal.
      * @param frame_length (float): The length of the frame in second.
@@ -201,45 +405,16 @@ namespace processing {
             EIDSP_ERR(EIDSP_SIGNAL_SIZE_MISMATCH);
         }
 
-        size_t length_signal = info->signal->total_length;
-        int frame_sample_length = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_length));
-        frame_stride = round(static_cast<float>(sampling_frequency) * frame_stride);
-
-        volatile int numframes;
-        volatile int len_sig;
-
-        if (zero_padding) {
-            // Calculation of number of frames
-            numframes = static_cast<int>(
-                ceil(static_cast<float>(length_signal - frame_sample_length) / frame_stride));
-
-            // Zero padding
-            len_sig = static_cast<int>(static_cast<float>(numframes) * frame_stride) + frame_sample_length;
-
-            info->signal->total_length = static_cast<size_t>(len_sig);
-        }
-        else {
-            numframes = static_cast<int>(
-                floor(static_cast<float>(length_signal - frame_sample_length) / frame_stride));
-            len_sig = static_cast<int>(
-                (static_cast<float>(numframes - 1) * frame_stride + frame_sample_length));
-
-            info->signal->total_length = static_cast<size_t>(len_sig);
-        }
-
-        // alloc the vector on the heap, will be owned by the info struct
-        std::vector<uint32_t> *frame_indices = new std::vector<uint32_t>();
-
-        int frame_count = 0;
-
-        for (size_t ix = 0; ix < static_cast<uint32_t>(len_sig); ix += static_cast<size_t>(frame_stride)) {
-            if (++frame_count > numframes) break;
-
-            frame_indices->push_back(ix);
+        size_t frame_sample_length = frame_samples(sampling_frequency, frame_length);
+        size_t frame_sample_stride = frame_samples(sampling_frequency, frame_stride);
+        if (frame_sample_length == 0 || frame_sample_stride == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
         }
 
-        info->frame_ixs = frame_indices;
         info->frame_length = frame_sample_length;
+        info->frame_stride = frame_sample_stride;
+        info->frame_count = count_frames(
+            info->signal->total_length, frame_sample_length, frame_sample_stride, zero_padding);
 
         return EIDSP_OK;
     }
@@ -264,53 +439,265 @@ namespace processing {
         float frame_stride,
         bool zero_padding)
     {
-        size_t length_signal = signal_size;
-        int frame_sample_length = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_length));
-        frame_stride = round(static_cast<float>(sampling_frequency) * frame_stride);
-
-        int numframes;
-
-        if (zero_padding) {
-            // Calculation of number of frames
-            numframes = static_cast<int>(
-                ceil(static_cast<float>(length_signal - frame_sample_length) / frame_stride));
-        }
-        else {
-            numframes = static_cast<int>(
-                floor(static_cast<float>(length_signal - frame_sample_length) / frame_stride));
+        size_t frame_sample_length = frame_samples(sampling_frequency, frame_length);
+        size_t frame_sample_stride = frame_samples(sampling_frequency, frame_stride);
+        if (frame_sample_length == 0 || frame_sample_stride == 0) {
+            return EIDSP_PARAMETER_INVALID;
         }
 
-        return numframes;
+        return static_cast<int32_t>(count_frames(signal_size, frame_sample_length, frame_sample_stride, zero_padding));
     }
 
     /**
      * Power spectrum of a frame
      * @param frame Row of a frame
      * @param frame_size Size of the frame
-     * @param out_buffer Out buffer, size should be fft_points
+     * @param out_buffer Out buffer, size should be fft_points / 2 + 1
      * @param out_buffer_size Buffer size
      * @param fft_points (int): The length of FFT. If fft_length is greater than frame_len, the frames will be zero-padded.
+     * @param out_energy If not NULL, receives the sum of the power spectrum (the frame energy)
      * @returns EIDSP_OK if OK
      */
-    static int power_spectrum(float *frame, size_t frame_size, float *out_buffer, size_t out_buffer_size, uint16_t fft_points)
+    static int power_spectrum(float *frame, size_t frame_size, float *out_buffer, size_t out_buffer_size,
+        uint16_t fft_points, float *out_energy = NULL)
     {
         if (out_buffer_size != static_cast<size_t>(fft_points / 2 + 1)) {
             EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
         }
 
-        int r = numpy::rfft(frame, frame_size, out_buffer, out_buffer_size, fft_points);
-        if (r != EIDSP_OK) {
-            return r;
+        return numpy::power_spectrum(frame, frame_size, out_buffer, out_buffer_size, fft_points, out_energy);
+    }
+
+    /**
+     * Map a row on the symmetric (reflecting) extension of a column back to
+     * the unpadded row it was copied from, like numpy's 'symmetric' padding.
+     * @param rows Number of rows in the column
+     * @param row Row, measured from the first unpadded row. Can be negative.
+     * @returns Unpadded row
+     */
+    static inline int32_t cmvnw_reflect_row(int32_t rows, int32_t row)
+    {
+        int32_t period = rows * 2;
+        int32_t rem = row % period;
+        if (rem < 0) {
+            rem += period;
+        }
+        return rem < rows ? rem : period - 1 - rem;
+    }
+
+    /**
+     * Sum of the first k rows of the symmetric (reflecting) extension of a column,
+     * given the prefix sums of that column. The extension repeats with a period of
+     * 2 * rows (the column forward, then backwards), so any window on the padded
+     * column can be summed as cmvnw_extended_sum(b) - cmvnw_extended_sum(a), also
+     * when the padding is larger than the column itself. k can be negative.
+     * @param prefix Prefix sums, prefix[i] is the sum of the first i rows (rows + 1 elements)
+     * @param rows Number of rows in the column
+     * @param k Number of rows to sum, measured from the first unpadded row
+     * @returns Sum over the extended column
+     */
+    template <typename T>
+    static inline T cmvnw_extended_sum(const T *prefix, int32_t rows, int32_t k)
+    {
+        int32_t period = rows * 2;
+        int32_t periods = k / period;
+        int32_t rem = k % period;
+        if (rem < 0) {
+            rem += period;
+            periods--;
+        }
+
+        T total = prefix[rows];
+        T partial = rem <= rows ?
+            prefix[rem] :
+            (2 * total) - prefix[period - rem];
+
+        return (static_cast<T>(periods) * 2 * total) + partial;
+    }
+
+    /**
+     * Writes normalized values to a float matrix (in order)
+     */
+    struct cmvnw_float_writer {
+        matrix_t *out_matrix;
+
+        inline void operator()(uint32_t row, uint32_t col, float value, float std_dev) {
+            out_matrix->buffer[row * out_matrix->cols + col] = value / std_dev;
+        }
+    };
+
+    /**
+     * Quantizes normalized values straight into an int8 buffer (in order),
+     * with a precomputed reciprocal of the quantization scale
+     */
+    struct cmvnw_quantized_writer {
+        int8_t *out;
+        uint32_t cols;
+        float inv_scale;
+        int32_t zero_point;
+
+        inline void operator()(uint32_t row, uint32_t col, float value, float std_dev) {
+            float q = roundf((value * inv_scale) / std_dev) + static_cast<float>(zero_point);
+            out[row * cols + col] = static_cast<int8_t>(q < -128.0f ? -128.0f : (q > 127.0f ? 127.0f : q));
+        }
+    };
+
+    /**
+     * Number of bytes of scratch memory (see scratch_arena) that cmvnw and
+     * cmvnw_quantize need for a window of `rows` frames
+     * @param rows Number of frames in the window
+     * @param fixed_point For the integer cmvnw_quantize
+     */
+    static size_t cmvnw_scratch_size(uint32_t rows, bool fixed_point = false) {
+        return scratch_arena::size_of(2 * (rows + 1) * (fixed_point ? sizeof(int64_t) : sizeof(float)));
+    }
+
+    /**
+     * Sliding window cepstral mean and variance normalization over a circular buffer of
+     * frames, handing every result to `write` as (row, col, value - mean, std_dev), where
+     * row is the logical row (0 is the oldest frame) and std_dev is 1 without variance
+     * normalization.
+     * Keeps a running sum and sum of squares per coefficient (as prefix sums), and
+     * resolves the symmetric padding analytically, so the cost is O(rows) per column
+     * rather than O(rows * win_size).
+     */
+    template <typename T>
+    static int cmvnw_internal(matrix_t *features_matrix, uint32_t first_row,
+        uint16_t win_size, bool variance_normalization, T &write)
+    {
+        const uint32_t rows = features_matrix->rows;
+        const uint32_t cols = features_matrix->cols;
+
+        if (rows == 0 || first_row >= rows || win_size == 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        const int32_t pad_size = (win_size - 1) / 2;
+        const float win_scale = 1.0f / static_cast<float>(win_size);
+
+        // prefix sums of the (shifted) column, and of its squares
+        EI_DSP_MATRIX(prefix, 2, rows + 1);
+        if (!prefix.buffer) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
+        float *prefix_sum = prefix.buffer;
+        float *prefix_sq = prefix.buffer + rows + 1;
+
+        // for short windows summing the window directly is about as cheap, and the
+        // one-pass variance would lose precision when a window is much flatter than the column
+        const bool direct = win_size < 16;
+
+        for (uint32_t col = 0; col < cols; col++) {
+            // shift by the column mean first, so the sum of squares doesn't
+            // lose the variance to cancellation
+            float shift = 0.0f;
+            for (uint32_t ix = 0; ix < rows; ix++) {
+                shift += features_matrix->buffer[((first_row + ix) % rows) * cols + col];
+            }
+            shift /= static_cast<float>(rows);
+
+            // direct: a copy of the (shifted) column, so writing in place is safe
+            float *column = prefix_sum;
+
+            if (direct) {
+                for (uint32_t ix = 0; ix < rows; ix++) {
+                    column[ix] = features_matrix->buffer[((first_row + ix) % rows) * cols + col] - shift;
+                }
+            }
+            else {
+                prefix_sum[0] = 0.0f;
+                prefix_sq[0] = 0.0f;
+                for (uint32_t ix = 0; ix < rows; ix++) {
+                    float v = features_matrix->buffer[((first_row + ix) % rows) * cols + col] - shift;
+                    prefix_sum[ix + 1] = prefix_sum[ix] + v;
+                    prefix_sq[ix + 1] = prefix_sq[ix] + (v * v);
+                }
+            }
+
+            for (uint32_t ix = 0; ix < rows; ix++) {
+                // window on the padded column is [ix - pad, ix - pad + win_size) in unpadded rows
+                int32_t win_start = static_cast<int32_t>(ix) - pad_size;
+                int32_t win_end = win_start + win_size;
+
+                float mean;
+                float variance = 0.0f;
+
+                if (direct) {
+                    mean = 0.0f;
+                    for (int32_t w = win_start; w < win_end; w++) {
+                        mean += column[cmvnw_reflect_row(rows, w)];
+                    }
+                    mean *= win_scale;
+
+                    if (variance_normalization == true) {
+                        for (int32_t w = win_start; w < win_end; w++) {
+                            float d = column[cmvnw_reflect_row(rows, w)] - mean;
+                            variance += d * d;
+                        }
+                        variance *= win_scale;
+                    }
+                }
+                else {
+                    mean = (cmvnw_extended_sum(prefix_sum, rows, win_end) -
+                        cmvnw_extended_sum(prefix_sum, rows, win_start)) * win_scale;
+
+                    if (variance_normalization == true) {
+                        float mean_sq = (cmvnw_extended_sum(prefix_sq, rows, win_end) -
+                            cmvnw_extended_sum(prefix_sq, rows, win_start)) * win_scale;
+                        variance = mean_sq - (mean * mean);
+                        if (variance < 0.0f) {
+                            variance = 0.0f;
+                        }
+                    }
+                }
+
+                float v = direct ?
+                    column[ix] :
+                    features_matrix->buffer[((first_row + ix) % rows) * cols + col] - shift;
 
-        for (size_t ix = 0; ix < out_buffer_size; ix++) {
-            out_buffer[ix] = (1.0 / static_cast<float>(fft_points)) *
-                (out_buffer[ix] * out_buffer[ix]);
+                if (variance_normalization == true) {
+                    write(ix, col, v - mean, sqrt(variance) + FLT_EPSILON);
+                }
+                else {
+                    write(ix, col, v - mean, 1.0f);
+                }
+            }
         }
 
         return EIDSP_OK;
     }
 
+    /**
+     * Local cepstral mean and variance normalization on a sliding window, reading from
+     * a feature matrix that is used as a circular buffer of frames (one observation per row).
+     * The normalized features are written in order (oldest frame first) to out_matrix.
+     * @param features_matrix input feature matrix, not modified (unless it's also out_matrix)
+     * @param first_row Row in features_matrix that holds the oldest frame
+     * @param out_matrix Output matrix, same size as features_matrix. Can be features_matrix
+     *   itself if first_row is 0.
+     * @param win_size The size of sliding window for local normalization.
+     * @param variance_normalization If the variance normilization should
+     *   be performed or not.
+     * @returns 0 if OK
+     */
+    static int cmvnw(matrix_t *features_matrix, uint32_t first_row, matrix_t *out_matrix,
+        uint16_t win_size = 301, bool variance_normalization = false)
+    {
+        if (out_matrix->rows * out_matrix->cols != features_matrix->rows * features_matrix->cols) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        if (out_matrix->buffer == features_matrix->buffer && first_row != 0) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        // out_matrix may have a different shape (f.e. 1 x N), view it as rows x cols
+        EI_DSP_MATRIX_B(out_view, features_matrix->rows, features_matrix->cols, out_matrix->buffer);
+
+        cmvnw_float_writer writer = { &out_view };
+        return cmvnw_internal(features_matrix, first_row, win_size, variance_normalization, writer);
+    }
+
     /**
      * This function performs local cepstral mean and
      * variance normalization on a sliding window. The code assumes that
@@ -325,66 +712,132 @@ namespace processing {
      */
     static int cmvnw(matrix_t *features_matrix, uint16_t win_size = 301, bool variance_normalization = false)
     {
-        uint16_t pad_size = (win_size - 1) / 2;
-
-        int ret;
-        float *features_buffer_ptr;
+        return cmvnw(features_matrix, 0, features_matrix, win_size, variance_normalization);
+    }
 
-        // mean & variance normalization
-        EI_DSP_MATRIX(vec_pad, features_matrix->rows + (pad_size * 2), features_matrix->cols);
-        if (!vec_pad.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    /**
+     * Circular buffer cmvnw that quantizes the normalized features straight into an int8
+     * buffer (f.e. the model input tensor), as round(normalized / scale) + zero_point,
+     * in order (oldest frame first). Saves a float copy of the normalized window.
+     * @param features_matrix input feature matrix, used as a circular buffer, not modified
+     * @param first_row Row in features_matrix that holds the oldest frame
+     * @param win_size The size of sliding window for local normalization.
+     * @param variance_normalization If the variance normilization should
+     *   be performed or not.
+     * @param scale Quantization scale of the output
+     * @param zero_point Quantization zero point of the output
+     * @param out Output buffer, rows x cols
+     * @returns 0 if OK
+     */
+    __attribute__((unused)) static int cmvnw_quantize(matrix_t *features_matrix, uint32_t first_row,
+        uint16_t win_size, bool variance_normalization,
+        float scale, int32_t zero_point, int8_t *out)
+    {
+        if (scale <= 0.0f) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
         }
 
-        ret = numpy::pad_1d_symmetric(features_matrix, &vec_pad, pad_size, pad_size);
-        if (ret != EIDSP_OK) {
-            EIDSP_ERR(ret);
-        }
+        cmvnw_quantized_writer writer = { out, features_matrix->cols, 1.0f / scale, zero_point };
+        return cmvnw_internal(features_matrix, first_row, win_size, variance_normalization, writer);
+    }
 
-        EI_DSP_MATRIX(mean_matrix, vec_pad.cols, 1);
-        if (!mean_matrix.buffer) {
-            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+    /**
+     * Integer version of the circular buffer cmvnw, for the fixed-point front end.
+     * The normalized features are quantized straight to int8, as
+     * round(normalized / scale) + zero_point, and written in order (oldest frame first).
+     * The sums are exact (64-bit), so the only rounding is in the final division.
+     * @param features Circular buffer of frames, rows x cols fixed-point values
+     * @param rows Number of frames
+     * @param cols Number of coefficients per frame
+     * @param first_row Row in features that holds the oldest frame
+     * @param win_size The size of sliding window for local normalization.
+     * @param variance_normalization If the variance normilization should
+     *   be performed or not.
+     * @param frac_bits Number of fractional bits of the features (the scale cancels
+     *   out with variance normalization)
+     * @param scale Quantization scale of the output
+     * @param zero_point Quantization zero point of the output
+     * @param out Output buffer, rows x cols
+     * @returns 0 if OK
+     */
+    __attribute__((unused)) static int cmvnw_quantize(const int32_t *features, uint32_t rows, uint32_t cols, uint32_t first_row,
+        uint16_t win_size, bool variance_normalization, int frac_bits,
+        float scale, int32_t zero_point, int8_t *out)
+    {
+        if (rows == 0 || first_row >= rows || win_size == 0 || scale <= 0.0f) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
         }
 
-        EI_DSP_MATRIX(window_variance, vec_pad.cols, 1);
-        if (!window_variance.buffer) {
-            return EIDSP_OUT_OF_MEM;
+        const int32_t pad_size = (win_size - 1) / 2;
+        const int64_t w = win_size;
+        // 1 / scale in Q16
+        const int64_t inv_scale = static_cast<int64_t>(round(65536.0 / static_cast<double>(scale)));
+
+        // prefix sums of the (shifted) column, and of its squares
+        const size_t prefix_bytes = 2 * (rows + 1) * sizeof(int64_t);
+        int64_t *prefix_sum = (int64_t*)ei_dsp_malloc(prefix_bytes);
+        if (!prefix_sum) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
         }
+        int64_t *prefix_sq = prefix_sum + rows + 1;
 
-        for (size_t ix = 0; ix < features_matrix->rows; ix++) {
-            // create a slice on the vec_pad
-            EI_DSP_MATRIX_B(window, win_size, vec_pad.cols, vec_pad.buffer + (ix * vec_pad.cols));
-            if (!window.buffer) {
-                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        for (uint32_t col = 0; col < cols; col++) {
+            // shift by the column mean first, keeps the sums of squares small
+            int64_t shift = 0;
+            for (uint32_t ix = 0; ix < rows; ix++) {
+                shift += features[((first_row + ix) % rows) * cols + col];
             }
-
-            ret = numpy::mean_axis0(&window, &mean_matrix);
-            if (ret != EIDSP_OK) {
-                EIDSP_ERR(ret);
+            shift /= static_cast<int64_t>(rows);
+
+            prefix_sum[0] = 0;
+            prefix_sq[0] = 0;
+            for (uint32_t ix = 0; ix < rows; ix++) {
+                int64_t v = features[((first_row + ix) % rows) * cols + col] - shift;
+                prefix_sum[ix + 1] = prefix_sum[ix] + v;
+                prefix_sq[ix + 1] = prefix_sq[ix] + (v * v);
             }
 
-            if (variance_normalization == true) {
-                ret = numpy::std_axis0(&window, &window_variance);
-                if (ret != EIDSP_OK) {
-                    EIDSP_ERR(ret);
+            for (uint32_t ix = 0; ix < rows; ix++) {
+                int32_t win_start = static_cast<int32_t>(ix) - pad_size;
+                int32_t win_end = win_start + win_size;
+
+                int64_t sum = cmvnw_extended_sum(prefix_sum, rows, win_end) -
+                    cmvnw_extended_sum(prefix_sum, rows, win_start);
+                int64_t v = features[((first_row + ix) % rows) * cols + col] - shift;
+
+                // (v - mean) * win_size
+                int64_t num = (v * w) - sum;
+                int64_t den;
+
+                if (variance_normalization == true) {
+                    int64_t sum_sq = cmvnw_extended_sum(prefix_sq, rows, win_end) -
+                        cmvnw_extended_sum(prefix_sq, rows, win_start);
+
+                    // variance * win_size^2, exact
+                    int64_t d = (sum_sq * w) - (sum * sum);
+                    if (d <= 0) {
+                        out[ix * cols + col] = static_cast<int8_t>(fixed_point::saturate(zero_point, -128, 127));
+                        continue;
+                    }
+
+                    // sqrt(d) * 2^16, keeping as many bits of the root as fit
+                    int k = (62 - fixed_point::msb(static_cast<uint64_t>(d))) / 2;
+                    if (k > 16) {
+                        k = 16;
+                    }
+                    den = static_cast<int64_t>(fixed_point::sqrt(static_cast<uint64_t>(d) << (2 * k))) << (16 - k);
                 }
-
-                features_buffer_ptr = &features_matrix->buffer[ix * vec_pad.cols];
-                for (size_t col = 0; col < vec_pad.cols; col++) {
-                    *(features_buffer_ptr) = (*(features_buffer_ptr)-mean_matrix.buffer[col]) /
-                                             (window_variance.buffer[col] + FLT_EPSILON);
-                    features_buffer_ptr++;
+                else {
+                    den = w << (frac_bits + 16);
                 }
-            }
 
-            else {
-                features_buffer_ptr = &features_matrix->buffer[ix * vec_pad.cols];
-                for (size_t col = 0; col < vec_pad.cols; col++) {
-                    *(features_buffer_ptr) = *(features_buffer_ptr)-mean_matrix.buffer[col];
-                    features_buffer_ptr++;
-                }
+                int64_t q = fixed_point::round_div(num * inv_scale, den) + zero_point;
+                out[ix * cols + col] = static_cast<int8_t>(fixed_point::saturate(q, -128, 127));
             }
         }
+
+        ei_dsp_free(prefix_sum, prefix_bytes);
+
         return EIDSP_OK;
     }
 };
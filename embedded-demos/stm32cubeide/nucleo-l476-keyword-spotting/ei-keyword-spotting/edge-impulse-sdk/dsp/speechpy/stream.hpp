@@ -0,0 +1,466 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_SPEECHPY_STREAM_H_
+#define _EIDSP_SPEECHPY_STREAM_H_
+
+#include <stdint.h>
+
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/memory.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/feature.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/functions.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/processing.hpp"
+
+namespace ei {
+namespace speechpy {
+
+// the parameters an MFCC stream was set up with, as passed to mfcc_stream::init
+typedef struct ei_mfcc_stream_config {
+    uint32_t sampling_frequency;
+    float frame_length;
+    float frame_stride;
+    uint8_t num_cepstral;
+    uint16_t num_filters;
+    uint16_t fft_length;
+    uint32_t low_frequency;
+    uint32_t high_frequency;
+    int pre_shift;
+    float pre_cof;
+
+    bool operator==(const ei_mfcc_stream_config &other) const {
+        return sampling_frequency == other.sampling_frequency &&
+            frame_length == other.frame_length &&
+            frame_stride == other.frame_stride &&
+            num_cepstral == other.num_cepstral &&
+            num_filters == other.num_filters &&
+            fft_length == other.fft_length &&
+            low_frequency == other.low_frequency &&
+            high_frequency == other.high_frequency &&
+            pre_shift == other.pre_shift &&
+            pre_cof == other.pre_cof;
+    }
+} mfcc_stream_config_t;
+
+/**
+ * Streaming MFCC front end. Audio is pushed in arbitrary sized blocks
+ * (f.e. one slice for continuous inferencing), and every frame is calculated
+ * exactly once, as soon as all of its samples are available. The tail of
+ * the previous block (for overlapping frames) and the pre-emphasis history
+ * are carried over between calls, so the output for a run of frames matches
+ * `feature::mfcc` over the same samples, without wrapping pre-emphasis around
+ * to the end of a slice.
+ */
+class mfcc_stream {
+public:
+    mfcc_stream()
+        : _frame(NULL)
+    {
+    }
+
+    ~mfcc_stream() {
+        free_buffers();
+    }
+
+    // owns its buffers, a copy would free them a second time
+    mfcc_stream(const mfcc_stream &) = delete;
+    mfcc_stream &operator=(const mfcc_stream &) = delete;
+
+    /**
+     * Configure the stream. Can be called again to re-configure.
+     * @param sampling_frequency (int): the sampling frequency of the signal
+     * @param frame_length (float): the length of each frame in seconds.
+     * @param frame_stride (float): the step between successive frames in seconds.
+     * @param num_cepstral (int): Number of cepstral coefficients.
+     * @param num_filters (int): the number of filters in the filterbank
+     * @param fft_length (int): number of FFT points.
+     * @param low_frequency (int): lowest band edge of mel filters (in Hz)
+     * @param high_frequency (int): highest band edge of mel filters (in Hz),
+     *     0 means samplerate / 2
+     * @param pre_shift (int): The pre-emphasis shift step.
+     * @param pre_cof (float): The pre-emphasis coefficient. 0 equals to no filtering.
+     * @returns EIDSP_OK if OK
+     */
+    int init(uint32_t sampling_frequency, float frame_length, float frame_stride,
+        uint8_t num_cepstral, uint16_t num_filters, uint16_t fft_length,
+        uint32_t low_frequency, uint32_t high_frequency,
+        int pre_shift, float pre_cof)
+    {
+        // the stream buffers outlive the extract_* call that may init the stream
+        scratch_arena::bypass bypass;
+
+        free_buffers();
+
+        // same rounding as processing::stack_frames
+        int frame_sample_length = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_length));
+        int frame_sample_stride = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_stride));
+
+        if (frame_sample_length <= 0 || frame_sample_stride <= 0 || pre_shift < 0 ||
+            num_cepstral > num_filters) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        _sampling_frequency = sampling_frequency;
+        _frame_length = static_cast<size_t>(frame_sample_length);
+        _frame_stride = static_cast<size_t>(frame_sample_stride);
+        _num_cepstral = num_cepstral;
+        _num_filters = num_filters;
+        _fft_length = fft_length;
+        _low_frequency = low_frequency;
+        _high_frequency = high_frequency == 0 ? sampling_frequency / 2 : high_frequency;
+        _pre_shift = static_cast<size_t>(pre_shift);
+        _pre_cof = pre_cof;
+
+        _frame = (float*)ei_dsp_calloc(_frame_length * sizeof(float), 1);
+        if (!_frame) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        int ret = _pre_filter.init(_pre_shift, _pre_cof);
+        if (ret != EIDSP_OK) {
+            free_buffers();
+            EIDSP_ERR(ret);
+        }
+
+        mfcc_stream_config_t config = { sampling_frequency, frame_length, frame_stride, num_cepstral,
+            num_filters, fft_length, low_frequency, high_frequency, pre_shift, pre_cof };
+        _config = config;
+
+        reset();
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Whether init() was called successfully
+     */
+    bool is_initialized() {
+        return _frame != NULL;
+    }
+
+    /**
+     * Whether init() was called successfully with these parameters
+     */
+    bool is_initialized(const mfcc_stream_config_t &config) {
+        return is_initialized() && _config == config;
+    }
+
+    /**
+     * Drop all buffered samples and the pre-emphasis history,
+     * f.e. when there was a gap in the audio stream.
+     */
+    void reset() {
+        _frame_fill = 0;
+        _skip = 0;
+        _pre_filter.reset();
+    }
+
+    /**
+     * Number of bytes of scratch memory (see scratch_arena) that process() needs per frame
+     */
+    size_t scratch_size() {
+        return scratch_arena::size_of((_fft_length / 2 + 1) * sizeof(float)) +
+            scratch_arena::size_of(_num_filters * sizeof(float));
+    }
+
+    /**
+     * Maximum number of frames that process() can return for a block
+     * of `signal_length` samples, use this to size the output matrix.
+     * @param signal_length Number of samples pushed in one call
+     */
+    size_t calculate_max_frames(size_t signal_length) {
+        if (signal_length == 0 || _frame_stride == 0) {
+            return 0;
+        }
+        return (signal_length + _frame_stride - 1) / _frame_stride;
+    }
+
+    /**
+     * Number of frames that process() will return for a block of
+     * `signal_length` samples, given the samples that are already buffered.
+     * @param signal_length Number of samples that will be pushed
+     */
+    size_t calculate_no_of_frames(size_t signal_length) {
+        if (signal_length < _skip) {
+            return 0;
+        }
+        size_t available = signal_length - _skip;
+        size_t needed = _frame_length - _frame_fill;
+        if (available < needed) {
+            return 0;
+        }
+        return 1 + ((available - needed) / _frame_stride);
+    }
+
+    /**
+     * Push a block of audio through the stream.
+     * @param signal Audio signal, all `signal->total_length` samples are consumed
+     * @param out_features Output matrix, one row per completed frame. Needs room for at
+     *     least `calculate_max_frames(signal->total_length)` rows of num_cepstral columns.
+     *     On return rows holds the number of frames that were calculated (can be 0).
+     * @returns EIDSP_OK if OK
+     */
+    int process(signal_t *signal, matrix_t *out_features) {
+        if (!is_initialized()) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        size_t frame_count = calculate_no_of_frames(signal->total_length);
+        if (out_features->rows * out_features->cols < frame_count * _num_cepstral) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        int ret = process_frames(signal, out_features->buffer,
+            (out_features->rows * out_features->cols) / _num_cepstral, 0, &frame_count);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        out_features->rows = frame_count;
+        out_features->cols = _num_cepstral;
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Push a block of audio through the stream, and write the frames into a
+     * circular buffer of frames (f.e. the feature window for continuous inferencing).
+     * @param signal Audio signal, all `signal->total_length` samples are consumed
+     * @param out_features Circular buffer with one row of num_cepstral columns per frame
+     * @param out_row Row to write the first completed frame to, writing wraps around
+     *     to row 0 at the end of the buffer
+     * @param out_frames Number of frames that were written (can be 0)
+     * @returns EIDSP_OK if OK
+     */
+    int process(signal_t *signal, matrix_t *out_features, size_t out_row, size_t *out_frames) {
+        if (!is_initialized()) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        if (out_features->cols != _num_cepstral || out_row >= out_features->rows) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        return process_frames(signal, out_features->buffer, out_features->rows, out_row, out_frames);
+    }
+
+private:
+    int process_frames(signal_t *signal, float *out_buffer, size_t out_rows, size_t out_row, size_t *out_frames) {
+        size_t frame_count = calculate_no_of_frames(signal->total_length);
+        if (frame_count > out_rows) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        int ret;
+
+        if (frame_count == 0) {
+            ret = consume(signal, NULL, NULL, 0, 0);
+        }
+        else {
+            const uint16_t coefficients = _fft_length / 2 + 1;
+
+            // only look up the filterbank when at least one frame completes
+            const sparse_filterbank_t *filterbank;
+            ret = feature::sparse_filterbank(
+                &filterbank, _num_filters, coefficients, _sampling_frequency, _low_frequency, _high_frequency);
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+
+            ret = consume(signal, filterbank, out_buffer, out_rows, out_row);
+        }
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        *out_frames = frame_count;
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Read all samples from the signal into the frame buffer, and calculate every
+     * frame that completes. Frames are written to row `out_row` onwards of out_buffer,
+     * wrapping around after `out_rows` rows. `filterbank` and `out_buffer` may only
+     * be NULL when no frame completes.
+     */
+    int consume(signal_t *signal, const sparse_filterbank_t *filterbank, float *out_buffer, size_t out_rows, size_t out_row) {
+        int ret;
+        size_t offset = 0;
+
+        while (offset < signal->total_length) {
+            size_t left = signal->total_length - offset;
+
+            // frame_stride > frame_length, samples between frames are dropped
+            if (_skip > 0) {
+                size_t skip = _skip < left ? _skip : left;
+                ret = push_history(signal, offset, skip);
+                if (ret != EIDSP_OK) {
+                    EIDSP_ERR(ret);
+                }
+                _skip -= skip;
+                offset += skip;
+                continue;
+            }
+
+            size_t length = _frame_length - _frame_fill;
+            if (length > left) {
+                length = left;
+            }
+
+            ret = _pre_filter.read(signal, offset, length, _frame + _frame_fill);
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+
+            _frame_fill += length;
+            offset += length;
+
+            if (_frame_fill < _frame_length) {
+                break;
+            }
+
+            if (!filterbank || !out_buffer) {
+                EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+            }
+
+            ret = calculate_frame(filterbank, out_buffer + (out_row * _num_cepstral));
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+            if (++out_row == out_rows) {
+                out_row = 0;
+            }
+
+            // keep the overlap with the next frame
+            if (_frame_stride < _frame_length) {
+                memmove(_frame, _frame + _frame_stride, (_frame_length - _frame_stride) * sizeof(float));
+                _frame_fill = _frame_length - _frame_stride;
+            }
+            else {
+                _frame_fill = 0;
+                _skip = _frame_stride - _frame_length;
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Calculate the cepstral coefficients for the frame in _frame. Uses the same
+     * steps (in the same order) as feature::mfe and feature::mfcc, so the results
+     * are identical to the batch version.
+     */
+    int calculate_frame(const sparse_filterbank_t *filterbank, float *out_buffer) {
+        const size_t coefficients = _fft_length / 2 + 1;
+
+        EI_DSP_MATRIX(power_spectrum_frame, 1, coefficients);
+        EI_DSP_MATRIX(mel_frame, 1, _num_filters);
+
+        float energy;
+        int ret = processing::power_spectrum(
+            _frame, _frame_length, power_spectrum_frame.buffer, coefficients, _fft_length, &energy);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        if (energy == 0) {
+            energy = FLT_EPSILON;
+        }
+
+        ret = feature::mel_energies(filterbank, power_spectrum_frame.buffer, coefficients, mel_frame.buffer);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        ret = numpy::log(&mel_frame, true);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        ret = numpy::dct2_truncated(mel_frame.buffer, _num_filters, out_buffer, _num_cepstral);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        // replace first cepstral coefficient with log of frame energy for DC elimination
+        out_buffer[0] = numpy::log(energy);
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Samples that are skipped (not part of any frame) still go into the pre-emphasis history
+     */
+    int push_history(signal_t *signal, size_t offset, size_t length) {
+        if (_pre_shift == 0) {
+            return EIDSP_OK;
+        }
+
+        if (length > _pre_shift) {
+            offset += length - _pre_shift;
+            length = _pre_shift;
+        }
+
+        float samples[16];
+        while (length > 0) {
+            size_t count = length < 16 ? length : 16;
+            int ret = signal->get_data(offset, count, samples);
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+            _pre_filter.push_history(samples, count);
+            offset += count;
+            length -= count;
+        }
+
+        return EIDSP_OK;
+    }
+
+    void free_buffers() {
+        if (_frame) {
+            ei_dsp_free(_frame, _frame_length * sizeof(float));
+            _frame = NULL;
+        }
+    }
+
+    uint32_t _sampling_frequency;
+    size_t _frame_length;
+    size_t _frame_stride;
+    uint8_t _num_cepstral;
+    uint16_t _num_filters;
+    uint16_t _fft_length;
+    uint32_t _low_frequency;
+    uint32_t _high_frequency;
+    size_t _pre_shift;
+    float _pre_cof;
+    mfcc_stream_config_t _config;
+
+    float *_frame;
+    size_t _frame_fill;
+    size_t _skip;
+    processing::preemphasis_filter _pre_filter;
+};
+
+} // namespace speechpy
+} // namespace ei
+
+#endif // _EIDSP_SPEECHPY_STREAM_H_
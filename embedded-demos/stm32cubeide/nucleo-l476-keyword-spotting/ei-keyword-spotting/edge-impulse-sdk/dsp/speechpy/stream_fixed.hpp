@@ -0,0 +1,574 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _EIDSP_SPEECHPY_STREAM_FIXED_H_
+#define _EIDSP_SPEECHPY_STREAM_FIXED_H_
+
+#include <stdint.h>
+
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/fixed_point.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/memory.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/feature.hpp"
+#include "../../../../ei-keyword-spotting/edge-impulse-sdk/dsp/speechpy/stream.hpp"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846264338327950288
+#endif // M_PI
+
+namespace ei {
+namespace speechpy {
+
+/**
+ * Integer version of mfcc_stream, used when EIDSP_USE_FIXED_POINT is set.
+ * Frames are cut the same way, but every step after reading the samples runs on
+ * integers: pre-emphasis into Q30, a block floating point real FFT (fixed_rfft),
+ * mel energies with Q15 weights, a table based log and a DCT with a Q15 basis.
+ * The cepstral coefficients are written as int32 with `frac_bits` fractional bits.
+ *
+ * The signal is read through get_data_int16 when it's set (see signal_t), otherwise
+ * it's expected in -1..1 (what numpy::int16_to_float produces) and is converted back
+ * to int16 when it's read, so for 16-bit audio no precision is lost either way.
+ */
+class mfcc_stream_fixed {
+public:
+    /**
+     * Number of fractional bits of the cepstral coefficients
+     */
+    static const int frac_bits = 12;
+
+    mfcc_stream_fixed()
+        : _frame(NULL), _pre_history(NULL), _spectrum(NULL), _power(NULL),
+          _filter_start(NULL), _filter_length(NULL), _filter_weights(NULL), _filter_weights_size(0),
+          _log_mel(NULL), _dct_basis(NULL)
+    {
+    }
+
+    ~mfcc_stream_fixed() {
+        free_buffers();
+    }
+
+    // owns its buffers, a copy would free them a second time
+    mfcc_stream_fixed(const mfcc_stream_fixed &) = delete;
+    mfcc_stream_fixed &operator=(const mfcc_stream_fixed &) = delete;
+
+    /**
+     * Configure the stream. Can be called again to re-configure.
+     * Takes the same parameters as mfcc_stream::init, fft_length needs to be a power of 2.
+     * @returns EIDSP_OK if OK
+     */
+    int init(uint32_t sampling_frequency, float frame_length, float frame_stride,
+        uint8_t num_cepstral, uint16_t num_filters, uint16_t fft_length,
+        uint32_t low_frequency, uint32_t high_frequency,
+        int pre_shift, float pre_cof)
+    {
+        // the stream buffers outlive the extract_* call that may init the stream
+        scratch_arena::bypass bypass;
+
+        free_buffers();
+
+        // same rounding as processing::stack_frames
+        int frame_sample_length = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_length));
+        int frame_sample_stride = static_cast<int>(round(static_cast<float>(sampling_frequency) * frame_stride));
+
+        if (frame_sample_length <= 0 || frame_sample_stride <= 0 || pre_shift < 0 ||
+            num_cepstral > num_filters || num_filters == 0 || pre_cof < 0.0f || pre_cof > 1.0f) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        _frame_length = static_cast<size_t>(frame_sample_length);
+        _frame_stride = static_cast<size_t>(frame_sample_stride);
+        _num_cepstral = num_cepstral;
+        _num_filters = num_filters;
+        _pre_shift = static_cast<size_t>(pre_shift);
+        _pre_cof_q30 = static_cast<int32_t>(round(static_cast<double>(pre_cof) * 1073741824.0));
+
+        int ret = _fft.init(fft_length);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        const size_t coefficients = fft_length / 2 + 1;
+
+        _frame = (int32_t*)ei_dsp_calloc(_frame_length * sizeof(int32_t), 1);
+        _spectrum = (int32_t*)ei_dsp_calloc(coefficients * 2 * sizeof(int32_t), 1);
+        _power = (uint32_t*)ei_dsp_calloc(coefficients * sizeof(uint32_t), 1);
+        _log_mel = (int32_t*)ei_dsp_calloc(_num_filters * sizeof(int32_t), 1);
+        _dct_basis = (int16_t*)ei_dsp_calloc(_num_cepstral * _num_filters * sizeof(int16_t), 1);
+        if (!_frame || !_spectrum || !_power || !_log_mel || !_dct_basis) {
+            free_buffers();
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        if (_pre_shift > 0) {
+            _pre_history = (int16_t*)ei_dsp_calloc(_pre_shift * sizeof(int16_t), 1);
+            if (!_pre_history) {
+                free_buffers();
+                EIDSP_ERR(EIDSP_OUT_OF_MEM);
+            }
+        }
+
+        ret = init_filterbank(sampling_frequency, coefficients,
+            low_frequency, high_frequency == 0 ? sampling_frequency / 2 : high_frequency);
+        if (ret != EIDSP_OK) {
+            free_buffers();
+            EIDSP_ERR(ret);
+        }
+
+        init_dct_basis();
+
+        mfcc_stream_config_t config = { sampling_frequency, frame_length, frame_stride, num_cepstral,
+            num_filters, fft_length, low_frequency, high_frequency, pre_shift, pre_cof };
+        _config = config;
+
+        reset();
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Whether init() was called successfully
+     */
+    bool is_initialized() {
+        return _frame != NULL;
+    }
+
+    /**
+     * Whether init() was called successfully with these parameters
+     */
+    bool is_initialized(const mfcc_stream_config_t &config) {
+        return is_initialized() && _config == config;
+    }
+
+    /**
+     * Drop all buffered samples and the pre-emphasis history,
+     * f.e. when there was a gap in the audio stream.
+     */
+    void reset() {
+        _frame_fill = 0;
+        _skip = 0;
+        _pre_history_ix = 0;
+        if (_pre_history) {
+            memset(_pre_history, 0, _pre_shift * sizeof(int16_t));
+        }
+    }
+
+    /**
+     * Number of frames that process() will return for a block of
+     * `signal_length` samples, given the samples that are already buffered.
+     * @param signal_length Number of samples that will be pushed
+     */
+    size_t calculate_no_of_frames(size_t signal_length) {
+        if (signal_length < _skip) {
+            return 0;
+        }
+        size_t available = signal_length - _skip;
+        size_t needed = _frame_length - _frame_fill;
+        if (available < needed) {
+            return 0;
+        }
+        return 1 + ((available - needed) / _frame_stride);
+    }
+
+    /**
+     * Push a block of audio through the stream, and write the frames into a
+     * circular buffer of frames (f.e. the feature window for continuous inferencing).
+     * @param signal Audio signal, all `signal->total_length` samples are consumed
+     * @param out_buffer Circular buffer with one row of num_cepstral coefficients per frame
+     * @param out_rows Number of rows in out_buffer
+     * @param out_row Row to write the first completed frame to, writing wraps around
+     *     to row 0 at the end of the buffer
+     * @param out_frames Number of frames that were written (can be 0)
+     * @returns EIDSP_OK if OK
+     */
+    int process(signal_t *signal, int32_t *out_buffer, size_t out_rows, size_t out_row, size_t *out_frames) {
+        if (!is_initialized()) {
+            EIDSP_ERR(EIDSP_PARAMETER_INVALID);
+        }
+
+        size_t frame_count = calculate_no_of_frames(signal->total_length);
+        if (out_row >= out_rows || frame_count > out_rows) {
+            EIDSP_ERR(EIDSP_MATRIX_SIZE_MISMATCH);
+        }
+
+        int ret = consume(signal, out_buffer, out_rows, out_row);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        *out_frames = frame_count;
+
+        return EIDSP_OK;
+    }
+
+private:
+    /**
+     * Read all samples from the signal into the frame buffer, and calculate every
+     * frame that completes, see mfcc_stream::consume.
+     */
+    int consume(signal_t *signal, int32_t *out_buffer, size_t out_rows, size_t out_row) {
+        int ret;
+        size_t offset = 0;
+
+        while (offset < signal->total_length) {
+            size_t left = signal->total_length - offset;
+
+            // frame_stride > frame_length, samples between frames are dropped
+            if (_skip > 0) {
+                size_t skip = _skip < left ? _skip : left;
+                ret = push_history(signal, offset, skip);
+                if (ret != EIDSP_OK) {
+                    EIDSP_ERR(ret);
+                }
+                _skip -= skip;
+                offset += skip;
+                continue;
+            }
+
+            size_t length = _frame_length - _frame_fill;
+            if (length > left) {
+                length = left;
+            }
+
+            ret = read_preemphasized(signal, offset, length, _frame + _frame_fill);
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+
+            _frame_fill += length;
+            offset += length;
+
+            if (_frame_fill < _frame_length) {
+                break;
+            }
+
+            ret = calculate_frame(out_buffer + (out_row * _num_cepstral));
+            if (ret != EIDSP_OK) {
+                EIDSP_ERR(ret);
+            }
+            if (++out_row == out_rows) {
+                out_row = 0;
+            }
+
+            // keep the overlap with the next frame
+            if (_frame_stride < _frame_length) {
+                memmove(_frame, _frame + _frame_stride, (_frame_length - _frame_stride) * sizeof(int32_t));
+                _frame_fill = _frame_length - _frame_stride;
+            }
+            else {
+                _frame_fill = 0;
+                _skip = _frame_stride - _frame_length;
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Cepstral coefficients for the frame in _frame (Q30, see read_preemphasized).
+     * Follows the steps of mfcc_stream::calculate_frame, scales are tracked
+     * as binary exponents next to the integers.
+     */
+    int calculate_frame(int32_t *out_buffer) {
+        const size_t n_fft = _fft.size();
+        const size_t coefficients = n_fft / 2 + 1;
+
+        int fft_exponent;
+        int ret = _fft.transform(_frame, _frame_length, _spectrum, &fft_exponent);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        // |X|^2, then drop the bits that don't fit in 32 bits
+        uint64_t max_power = 0;
+        for (size_t ix = 0; ix < coefficients; ix++) {
+            int64_t re = _spectrum[ix * 2];
+            int64_t im = _spectrum[ix * 2 + 1];
+            uint64_t p = static_cast<uint64_t>(re * re) + static_cast<uint64_t>(im * im);
+            if (p > max_power) {
+                max_power = p;
+            }
+        }
+        int power_shift = fixed_point::msb(max_power) - 31;
+        if (power_shift < 0) {
+            power_shift = 0;
+        }
+
+        uint64_t energy = 0;
+        for (size_t ix = 0; ix < coefficients; ix++) {
+            int64_t re = _spectrum[ix * 2];
+            int64_t im = _spectrum[ix * 2 + 1];
+            _power[ix] = static_cast<uint32_t>(
+                (static_cast<uint64_t>(re * re) + static_cast<uint64_t>(im * im)) >> power_shift);
+            energy += _power[ix];
+        }
+
+        // power = |DFT(frame)|^2 / n_fft, DFT(frame) = X * 2^(fft_exponent - 30)
+        int log2_n = fixed_point::msb(static_cast<uint32_t>(n_fft));
+        int power_exponent = (2 * (fft_exponent - 30)) - log2_n + power_shift;
+
+        // mel energies (Q15 weights), straight into the log
+        const uint16_t *weights = _filter_weights;
+        for (size_t ix = 0; ix < _num_filters; ix++) {
+            const uint32_t *power = _power + _filter_start[ix];
+            uint64_t mel = 0;
+            for (size_t jx = 0; jx < _filter_length[ix]; jx++) {
+                mel += static_cast<uint64_t>(weights[jx]) * power[jx];
+            }
+            weights += _filter_length[ix];
+
+            _log_mel[ix] = fixed_point::ln_q16(mel, power_exponent - 15);
+        }
+
+        // DCT, Q15 basis * Q16 log mel energies
+        for (size_t ix = 0; ix < _num_cepstral; ix++) {
+            const int16_t *basis = _dct_basis + (ix * _num_filters);
+            int64_t sum = 0;
+            for (size_t jx = 0; jx < _num_filters; jx++) {
+                sum += static_cast<int64_t>(basis[jx]) * _log_mel[jx];
+            }
+            out_buffer[ix] = static_cast<int32_t>(fixed_point::round_shift(sum, 15 + 16 - frac_bits));
+        }
+
+        // replace first cepstral coefficient with log of frame energy for DC elimination
+        if (_num_cepstral > 0) {
+            out_buffer[0] = static_cast<int32_t>(fixed_point::round_shift(
+                fixed_point::ln_q16(energy, power_exponent), 16 - frac_bits));
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Convert a sample in -1..1 back to int16
+     */
+    static inline int16_t to_int16(float sample) {
+        return static_cast<int16_t>(fixed_point::saturate(
+            static_cast<int64_t>(round(sample * 32768.0f)), INT16_MIN, INT16_MAX));
+    }
+
+    /**
+     * Read up to 32 samples as int16, straight from get_data_int16 if the signal has it
+     */
+    static int read_int16(signal_t *signal, size_t offset, size_t length, int16_t *out) {
+#if EIDSP_SIGNAL_C_FN_POINTER == 0
+        if (signal->get_data_int16) {
+            return signal->get_data_int16(offset, length, out);
+        }
+#endif
+
+        float buffer[32];
+        int ret = signal->get_data(offset, length, buffer);
+        if (ret != 0) {
+            return ret;
+        }
+        for (size_t ix = 0; ix < length; ix++) {
+            out[ix] = to_int16(buffer[ix]);
+        }
+        return 0;
+    }
+
+    /**
+     * Read samples, and pre-emphasize them into Q30:
+     * y[n] = x[n] - cof * x[n - shift], with x in Q15 and cof in Q30.
+     */
+    int read_preemphasized(signal_t *signal, size_t offset, size_t length, int32_t *out) {
+        int16_t buffer[32];
+
+        while (length > 0) {
+            size_t chunk = length > 32 ? 32 : length;
+
+            int ret = read_int16(signal, offset, chunk, buffer);
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+
+            for (size_t ix = 0; ix < chunk; ix++) {
+                int16_t now = buffer[ix];
+                // Q45
+                int64_t y = static_cast<int64_t>(now) << 30;
+                if (_pre_shift > 0) {
+                    y -= static_cast<int64_t>(_pre_cof_q30) * _pre_history[_pre_history_ix];
+                    _pre_history[_pre_history_ix] = now;
+                    if (++_pre_history_ix == _pre_shift) {
+                        _pre_history_ix = 0;
+                    }
+                }
+                *out++ = fixed_point::saturate(fixed_point::round_shift(y, 15), INT32_MIN, INT32_MAX);
+            }
+
+            offset += chunk;
+            length -= chunk;
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Samples that are skipped (not part of any frame) still go into the pre-emphasis history
+     */
+    int push_history(signal_t *signal, size_t offset, size_t length) {
+        if (_pre_shift == 0) {
+            return EIDSP_OK;
+        }
+
+        if (length > _pre_shift) {
+            offset += length - _pre_shift;
+            length = _pre_shift;
+        }
+
+        for (size_t ix = 0; ix < length; ix++) {
+            int16_t sample;
+            int ret = read_int16(signal, offset + ix, 1, &sample);
+            if (ret != 0) {
+                EIDSP_ERR(ret);
+            }
+            _pre_history[_pre_history_ix] = sample;
+            if (++_pre_history_ix == _pre_shift) {
+                _pre_history_ix = 0;
+            }
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Copy the sparse mel filterbank with the weights in Q15. This is a private copy
+     * rather than a reference into the filterbank cache, which may evict it.
+     */
+    int init_filterbank(uint32_t sampling_frequency, size_t coefficients,
+        uint32_t low_frequency, uint32_t high_frequency)
+    {
+        const sparse_filterbank_t *filterbank;
+        int ret = feature::sparse_filterbank(&filterbank, _num_filters, coefficients,
+            sampling_frequency, low_frequency, high_frequency);
+        if (ret != EIDSP_OK) {
+            EIDSP_ERR(ret);
+        }
+
+        _filter_weights_size = 0;
+        for (size_t ix = 0; ix < _num_filters; ix++) {
+            _filter_weights_size += filterbank->length[ix];
+        }
+
+        _filter_start = (uint16_t*)ei_dsp_malloc(_num_filters * sizeof(uint16_t));
+        _filter_length = (uint16_t*)ei_dsp_malloc(_num_filters * sizeof(uint16_t));
+        _filter_weights = (uint16_t*)ei_dsp_malloc((_filter_weights_size > 0 ? _filter_weights_size : 1) * sizeof(uint16_t));
+        if (!_filter_start || !_filter_length || !_filter_weights) {
+            EIDSP_ERR(EIDSP_OUT_OF_MEM);
+        }
+
+        memcpy(_filter_start, filterbank->start, _num_filters * sizeof(uint16_t));
+        memcpy(_filter_length, filterbank->length, _num_filters * sizeof(uint16_t));
+        for (size_t ix = 0; ix < _filter_weights_size; ix++) {
+            _filter_weights[ix] = static_cast<uint16_t>(fixed_point::saturate(
+                static_cast<int64_t>(round(filterbank->weights[ix] * 32768.0f)), 0, 32768));
+        }
+
+        return EIDSP_OK;
+    }
+
+    /**
+     * Orthonormal DCT-II basis in Q15 (the same normalization as
+     * numpy::dct2 with DCT_NORMALIZATION_ORTHO), only the rows that are kept.
+     */
+    void init_dct_basis() {
+        const double n = static_cast<double>(_num_filters);
+
+        for (size_t k = 0; k < _num_cepstral; k++) {
+            double scale = k == 0 ? sqrt(1.0 / n) : sqrt(2.0 / n);
+            for (size_t ix = 0; ix < _num_filters; ix++) {
+                double v = scale * cos(M_PI * static_cast<double>(k) * (2.0 * ix + 1.0) / (2.0 * n));
+                _dct_basis[k * _num_filters + ix] = static_cast<int16_t>(fixed_point::saturate(
+                    static_cast<int64_t>(round(v * 32768.0)), INT16_MIN, INT16_MAX));
+            }
+        }
+    }
+
+    void free_buffers() {
+        if (_frame) {
+            ei_dsp_free(_frame, _frame_length * sizeof(int32_t));
+            _frame = NULL;
+        }
+        if (_pre_history) {
+            ei_dsp_free(_pre_history, _pre_shift * sizeof(int16_t));
+            _pre_history = NULL;
+        }
+        if (_spectrum) {
+            ei_dsp_free(_spectrum, (_fft.size() + 2) * sizeof(int32_t));
+            _spectrum = NULL;
+        }
+        if (_power) {
+            ei_dsp_free(_power, (_fft.size() / 2 + 1) * sizeof(uint32_t));
+            _power = NULL;
+        }
+        if (_filter_start) {
+            ei_dsp_free(_filter_start, _num_filters * sizeof(uint16_t));
+            _filter_start = NULL;
+        }
+        if (_filter_length) {
+            ei_dsp_free(_filter_length, _num_filters * sizeof(uint16_t));
+            _filter_length = NULL;
+        }
+        if (_filter_weights) {
+            ei_dsp_free(_filter_weights, (_filter_weights_size > 0 ? _filter_weights_size : 1) * sizeof(uint16_t));
+            _filter_weights = NULL;
+        }
+        if (_log_mel) {
+            ei_dsp_free(_log_mel, _num_filters * sizeof(int32_t));
+            _log_mel = NULL;
+        }
+        if (_dct_basis) {
+            ei_dsp_free(_dct_basis, _num_cepstral * _num_filters * sizeof(int16_t));
+            _dct_basis = NULL;
+        }
+    }
+
+    size_t _frame_length;
+    size_t _frame_stride;
+    uint8_t _num_cepstral;
+    uint16_t _num_filters;
+    size_t _pre_shift;
+    int32_t _pre_cof_q30;
+    mfcc_stream_config_t _config;
+
+    fixed_rfft _fft;
+
+    int32_t *_frame;
+    size_t _frame_fill;
+    size_t _skip;
+    int16_t *_pre_history;
+    size_t _pre_history_ix;
+
+    int32_t *_spectrum;
+    uint32_t *_power;
+    uint16_t *_filter_start;
+    uint16_t *_filter_length;
+    uint16_t *_filter_weights;
+    size_t _filter_weights_size;
+    int32_t *_log_mel;
+    int16_t *_dct_basis;
+};
+
+} // namespace speechpy
+} // namespace ei
+
+#endif // _EIDSP_SPEECHPY_STREAM_FIXED_H_
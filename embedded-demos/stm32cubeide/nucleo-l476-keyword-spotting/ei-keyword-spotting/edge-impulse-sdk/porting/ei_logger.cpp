@@ -0,0 +1,402 @@
+/* Edge Impulse inferencing library
+ * Copyright (c) 2020 EdgeImpulse Inc.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "../../../ei-keyword-spotting/edge-impulse-sdk/porting/ei_logger.h"
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+
+#if (EI_LOGGER_BUFFER_SIZE & (EI_LOGGER_BUFFER_SIZE - 1)) != 0
+#error "EI_LOGGER_BUFFER_SIZE should be a power of two"
+#endif
+
+#if EI_LOGGER_LINE_SIZE > EI_LOGGER_CHUNK_SIZE
+#error "EI_LOGGER_LINE_SIZE should not be larger than EI_LOGGER_CHUNK_SIZE"
+#endif
+
+namespace {
+
+enum {
+    ENTRY_TEXT = 0,             /* formatted message */
+    ENTRY_DEFERRED              /* format string and arguments */
+};
+
+/* Every entry in the ring buffer starts with this header, followed by the message */
+typedef struct {
+    uint16_t length;            /* of the entry, including the header */
+    uint8_t kind;
+    uint8_t arg_count;
+} entry_header_t;
+
+static uint8_t ring[EI_LOGGER_BUFFER_SIZE];
+static std::atomic<uint32_t> ring_head(0);        /* written by the producer */
+static std::atomic<uint32_t> ring_tail(0);        /* written by the consumer */
+
+static std::atomic<uint32_t> messages(0);
+static std::atomic<uint32_t> dropped(0);
+static uint32_t dropped_reported = 0;
+static uint32_t bytes_written = 0;
+
+static const ei_logger_backend_t *logger_backend = NULL;
+
+/*
+ * Two chunks, so the next one can be formatted while the other is being written.
+ * ei_logger_drain formats (chunks_formatted), whoever owns backend_busy starts the
+ * writes (chunks_sent) and ei_logger_write_done completes them (chunks_done).
+ */
+static char chunks[2][EI_LOGGER_CHUNK_SIZE + 1];    /* + 1 for the terminator of snprintf */
+static size_t chunk_lengths[2];
+static std::atomic<uint32_t> chunks_formatted(0);
+static std::atomic<uint32_t> chunks_sent(0);
+static std::atomic<uint32_t> chunks_done(0);
+static std::atomic<bool> backend_busy(false);
+
+static void ring_write(uint32_t position, const void *data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    size_t offset = position & (EI_LOGGER_BUFFER_SIZE - 1);
+    size_t first = EI_LOGGER_BUFFER_SIZE - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(ring + offset, data, first);
+    memcpy(ring, (const uint8_t *)data + first, length - first);
+}
+
+static void ring_read(uint32_t position, void *data, size_t length) {
+    size_t offset = position & (EI_LOGGER_BUFFER_SIZE - 1);
+    size_t first = EI_LOGGER_BUFFER_SIZE - offset;
+    if (first > length) {
+        first = length;
+    }
+    memcpy(data, ring + offset, first);
+    memcpy((uint8_t *)data + first, ring, length - first);
+}
+
+/**
+ * Put an entry (header + two parts of the message) into the ring buffer, or drop it
+ */
+static bool push_entry(uint8_t kind, uint8_t arg_count,
+                       const void *part1, size_t part1_length,
+                       const void *part2, size_t part2_length) {
+    size_t length = sizeof(entry_header_t) + part1_length + part2_length;
+
+    uint32_t head = ring_head.load(std::memory_order_relaxed);
+    uint32_t tail = ring_tail.load(std::memory_order_acquire);
+    if (length > EI_LOGGER_BUFFER_SIZE - (head - tail)) {
+        dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    entry_header_t header = { static_cast<uint16_t>(length), kind, arg_count };
+    ring_write(head, &header, sizeof(header));
+    ring_write(head + sizeof(header), part1, part1_length);
+    ring_write(head + sizeof(header) + part1_length, part2, part2_length);
+
+    ring_head.store(head + length, std::memory_order_release);
+    messages.store(messages.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    return true;
+}
+
+/**
+ * snprintf that appends to out at *length, and keeps counting past the end of out
+ */
+static void append(char *out, size_t size, size_t *length, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(*length < size ? out + *length : NULL, *length < size ? size - *length : 0, format, args);
+    va_end(args);
+    if (n > 0) {
+        *length += n;
+    }
+}
+
+static void append_char(char *out, size_t size, size_t *length, char c) {
+    if (*length + 1 < size) {
+        out[*length] = c;
+    }
+    (*length)++;
+}
+
+/**
+ * Format a deferred message. The length modifiers in the format string are replaced
+ * by the ones that match the stored arguments.
+ * @returns Length of the formatted message (which can be more than size)
+ */
+static size_t format_deferred(char *out, size_t size, const char *format,
+                              const ei_logger_arg_t *args, size_t arg_count) {
+    size_t length = 0;
+    size_t next_arg = 0;
+
+    const char *p = format;
+    while (*p) {
+        if (*p != '%') {
+            append_char(out, size, &length, *p++);
+            continue;
+        }
+        if (p[1] == '%') {
+            append_char(out, size, &length, '%');
+            p += 2;
+            continue;
+        }
+
+        // flags, width and precision are kept, length modifiers are not
+        char spec[16] = { '%' };
+        size_t spec_length = 1;
+        p++;
+        while (*p && strchr("-+ #0123456789.", *p)) {
+            if (spec_length < sizeof(spec) - 4) {
+                spec[spec_length++] = *p;
+            }
+            p++;
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            p++;
+        }
+        char conversion = *p;
+        if (conversion == '\0') {
+            break;
+        }
+        p++;
+
+        if (next_arg >= arg_count) {
+            append_char(out, size, &length, '?');
+            continue;
+        }
+        const ei_logger_arg_t *arg = &args[next_arg++];
+
+        bool is_signed = arg->type == EI_LOGGER_ARG_LONG || arg->type == EI_LOGGER_ARG_LLONG;
+        bool is_long_long = arg->type == EI_LOGGER_ARG_LLONG || arg->type == EI_LOGGER_ARG_ULLONG;
+        long long as_integer =
+            arg->type == EI_LOGGER_ARG_LONG ? arg->value.l :
+            arg->type == EI_LOGGER_ARG_ULONG ? static_cast<long long>(arg->value.ul) :
+            arg->type == EI_LOGGER_ARG_LLONG ? arg->value.ll :
+            arg->type == EI_LOGGER_ARG_ULLONG ? static_cast<long long>(arg->value.ull) :
+            arg->type == EI_LOGGER_ARG_DOUBLE ? static_cast<long long>(arg->value.d) :
+            static_cast<long long>(reinterpret_cast<uintptr_t>(arg->value.p));
+
+        switch (conversion) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+                if (is_long_long) {
+                    spec[spec_length++] = 'l';
+                    spec[spec_length++] = 'l';
+                    spec[spec_length] = conversion;
+                    append(out, size, &length, spec, as_integer);
+                }
+                else {
+                    spec[spec_length++] = 'l';
+                    spec[spec_length] = conversion;
+                    if (is_signed || conversion == 'd' || conversion == 'i') {
+                        append(out, size, &length, spec, static_cast<long>(as_integer));
+                    }
+                    else {
+                        append(out, size, &length, spec, static_cast<unsigned long>(as_integer));
+                    }
+                }
+                break;
+            case 'c':
+                spec[spec_length] = 'c';
+                append(out, size, &length, spec, static_cast<int>(as_integer));
+                break;
+            case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+                spec[spec_length] = conversion;
+                append(out, size, &length, spec,
+                    arg->type == EI_LOGGER_ARG_DOUBLE ? arg->value.d :
+                    is_signed ? static_cast<double>(as_integer) : static_cast<double>(static_cast<unsigned long long>(as_integer)));
+                break;
+            case 's':
+                spec[spec_length] = 's';
+                append(out, size, &length, spec,
+                    arg->type != EI_LOGGER_ARG_STRING ? "?" : (arg->value.s ? arg->value.s : "(null)"));
+                break;
+            case 'p':
+                spec[spec_length] = 'p';
+                append(out, size, &length, spec, arg->value.p);
+                break;
+            default:
+                append_char(out, size, &length, '?');
+                break;
+        }
+    }
+
+    if (size > 0) {
+        out[length < size ? length : size - 1] = '\0';
+    }
+    return length;
+}
+
+/**
+ * Format the messages in the ring buffer into a chunk, as many as fit
+ * @returns Length of the chunk, 0 if there was nothing to write
+ */
+static size_t format_chunk(char *chunk) {
+    size_t length = 0;
+
+    uint32_t dropped_now = dropped.load(std::memory_order_relaxed);
+    if (dropped_now != dropped_reported) {
+        length = snprintf(chunk, EI_LOGGER_CHUNK_SIZE + 1, "[%lu log messages dropped]\r\n",
+                          static_cast<unsigned long>(dropped_now - dropped_reported));
+        dropped_reported = dropped_now;
+    }
+
+    uint32_t tail = ring_tail.load(std::memory_order_relaxed);
+    uint32_t head = ring_head.load(std::memory_order_acquire);
+    while (tail != head) {
+        entry_header_t header;
+        ring_read(tail, &header, sizeof(header));
+
+        size_t available = EI_LOGGER_CHUNK_SIZE - length;
+        size_t message_length;
+        if (header.kind == ENTRY_TEXT) {
+            message_length = header.length - sizeof(header);
+            if (message_length > available) {
+                break;
+            }
+            ring_read(tail + sizeof(header), chunk + length, message_length);
+        }
+        else {
+            const char *format;
+            ei_logger_arg_t args[EI_LOGGER_MAX_ARGS];
+            ring_read(tail + sizeof(header), &format, sizeof(format));
+            ring_read(tail + sizeof(header) + sizeof(format), args, header.arg_count * sizeof(ei_logger_arg_t));
+
+            // if it does not fit in the rest of this chunk, it's formatted again for the next one
+            message_length = format_deferred(chunk + length, available + 1, format, args, header.arg_count);
+            if (message_length > available) {
+                if (length > 0) {
+                    break;
+                }
+                message_length = available;
+            }
+        }
+        length += message_length;
+        tail += header.length;
+    }
+    ring_tail.store(tail, std::memory_order_release);
+
+    return length;
+}
+
+/**
+ * Hand the next formatted chunk to the backend, or give up the backend if there is none.
+ * The caller owns backend_busy. Never formats, so it's safe from the write complete interrupt.
+ */
+static void start_write(void) {
+    uint32_t sent = chunks_sent.load(std::memory_order_relaxed);
+    if (sent == chunks_formatted.load(std::memory_order_acquire)) {
+        backend_busy.store(false, std::memory_order_release);
+        return;
+    }
+    chunks_sent.store(sent + 1, std::memory_order_relaxed);
+    // a blocking backend calls ei_logger_write_done (and so this) again before returning
+    logger_backend->write(chunks[sent & 1], chunk_lengths[sent & 1]);
+}
+
+} // namespace
+
+void ei_logger_init(const ei_logger_backend_t *backend) {
+    logger_backend = backend;
+}
+
+bool ei_logger_vprintf(const char *format, va_list args) {
+    char line[EI_LOGGER_LINE_SIZE];
+    int length = vsnprintf(line, sizeof(line), format, args);
+    if (length <= 0) {
+        return length == 0;
+    }
+    if (length >= (int)sizeof(line)) {
+        length = sizeof(line) - 1;
+    }
+    return push_entry(ENTRY_TEXT, 0, line, length, NULL, 0);
+}
+
+bool ei_logger_printf(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    bool ret = ei_logger_vprintf(format, args);
+    va_end(args);
+    return ret;
+}
+
+bool ei_logger_record(const char *format, const ei_logger_arg_t *args, size_t arg_count) {
+    if (arg_count > EI_LOGGER_MAX_ARGS) {
+        arg_count = EI_LOGGER_MAX_ARGS;
+    }
+    return push_entry(ENTRY_DEFERRED, static_cast<uint8_t>(arg_count),
+                      &format, sizeof(format), args, arg_count * sizeof(ei_logger_arg_t));
+}
+
+void ei_logger_drain(void) {
+    if (!logger_backend) {
+        return;
+    }
+
+    while (true) {
+        // format into the free chunk, if there is one
+        bool formatted = false;
+        uint32_t next = chunks_formatted.load(std::memory_order_relaxed);
+        if (next - chunks_done.load(std::memory_order_acquire) < 2) {
+            size_t length = format_chunk(chunks[next & 1]);
+            if (length > 0) {
+                chunk_lengths[next & 1] = length;
+                bytes_written += length;
+                chunks_formatted.store(next + 1, std::memory_order_release);
+                formatted = true;
+            }
+        }
+
+        // if the backend is idle, nothing will start the write from the interrupt
+        bool idle = false;
+        if (backend_busy.compare_exchange_strong(idle, true, std::memory_order_acquire)) {
+            start_write();
+        }
+
+        if (!formatted) {
+            return;
+        }
+    }
+}
+
+void ei_logger_write_done(void) {
+    chunks_done.store(chunks_done.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    start_write();
+}
+
+void ei_logger_flush(void) {
+    if (!logger_backend) {
+        return;
+    }
+    while (backend_busy.load(std::memory_order_acquire) ||
+           chunks_done.load(std::memory_order_acquire) != chunks_formatted.load(std::memory_order_relaxed) ||
+           ring_tail.load(std::memory_order_acquire) != ring_head.load(std::memory_order_acquire) ||
+           dropped.load(std::memory_order_relaxed) != dropped_reported) {
+        ei_logger_drain();
+    }
+}
+
+void ei_logger_get_stats(ei_logger_stats_t *stats) {
+    stats->messages = messages.load(std::memory_order_relaxed);
+    stats->dropped = dropped.load(std::memory_order_relaxed);
+    stats->bytes_written = bytes_written;
+}
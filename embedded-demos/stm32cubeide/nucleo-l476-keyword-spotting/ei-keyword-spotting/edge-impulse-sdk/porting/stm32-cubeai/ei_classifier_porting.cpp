@@ -38,9 +38,71 @@ uint64_t ei_read_timer_ms() {
     return HAL_GetTick();
 }
 
+#if (__CORTEX_M >= 3U)
+/**
+ * The DWT cycle counter is 32 bits (it wraps every 53 seconds at 80 MHz), extend it
+ * to 64 bits on every read. The timer needs to be read at least once per wrap.
+ */
+static uint64_t cycles_high = 0;
+static uint32_t cycles_last = 0;
+
+uint64_t ei_read_timer_cycles() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+        cycles_high = 0;
+        cycles_last = 0;
+    }
+
+    uint32_t cycles = DWT->CYCCNT;
+    if (cycles < cycles_last) {
+        cycles_high += (1ULL << 32);
+    }
+    cycles_last = cycles;
+    uint64_t result = cycles_high | cycles;
+
+    __set_PRIMASK(primask);
+    return result;
+}
+
+uint32_t ei_timer_cycles_per_second() {
+    return SystemCoreClock;
+}
+
+/**
+ * SystemCoreClock is not always a whole number of MHz, so scale by the full clock.
+ * Whole seconds and the remainder are scaled apart, cycles * 1000000 would overflow
+ * 64 bits after a few days.
+ */
+uint64_t ei_read_timer_us() {
+    uint64_t cycles = ei_read_timer_cycles();
+    uint64_t clock = SystemCoreClock;
+    return (cycles / clock) * 1000000ULL + ((cycles % clock) * 1000000ULL) / clock;
+}
+#else
+// No cycle counter on Cortex-M0/M0+, microseconds from the SysTick that drives HAL_GetTick
+uint64_t ei_read_timer_cycles() {
+    return 0;
+}
+
+uint32_t ei_timer_cycles_per_second() {
+    return 0;
+}
+
 uint64_t ei_read_timer_us() {
-    return HAL_GetTick() * 1000;
+    uint32_t ms, val;
+    do {
+        ms = HAL_GetTick();
+        val = SysTick->VAL;
+    } while (ms != HAL_GetTick());
+    uint32_t load = SysTick->LOAD + 1;
+    return (uint64_t)ms * 1000 + ((uint64_t)(load - val) * 1000) / load;
 }
+#endif
 
 __attribute__((weak)) void ei_printf(const char *format, ...) {
     va_list myargs;
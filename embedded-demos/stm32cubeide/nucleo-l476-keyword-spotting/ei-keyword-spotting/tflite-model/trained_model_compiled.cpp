@@ -22,10 +22,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
-#include <vector>
+#include "edge-impulse-sdk/classifier/ei_classifier_config.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/builtin_op_data.h"
 #include "edge-impulse-sdk/tensorflow/lite/c/common.h"
 #include "edge-impulse-sdk/tensorflow/lite/micro/kernels/micro_ops.h"
+#if EI_CLASSIFIER_TFLITE_ENABLE_CMSIS_NN == 1 && (defined(__ARM_FEATURE_DSP) || defined(__ARM_FEATURE_MVE))
+#define EI_CLASSIFIER_CHECK_CMSIS_NN_BUFFERS 1
+#include "edge-impulse-sdk/CMSIS/NN/Include/arm_nnfunctions.h"
+#include "edge-impulse-sdk/tensorflow/lite/kernels/padding.h"
+#endif
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+#include "edge-impulse-sdk/classifier/ei_profiler.h"
+#endif
 
 #if defined __GNUC__
 #define ALIGN(X) __attribute__((aligned(X)))
@@ -37,10 +45,29 @@
 
 namespace {
 
-constexpr int kTensorArenaSize = 3392;
-uint8_t* tensor_arena = NULL;
-static uint8_t* current_location;
-static uint8_t* tensor_boundary;
+// Tensors, at the start of the arena
+constexpr int kTensorArenaSize = 2944;
+// Persistent buffers, allocated from the end of the arena. Computed for Cortex-M with CMSIS-NN:
+//   CONV_2D (1)          OpData 44 + per channel 2 * 120 + arm_convolve_s8 scratch 364
+//   MAX_POOL_2D (5)      OpData 20 + arm_avgpool_s8 scratch 60
+//   CONV_2D (7)          OpData 44 + per channel 2 * 40 + arm_convolve_s8 scratch 840
+//   MAX_POOL_2D (11)     OpData 20 + arm_avgpool_s8 scratch 20
+//   FULLY_CONNECTED (13) OpData 24
+// trained_model_init re-derives the Prepare share from the CMSIS-NN *_get_buffer_size functions
+// and fails before Prepare runs if it does not fit.
+constexpr int kPersistentBufferSize = 1760;
+constexpr int kArenaSize = kTensorArenaSize + kPersistentBufferSize;
+constexpr int kMaxScratchBuffers = 4;
+constexpr uintptr_t kPersistentBufferAlignment = 4;
+#if EI_CLASSIFIER_ALLOCATION_STATIC == 1
+ALIGN(16) static EI_CLASSIFIER_THREAD_LOCAL uint8_t static_tensor_arena[kArenaSize];
+#endif
+// The model state is per thread with EI_CLASSIFIER_THREAD_SAFE, the weights are shared
+EI_CLASSIFIER_THREAD_LOCAL uint8_t* tensor_arena = NULL;
+static EI_CLASSIFIER_THREAD_LOCAL uint8_t* current_location;
+static EI_CLASSIFIER_THREAD_LOCAL uint8_t* tensor_boundary;
+// Set when a persistent allocation fails, the kernels' Init and Prepare ignore the status
+static EI_CLASSIFIER_THREAD_LOCAL bool persistent_buffer_failed;
 template <int SZ, class T> struct TfArray {
   int sz; T elem[SZ];
 };
@@ -62,10 +89,18 @@ struct NodeInfo_t { // subset of TfLiteNode used for initialization from constan
   used_operators_e used_op_index;
 };
 
-TfLiteContext ctx{};
-TfLiteTensor tflTensors[31];
-TfLiteRegistration registrations[OP_LAST];
-TfLiteNode tflNodes[15];
+EI_CLASSIFIER_THREAD_LOCAL TfLiteContext ctx{};
+EI_CLASSIFIER_THREAD_LOCAL TfLiteTensor tflTensors[31];
+EI_CLASSIFIER_THREAD_LOCAL TfLiteRegistration registrations[OP_LAST];
+EI_CLASSIFIER_THREAD_LOCAL TfLiteNode tflNodes[15];
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+const char* const op_names[OP_LAST] = {
+  "RESHAPE", "CONV_2D", "ADD", "MAX_POOL_2D", "FULLY_CONNECTED", "SOFTMAX",
+};
+// Scratch buffer bytes requested by every node in prepare
+static EI_CLASSIFIER_THREAD_LOCAL uint32_t node_scratch_bytes[15];
+static EI_CLASSIFIER_THREAD_LOCAL int prepare_node = -1;
+#endif
 
 const TfArray<2, int> tensor_dimension0 = { 2, { 1,637 } };
 const TfArray<1, float> quant0_scale = { 1, { 0.046360891312360764, } };
@@ -326,22 +361,18 @@ const TensorInfo_t tensorData[] = {
   { (TfLiteIntArray*)&inputs13, (TfLiteIntArray*)&outputs13, const_cast<void*>(static_cast<const void*>(&opdata13)), OP_FULLY_CONNECTED, },
   { (TfLiteIntArray*)&inputs14, (TfLiteIntArray*)&outputs14, const_cast<void*>(static_cast<const void*>(&opdata14)), OP_SOFTMAX, },
 };
-static std::vector<void*> overflow_buffers;
 static TfLiteStatus AllocatePersistentBuffer(struct TfLiteContext* ctx,
                                                  size_t bytes, void** ptr) {
-  if (current_location - bytes < tensor_boundary) {
-    // OK, this will look super weird, but.... we have CMSIS-NN buffers which
-    // we cannot calculate beforehand easily.
-    *ptr = malloc(bytes);
-    if (*ptr == NULL) {
-      printf("ERR: Failed to allocate persistent buffer of size %u\n", bytes);
-      return kTfLiteError;
-    }
-    overflow_buffers.push_back(*ptr);
-    return kTfLiteOk;
+  (void)ctx;
+  uint8_t* location = (uint8_t*)(((uintptr_t)current_location - bytes) & ~(kPersistentBufferAlignment - 1));
+  if (bytes > (size_t)(current_location - tensor_boundary) || location < tensor_boundary) {
+    printf("ERR: Failed to allocate persistent buffer of size %u, kPersistentBufferSize too small\n", (unsigned)bytes);
+    persistent_buffer_failed = true;
+    *ptr = NULL;
+    return kTfLiteError;
   }
 
-  current_location -= bytes;
+  current_location = location;
 
   *ptr = current_location;
   return kTfLiteOk;
@@ -350,10 +381,16 @@ typedef struct {
   size_t bytes;
   void *ptr;
 } scratch_buffer_t;
-static std::vector<scratch_buffer_t> scratch_buffers;
+static EI_CLASSIFIER_THREAD_LOCAL scratch_buffer_t scratch_buffers[kMaxScratchBuffers];
+static EI_CLASSIFIER_THREAD_LOCAL int scratch_buffers_count = 0;
 
 static TfLiteStatus RequestScratchBufferInArena(struct TfLiteContext* ctx, size_t bytes,
                                                 int* buffer_idx) {
+  if (scratch_buffers_count >= kMaxScratchBuffers) {
+    printf("ERR: Too many scratch buffers, kMaxScratchBuffers too small\n");
+    return kTfLiteError;
+  }
+
   scratch_buffer_t b;
   b.bytes = bytes;
 
@@ -362,24 +399,108 @@ static TfLiteStatus RequestScratchBufferInArena(struct TfLiteContext* ctx, size_
     return s;
   }
 
-  scratch_buffers.push_back(b);
+  scratch_buffers[scratch_buffers_count] = b;
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+  if (prepare_node >= 0) {
+    node_scratch_bytes[prepare_node] += bytes;
+  }
+#endif
 
-  *buffer_idx = scratch_buffers.size() - 1;
+  *buffer_idx = scratch_buffers_count++;
 
   return kTfLiteOk;
 }
 
 static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
-  if (buffer_idx > static_cast<int>(scratch_buffers.size()) - 1) {
+  (void)ctx;
+  if (buffer_idx < 0 || buffer_idx >= scratch_buffers_count) {
     return NULL;
   }
   return scratch_buffers[buffer_idx].ptr;
 }
+
+#if EI_CLASSIFIER_CHECK_CMSIS_NN_BUFFERS == 1
+static size_t PersistentBytes(int32_t bytes) {
+  return ((size_t)bytes + kPersistentBufferAlignment - 1) & ~(kPersistentBufferAlignment - 1);
+}
+
+// Persistent bytes the CMSIS-NN Prepare of a node requests, mirrors the kernels
+static size_t PreparePersistentBytes(const TfLiteNode* node, used_operators_e op) {
+  const TfLiteTensor* input = &tflTensors[node->inputs->data[0]];
+  const TfLiteTensor* output = &tflTensors[node->outputs->data[0]];
+
+  switch (op) {
+    case OP_CONV_2D: {
+      const TfLiteTensor* filter = &tflTensors[node->inputs->data[1]];
+      const TfLiteConvParams* params = (const TfLiteConvParams*)node->builtin_data;
+      const int num_channels = filter->dims->data[0];
+      size_t bytes = 2 * PersistentBytes(num_channels * sizeof(int32_t));
+      if (input->type != kTfLiteInt8) {
+        return bytes;
+      }
+
+      cmsis_nn_dims input_dims;
+      input_dims.n = input->dims->data[0];
+      input_dims.h = input->dims->data[1];
+      input_dims.w = input->dims->data[2];
+      input_dims.c = input->dims->data[3];
+      cmsis_nn_dims filter_dims;
+      filter_dims.n = output->dims->data[3];
+      filter_dims.h = filter->dims->data[1];
+      filter_dims.w = filter->dims->data[2];
+      filter_dims.c = input_dims.c;
+      cmsis_nn_dims output_dims;
+      output_dims.n = input_dims.n;
+      output_dims.h = output->dims->data[1];
+      output_dims.w = output->dims->data[2];
+      output_dims.c = output->dims->data[3];
+
+      int out_height, out_width;
+      TfLitePaddingValues padding = tflite::ComputePaddingHeightWidth(
+          params->stride_height, params->stride_width,
+          params->dilation_height_factor, params->dilation_width_factor,
+          input_dims.h, input_dims.w, filter_dims.h, filter_dims.w,
+          params->padding, &out_height, &out_width);
+
+      cmsis_nn_conv_params conv_params = {};
+      conv_params.stride.h = params->stride_height;
+      conv_params.stride.w = params->stride_width;
+      conv_params.dilation.h = params->dilation_height_factor;
+      conv_params.dilation.w = params->dilation_width_factor;
+      conv_params.padding.h = padding.height;
+      conv_params.padding.w = padding.width;
+
+      return bytes + PersistentBytes(arm_convolve_wrapper_s8_get_buffer_size(
+          &conv_params, &input_dims, &filter_dims, &output_dims));
+    }
+    case OP_MAX_POOL_2D:
+      return PersistentBytes(arm_avgpool_s8_get_buffer_size(
+          output->dims->data[2], output->dims->data[3]));
+    case OP_FULLY_CONNECTED: {
+      const TfLiteTensor* filter = &tflTensors[node->inputs->data[1]];
+      return PersistentBytes(arm_fully_connected_s8_get_buffer_size(
+          filter->dims->data[filter->dims->size - 1]));
+    }
+    default:
+      return 0;
+  }
+}
+#endif
 } // namespace
 
   TfLiteStatus trained_model_init( void*(*alloc_fnc)(size_t,size_t) ) {
-  tensor_arena = (uint8_t*) alloc_fnc(16, kTensorArenaSize);
-  current_location = tensor_arena + kTensorArenaSize;
+#if EI_CLASSIFIER_ALLOCATION_STATIC == 1
+  (void)alloc_fnc;
+  tensor_arena = static_tensor_arena;
+#else
+  tensor_arena = (uint8_t*) alloc_fnc(16, kArenaSize);
+  if (tensor_arena == NULL) {
+    return kTfLiteError;
+  }
+#endif
+  scratch_buffers_count = 0;
+  persistent_buffer_failed = false;
+  current_location = tensor_arena + kArenaSize;
   tensor_boundary = tensor_arena;
   ctx.AllocatePersistentBuffer = &AllocatePersistentBuffer;
   ctx.RequestScratchBufferInArena = &RequestScratchBufferInArena;
@@ -429,14 +550,39 @@ static void* GetScratchBuffer(struct TfLiteContext* ctx, int buffer_idx) {
       tflNodes[i].user_data = registrations[nodeData[i].used_op_index].init(&ctx, (const char*)tflNodes[i].builtin_data, 0);
     }
   }
+  if (persistent_buffer_failed) {
+    return kTfLiteError;
+  }
+#if EI_CLASSIFIER_CHECK_CMSIS_NN_BUFFERS == 1
+  // Prepare writes through the buffers it allocates without checking them, so check the budget up front
+  size_t prepare_bytes = 0;
+  for(size_t i = 0; i < 15; ++i) {
+    prepare_bytes += PreparePersistentBytes(&tflNodes[i], nodeData[i].used_op_index);
+  }
+  if (prepare_bytes > (size_t)(current_location - tensor_boundary)) {
+    printf("ERR: Prepare needs %u persistent bytes, %u left, kPersistentBufferSize too small\n",
+           (unsigned)prepare_bytes, (unsigned)(current_location - tensor_boundary));
+    return kTfLiteError;
+  }
+#endif
   for(size_t i = 0; i < 15; ++i) {
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    prepare_node = i;
+    node_scratch_bytes[i] = 0;
+#endif
     if (registrations[nodeData[i].used_op_index].prepare) {
       TfLiteStatus status = registrations[nodeData[i].used_op_index].prepare(&ctx, &tflNodes[i]);
       if (status != kTfLiteOk) {
         return status;
       }
+      if (persistent_buffer_failed) {
+        return kTfLiteError;
+      }
     }
   }
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+  prepare_node = -1;
+#endif
   return kTfLiteOk;
 }
 
@@ -456,7 +602,14 @@ TfLiteTensor* trained_model_output(int index) {
 
 TfLiteStatus trained_model_invoke() {
   for(size_t i = 0; i < 15; ++i) {
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    uint32_t start = ei_profiler_read_clock();
+#endif
     TfLiteStatus status = registrations[nodeData[i].used_op_index].invoke(&ctx, &tflNodes[i]);
+#if EI_CLASSIFIER_PROFILE_NODES == 1
+    ei_profiler_record(i, op_names[nodeData[i].used_op_index], start, ei_profiler_read_clock(),
+                       node_scratch_bytes[i]);
+#endif
     if (status != kTfLiteOk) {
       return status;
     }
@@ -465,11 +618,14 @@ TfLiteStatus trained_model_invoke() {
 }
 
 TfLiteStatus trained_model_reset( void (*free_fnc)(void* ptr) ) {
-  free_fnc(tensor_arena);
-  scratch_buffers.clear();
-  for (size_t ix = 0; ix < overflow_buffers.size(); ix++) {
-    free(overflow_buffers[ix]);
+#if EI_CLASSIFIER_ALLOCATION_STATIC == 1
+  (void)free_fnc;
+#else
+  if (tensor_arena != NULL) {
+    free_fnc(tensor_arena);
   }
-  overflow_buffers.clear();
+#endif
+  tensor_arena = NULL;
+  scratch_buffers_count = 0;
   return kTfLiteOk;
 }